@@ -1,12 +1,56 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <ctime>
 #include <cstdlib>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <tuple>
+#include <utility>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#ifndef OOP_PROFILE
+#define OOP_PROFILE 0 // 1이면 계측 빌드 (== 계측 == 절 참고)
+#endif
+#if OOP_PROFILE
+#include <fstream>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#endif
 
 using namespace std;
 
@@ -40,923 +84,10196 @@ const int DEFAULT_DCA_INTERVAL = 5;           // 5일 간격
 const double DEFAULT_DCA_BUY_RATIO = 0.25;    // 25% 매수
 const double DEFAULT_HOLD_BUY_RATIO = 0.5;    // 50% 매수
 const long DEFAULT_INITIAL_CASH = 10000000;   // 1000만원
+const double DEFAULT_PERIODS_PER_YEAR = 252;  // 연간 거래일 수 (연율화 기준)
+const size_t DEFAULT_ROLLING_WINDOW = 20;     // 이동 변동성 구간 (20일)
 
-// == 구조체 정의 ==
-
-// BacktestConfig 구조체
-struct BacktestConfig
-{
-    long initialCash;
-    double feeRate;
-    double panicThreshold;
-    double dcaDropRate;
-    int dcaInterval;
-    double dcaBuyRatio;
-    double holdBuyRatio;
+// == 스냅샷 직렬화 (체크포인트) ==
 
-    // 기본값 생성자
-    BacktestConfig() : initialCash(DEFAULT_INITIAL_CASH),
-                       feeRate(DEFAULT_FEE_RATE),
-                       panicThreshold(DEFAULT_PANIC_THRESHOLD),
-                       dcaDropRate(DEFAULT_DCA_DROP_RATE),
-                       dcaInterval(DEFAULT_DCA_INTERVAL),
-                       dcaBuyRatio(DEFAULT_DCA_BUY_RATIO),
-                       holdBuyRatio(DEFAULT_HOLD_BUY_RATIO) {}
-};
+// 스냅샷은 같은 빌드/아키텍처에서 다시 읽는 용도라 값을 메모리 표현 그대로 쓴다.
+// 머리에 magic/버전/종류를 두어 다른 파일이나 다른 객체의 스냅샷은 복원하지 않는다.
+const uint32_t SNAPSHOT_MAGIC = 0x53504F4F; // "OOPS"
+const uint32_t SNAPSHOT_VERSION = 1;
 
-// StrategyReport 구조체
-struct StrategyReport
+enum SnapshotKind
 {
-    string strategyName; // 전략 이름
-    long initialCash;    // 초기 자본
-    long finalEquity;    // 최종 자산
-    double totalReturn;  // 총 수익률 (%)
-    double maxDrawdown;  // 최대 낙폭 (%)
-    int buyCount;        // 매수 횟수
-    int sellCount;       // 매도 횟수
-    int finalShares;     // 최종 보유 주식 수
-    int avgPrice;        // 평균 매수가
+    SNAPSHOT_BACKTEST = 1,
+    SNAPSHOT_MONTE_CARLO = 2,
+    SNAPSHOT_ACCOUNT = 3,
+    SNAPSHOT_MARKET = 4,
+    SNAPSHOT_SWEEP = 5
 };
 
-// == 기본 클래스 설계 ==
-
-// Stock 클래스
-class Stock
+// SnapshotWriter 클래스 (버퍼에 이어 붙이기만 함, 버퍼는 재사용)
+class SnapshotWriter
 {
 private:
-    string code;
-    string name;
-    int currentPrice;
-    int previousPrice;
-    vector<int> priceHistory;
+    vector<char> buffer;
 
 public:
-    Stock(string c, string n, int p) : code(c), name(n), currentPrice(p), previousPrice(p) {}
+    void clear() { buffer.clear(); }
 
-    void updatePrice(int newPrice)
+    void header(SnapshotKind kind)
     {
-        previousPrice = currentPrice;
-        currentPrice = newPrice;
+        pod(SNAPSHOT_MAGIC);
+        pod(SNAPSHOT_VERSION);
+        pod((uint32_t)kind);
     }
 
-    void addPriceHistory(int price)
+    void bytes(const void *data, size_t size)
     {
-        priceHistory.push_back(price);
+        const char *p = (const char *)data;
+        buffer.insert(buffer.end(), p, p + size);
     }
 
-    double getChangeRate() const
+    template <typename T>
+    void pod(const T &value)
     {
-        if (previousPrice == 0)
-            return 0.0;
-        return (double)(currentPrice - previousPrice) / previousPrice * 100.0;
+        static_assert(is_trivially_copyable<T>::value, "스냅샷에는 memcpy 가능한 값만 쓴다");
+        bytes(&value, sizeof(T));
     }
 
-    int getPriceAt(size_t idx) const
+    // 길이 + 원소 (원소는 memcpy 가능해야 한다)
+    template <typename T, typename A>
+    void podVector(const vector<T, A> &values)
     {
-        if (idx >= priceHistory.size())
-            return -1;
-        return priceHistory[idx];
+        static_assert(is_trivially_copyable<T>::value, "스냅샷에는 memcpy 가능한 값만 쓴다");
+        pod((uint64_t)values.size());
+        if (!values.empty())
+            bytes(values.data(), values.size() * sizeof(T));
     }
 
-    size_t getHistoryLength() const
+    void text(const string &s)
     {
-        return priceHistory.size();
+        pod((uint64_t)s.size());
+        bytes(s.data(), s.size());
     }
 
-    string getCode() const { return code; }
-    string getName() const { return name; }
-    int getCurrentPrice() const { return currentPrice; }
+    size_t size() const { return buffer.size(); }
+    const vector<char> &data() const { return buffer; }
+    // CheckpointWriter::submit에 넘기면 이전 버퍼와 교환된다
+    vector<char> &data() { return buffer; }
 };
 
-// Position 클래스
-class Position
+// SnapshotReader 클래스 (길이를 넘는 읽기는 실패로 남기고 이후 읽기도 모두 실패)
+class SnapshotReader
 {
 private:
-    Stock *stock;
-    int quantity;
-    int avgPrice;
-    long totalInvested;
+    const char *cursor;
+    const char *end;
+    bool failed;
 
 public:
-    Position(Stock *s = nullptr, int qty = 0, int price = 0)
-        : stock(s), quantity(qty), avgPrice(price), totalInvested(0)
+    SnapshotReader(const char *data, size_t size)
+        : cursor(data), end(data + size), failed(false) {}
+    explicit SnapshotReader(const vector<char> &data)
+        : SnapshotReader(data.data(), data.size()) {}
+
+    bool header(SnapshotKind kind)
     {
-        if (qty > 0)
+        uint32_t magic = 0, version = 0, stored = 0;
+        if (!pod(magic) || !pod(version) || !pod(stored))
+            return false;
+        if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || stored != (uint32_t)kind)
+            failed = true;
+        return !failed;
+    }
+
+    bool bytes(void *out, size_t size)
+    {
+        if (failed || (size_t)(end - cursor) < size)
         {
-            totalInvested = (long)qty * price;
+            failed = true;
+            return false;
         }
+        memcpy(out, cursor, size);
+        cursor += size;
+        return true;
     }
 
-    void addQuantity(int qty, int price)
+    template <typename T>
+    bool pod(T &out)
     {
-        totalInvested += (long)qty * price;
-        quantity += qty;
-        avgPrice = (quantity > 0) ? (int)(totalInvested / quantity) : 0;
+        static_assert(is_trivially_copyable<T>::value, "스냅샷에는 memcpy 가능한 값만 쓴다");
+        return bytes(&out, sizeof(T));
     }
 
-    bool reduceQuantity(int qty)
+    // 기본 생성자가 없는 POD(Order, Transaction)도 읽도록 원소 단위로 복사 (용량은 유지)
+    template <typename T, typename A>
+    bool podVector(vector<T, A> &out)
     {
-        if (qty > quantity)
+        static_assert(is_trivially_copyable<T>::value, "스냅샷에는 memcpy 가능한 값만 쓴다");
+        uint64_t n = 0;
+        if (!pod(n))
             return false;
-        quantity -= qty;
-        // 매도 시에는 평균단가가 변하지 않고 totalInvested 비례 감소
-        if (quantity == 0)
+        if (n > (uint64_t)(end - cursor) / sizeof(T)) // 잘린 파일에서 거대한 할당 방지
         {
-            totalInvested = 0;
-            avgPrice = 0;
+            failed = true;
+            return false;
         }
-        else
+        out.clear();
+        out.reserve((size_t)n);
+        typename aligned_storage<sizeof(T), alignof(T)>::type slot;
+        for (uint64_t i = 0; i < n; ++i)
         {
-            totalInvested = (long)quantity * avgPrice;
+            memcpy(&slot, cursor, sizeof(T));
+            cursor += sizeof(T);
+            out.push_back(*reinterpret_cast<const T *>(&slot));
         }
         return true;
     }
 
-    long getCurrentValue() const
-    {
-        if (!stock)
-            return 0;
-        return (long)stock->getCurrentPrice() * quantity;
-    }
-
-    long getProfit() const
+    bool text(string &out)
     {
-        return getCurrentValue() - totalInvested;
-    }
-
-    double getProfitRate() const
-    {
-        if (totalInvested == 0)
-            return 0.0;
-        return (double)getProfit() / totalInvested * 100.0;
+        uint64_t n = 0;
+        if (!pod(n))
+            return false;
+        if (n > (uint64_t)(end - cursor))
+        {
+            failed = true;
+            return false;
+        }
+        out.assign(cursor, (size_t)n);
+        cursor += n;
+        return true;
     }
 
-    int getQuantity() const { return quantity; }
-    int getAvgPrice() const { return avgPrice; }
-    Stock *getStock() const { return stock; }
+    bool ok() const { return !failed; }
+    bool atEnd() const { return cursor == end; }
 };
 
-// Portfolio 클래스
-class Portfolio
+// CheckpointWriter 클래스
+// 계산 스레드는 submit으로 버퍼만 교환하고 바로 돌아가며, 파일 기록은 백그라운드 스레드가 한다.
+// 기록 중에 여러 스냅샷이 쌓이면 가장 최근 것만 쓴다 (체크포인트는 마지막 상태만 의미가 있다).
+// 임시 파일에 다 쓴 뒤 rename으로 바꾸므로 도중에 죽어도 이전 체크포인트가 남는다.
+class CheckpointWriter
 {
 private:
-    map<string, Position> positions;
-
-public:
-    void addPosition(Stock *s, int qty, int price)
+    string path;
+    mutex lock;
+    condition_variable wake;
+    condition_variable idle;
+    vector<char> pending;
+    vector<char> writing;
+    bool hasPending;
+    bool busy;
+    bool stopping;
+    uint64_t submitted;
+    uint64_t written;
+    uint64_t failures;
+    thread worker;
+
+    static bool writeFile(const string &target, const vector<char> &data)
     {
-        string code = s->getCode();
-        if (positions.find(code) != positions.end())
+        string temp = target + ".tmp";
+        FILE *fp = fopen(temp.c_str(), "wb");
+        if (!fp)
+            return false;
+        bool ok = data.empty() || fwrite(data.data(), 1, data.size(), fp) == data.size();
+        ok = fflush(fp) == 0 && ok;
+#ifndef _WIN32
+        ok = fsync(fileno(fp)) == 0 && ok;
+#endif
+        if (fclose(fp) != 0)
+            ok = false;
+#ifdef _WIN32
+        remove(target.c_str()); // Windows rename은 대상이 있으면 실패
+#endif
+        if (!ok || rename(temp.c_str(), target.c_str()) != 0)
         {
-            positions[code].addQuantity(qty, price);
+            remove(temp.c_str());
+            return false;
         }
-        else
+        return true;
+    }
+
+    void writerLoop()
+    {
+        unique_lock<mutex> guard(lock);
+        while (true)
         {
-            positions[code] = Position(s, qty, price);
+            wake.wait(guard, [this]
+                      { return hasPending || stopping; });
+            if (!hasPending)
+                break;
+            writing.swap(pending);
+            hasPending = false;
+            busy = true;
+
+            guard.unlock();
+            bool ok = writeFile(path, writing);
+            guard.lock();
+
+            busy = false;
+            if (ok)
+                written++;
+            else
+                failures++;
+            idle.notify_all();
         }
     }
 
-    bool reducePosition(string code, int qty)
+public:
+    explicit CheckpointWriter(const string &p)
+        : path(p), hasPending(false), busy(false), stopping(false),
+          submitted(0), written(0), failures(0)
     {
-        if (positions.find(code) == positions.end())
-            return false;
+        worker = thread(&CheckpointWriter::writerLoop, this);
+    }
 
-        bool result = positions[code].reduceQuantity(qty);
-        if (result && positions[code].getQuantity() == 0)
+    // 대기 중인 스냅샷까지 기록한 뒤 종료
+    ~CheckpointWriter()
+    {
         {
-            positions.erase(code);
+            lock_guard<mutex> guard(lock);
+            stopping = true;
         }
-        return result;
+        wake.notify_one();
+        worker.join();
     }
 
-    Position *getPosition(string code)
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // snapshot을 가져가고 이전에 쓰던 버퍼를 돌려준다 (할당 없이 재사용)
+    void submit(vector<char> &snapshot)
     {
-        if (positions.find(code) == positions.end())
-            return nullptr;
-        return &positions[code];
+        {
+            lock_guard<mutex> guard(lock);
+            pending.swap(snapshot);
+            hasPending = true;
+            submitted++;
+        }
+        snapshot.clear();
+        wake.notify_one();
     }
 
-    bool hasPosition(string code) const
+    // 지금까지 넘긴 스냅샷이 기록될 때까지 대기
+    void flush()
     {
-        return positions.find(code) != positions.end();
+        unique_lock<mutex> guard(lock);
+        idle.wait(guard, [this]
+                  { return !hasPending && !busy; });
     }
 
-    long getTotalValue() const
+    // 파일 전체를 out에 읽는다 (없거나 읽기 실패면 false)
+    static bool load(const string &path, vector<char> &out)
     {
-        long total = 0;
-        for (const auto &entry : positions)
+        FILE *fp = fopen(path.c_str(), "rb");
+        if (!fp)
+            return false;
+        fseek(fp, 0, SEEK_END);
+        long len = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        bool ok = len >= 0;
+        if (ok)
         {
-            const string &code = entry.first;
-            const Position &pos = entry.second;
-            total += pos.getCurrentValue();
+            out.resize((size_t)len);
+            ok = len == 0 || fread(out.data(), 1, (size_t)len, fp) == (size_t)len;
         }
-        return total;
+        fclose(fp);
+        return ok;
     }
 
-    long getTotalProfit() const
+    const string &getPath() const { return path; }
+
+    uint64_t getSubmittedCount()
     {
-        long total = 0;
-        for (const auto &entry : positions)
-        {
-            const string &code = entry.first;
-            const Position &pos = entry.second;
-            total += pos.getProfit();
-        }
-        return total;
+        lock_guard<mutex> guard(lock);
+        return submitted;
     }
 
-    void printPortfolio() const
+    // 더 최신 스냅샷에 밀려 기록되지 않은 것은 written에 포함되지 않는다
+    uint64_t getWrittenCount()
     {
-        cout << "=== 보유 종목 현황 ===" << endl;
-        for (const auto &entry : positions)
-        {
-            const string &code = entry.first;
-            const Position &pos = entry.second;
-            cout << "[" << code << "] " << pos.getStock()->getName()
-                 << " | 수량: " << pos.getQuantity()
-                 << " | 평단: " << pos.getAvgPrice()
-                 << " | 현재가: " << pos.getStock()->getCurrentPrice()
-                 << " | 수익률: " << fixed << setprecision(2) << pos.getProfitRate() << "%" << endl;
-        }
+        lock_guard<mutex> guard(lock);
+        return written;
+    }
+
+    uint64_t getFailureCount()
+    {
+        lock_guard<mutex> guard(lock);
+        return failures;
     }
 };
 
-// Order 클래스
-class Order
-{
-private:
-    static int nextOrderId;
+// == 구조체 정의 ==
 
-    int orderId;
-    string stockCode;
-    OrderType orderType;
-    PriceType priceType;
-    int requestedPrice;
-    int quantity;
-    OrderStatus status;
-    time_t timestamp;
+// Money 구조체 (금액)
+// 원화는 1원 미만 단위가 없으므로 1원을 최소 단위로 하는 정수 고정소수점 값이다.
+// 체결/수수료 계산은 모두 이 타입의 정수 연산으로 처리한다.
+struct Money
+{
+    int64_t won;
 
-public:
-    Order(string code, OrderType ot, PriceType pt, int price, int qty)
-        : orderId(nextOrderId++), stockCode(code), orderType(ot),
-          priceType(pt), requestedPrice(price), quantity(qty),
-          status(PENDING), timestamp(time(0)) {}
+    constexpr Money() : won(0) {}
+    constexpr explicit Money(int64_t w) : won(w) {}
 
-    void execute() { status = COMPLETED; }
-    void cancel() { status = CANCELLED; }
+    // 가격 x 수량
+    static constexpr Money of(int price, int qty) { return Money((int64_t)price * qty); }
 
-    bool isPending() const { return status == PENDING; }
-    int getOrderId() const { return orderId; }
-    string getStockCode() const { return stockCode; }
-    OrderType getOrderType() const { return orderType; }
-    int getQuantity() const { return quantity; }
+    // 비율만큼의 금액 (전략 파라미터용, 1원 미만 절사)
+    Money scaled(double ratio) const { return Money((int64_t)(won * ratio)); }
 
-    void printOrder() const
+    constexpr Money operator+(Money o) const { return Money(won + o.won); }
+    constexpr Money operator-(Money o) const { return Money(won - o.won); }
+    Money &operator+=(Money o)
     {
-        string typeStr = (orderType == BUY) ? "매수" : "매도";
-        string statusStr = (status == PENDING) ? "대기" : (status == COMPLETED ? "체결" : "취소");
-        cout << "주문 #" << orderId << " [" << stockCode << "] " << typeStr
-             << " " << quantity << "주 (" << statusStr << ")" << endl;
+        won += o.won;
+        return *this;
     }
+    Money &operator-=(Money o)
+    {
+        won -= o.won;
+        return *this;
+    }
+
+    constexpr bool operator==(Money o) const { return won == o.won; }
+    constexpr bool operator!=(Money o) const { return won != o.won; }
+    constexpr bool operator<(Money o) const { return won < o.won; }
+    constexpr bool operator<=(Money o) const { return won <= o.won; }
+    constexpr bool operator>(Money o) const { return won > o.won; }
+    constexpr bool operator>=(Money o) const { return won >= o.won; }
 };
 
-int Order::nextOrderId = 1;
+inline ostream &operator<<(ostream &os, Money m)
+{
+    return os << m.won;
+}
 
-// Transaction 클래스
-class Transaction
+// FeeSchedule 구조체 (수수료율을 1e-8 단위 정수로 저장)
+// 수수료 = 거래금액 x 요율, 1원 미만 절사
+struct FeeSchedule
 {
-private:
-    static int nextTransactionId;
+    static const int64_t SCALE = 100000000;
+    int64_t rateUnits;
 
-    int transactionId;
-    int orderId;
-    string stockCode;
-    string stockName;
-    string type;
-    int quantity;
-    int price;
-    long totalAmount;
-    int fee;
-    time_t timestamp;
+    constexpr explicit FeeSchedule(int64_t units = 0) : rateUnits(units) {}
 
-public:
-    Transaction(Order &order, Stock *stock, int execPrice)
-        : transactionId(nextTransactionId++), orderId(order.getOrderId()),
-          stockCode(stock->getCode()), stockName(stock->getName()),
-          quantity(order.getQuantity()), price(execPrice), timestamp(time(0))
+    static constexpr FeeSchedule fromRate(double rate)
     {
-        type = (order.getOrderType() == BUY) ? "BUY" : "SELL";
-        totalAmount = (long)price * quantity;
-        fee = (int)(totalAmount * DEFAULT_FEE_RATE);
+        return FeeSchedule((int64_t)(rate * SCALE + 0.5));
     }
 
-    long getNetAmount() const
+    // num / den 요율 (예: 15 / 100000 = 0.015%)
+    static constexpr FeeSchedule ratio(int64_t num, int64_t den)
     {
-        if (type == "BUY")
-            return totalAmount + fee;
-        else
-            return totalAmount - fee;
+        return FeeSchedule(num * SCALE / den);
     }
 
-    void printLog() const
+    // 몫/나머지로 나눠 곱하므로 큰 금액에서도 오버플로가 없다
+    constexpr Money feeOn(Money amount) const
     {
-        cout << "거래 #" << transactionId << " [" << type << "] "
-             << stockName << " " << quantity << "주 @ " << price << "원" << endl;
+        return Money((amount.won / SCALE) * rateUnits + (amount.won % SCALE) * rateUnits / SCALE);
     }
+
+    // 1주당 수수료 포함 가격 (매수 가능 수량 계산용)
+    constexpr int64_t withFee(int price) const
+    {
+        return price + feeOn(Money(price)).won;
+    }
+
+    constexpr double getRate() const { return (double)rateUnits / SCALE; }
 };
 
-int Transaction::nextTransactionId = 1;
+const FeeSchedule DEFAULT_FEE_SCHEDULE = FeeSchedule::fromRate(DEFAULT_FEE_RATE);
 
-// Market 클래스
-class Market
+// BacktestConfig 구조체
+struct BacktestConfig
 {
-private:
-    vector<Stock *> stocks;
+    long initialCash;
+    double feeRate;
+    double panicThreshold;
+    double dcaDropRate;
+    int dcaInterval;
+    double dcaBuyRatio;
+    double holdBuyRatio;
+    bool keepEquityHistory; // false면 리포트용 지표만 온라인으로 계산
+    double periodsPerYear;  // 가격 한 칸을 1기간으로 보고 연율화
+    double riskFreeRate;    // 연 무위험 수익률 (샤프/소르티노 기준)
+    size_t rollingWindow;   // 이동 변동성 구간 길이 (0이면 계산하지 않음)
 
-public:
-    Market() {}
-    ~Market()
+    // 기본값 생성자
+    BacktestConfig() : initialCash(DEFAULT_INITIAL_CASH),
+                       feeRate(DEFAULT_FEE_RATE),
+                       panicThreshold(DEFAULT_PANIC_THRESHOLD),
+                       dcaDropRate(DEFAULT_DCA_DROP_RATE),
+                       dcaInterval(DEFAULT_DCA_INTERVAL),
+                       dcaBuyRatio(DEFAULT_DCA_BUY_RATIO),
+                       holdBuyRatio(DEFAULT_HOLD_BUY_RATIO),
+                       keepEquityHistory(true),
+                       periodsPerYear(DEFAULT_PERIODS_PER_YEAR),
+                       riskFreeRate(0.0),
+                       rollingWindow(DEFAULT_ROLLING_WINDOW) {}
+};
+
+// RiskMetrics 구조체 (기간 수익률 기반 위험 지표, 비율은 %)
+struct RiskMetrics
+{
+    double annualReturn;         // 연환산 수익률 (%)
+    double annualVolatility;     // 연환산 변동성 (%)
+    double sharpeRatio;          // 샤프 지수
+    double sortinoRatio;         // 소르티노 지수
+    double calmarRatio;          // 칼마 지수 (연환산 수익률 / MDD)
+    long maxDrawdownDuration;    // 고점 아래에 머문 최장 기간 (가격 칸 수)
+    double rollingVolatility;    // 최근 구간 연환산 변동성 (%)
+    double maxRollingVolatility; // 이동 구간 변동성 중 최대 (%)
+};
+
+// 전략 종류 (리포트를 이름 문자열 대신 종류로 구분)
+enum StrategyKind
+{
+    STRATEGY_PANIC_SELL,
+    STRATEGY_DCA,
+    STRATEGY_HOLD,
+    STRATEGY_MA_CROSS,
+    STRATEGY_PORTFOLIO,
+    STRATEGY_CUSTOM
+};
+
+// 종류별 기본 전략 이름 (다른 프로세스에서 받은 리포트의 이름을 다시 채울 때도 쓴다)
+inline const char *strategyKindName(StrategyKind kind)
+{
+    switch (kind)
     {
+    case STRATEGY_PANIC_SELL:
+        return "쫄보 (Panic Seller)";
+    case STRATEGY_DCA:
+        return "코치 (DCA)";
+    case STRATEGY_HOLD:
+        return "존버 (Holder)";
+    case STRATEGY_MA_CROSS:
+        return "추세 (MA Cross)";
+    case STRATEGY_PORTFOLIO:
+        return "포트폴리오";
+    default:
+        return "사용자 전략";
+    }
+}
 
-        for (Stock *s : stocks)
-        {
-            delete s;
-        }
+// StrategyNameRegistry 클래스 (전략 이름을 프로그램이 끝날 때까지 한 벌만 보관)
+// 리포트는 이름을 포인터로만 들고 다니므로, 전략이 임시 문자열로 이름을 받아도
+// 여기서 얻은 포인터는 전략/리포트보다 오래 유효하다.
+// 기본 전략은 정적 문자열을 그대로 쓰고, 사용자가 이름을 준 전략만 여기를 거친다.
+class StrategyNameRegistry
+{
+private:
+    mutex lock;
+    unordered_set<string> names; // 노드 기반이라 원소 주소가 바뀌지 않는다
+
+    static StrategyNameRegistry &instance()
+    {
+        static StrategyNameRegistry registry;
+        return registry;
     }
 
-    void addStock(Stock *stock)
+public:
+    // 여러 스레드에서 호출 가능, 같은 이름이면 같은 포인터
+    static const char *intern(const string &name)
     {
-        stocks.push_back(stock);
+        StrategyNameRegistry &registry = instance();
+        lock_guard<mutex> guard(registry.lock);
+        return registry.names.insert(name).first->c_str();
     }
+};
+
+// StrategyReport 구조체 (복사가 memcpy인 POD, 이름은 정적 문자열이나 StrategyNameRegistry의 문자열을 가리킨다)
+struct StrategyReport
+{
+    StrategyKind kind;          // 전략 종류
+    const char *strategyName;   // 전략 이름 (정적 문자열 또는 StrategyNameRegistry::intern 결과)
+    long initialCash;    // 초기 자본
+    long finalEquity;    // 최종 자산
+    double totalReturn;  // 총 수익률 (%)
+    double maxDrawdown;  // 최대 낙폭 (%)
+    int buyCount;        // 매수 횟수
+    int sellCount;       // 매도 횟수
+    int finalShares;     // 최종 보유 주식 수
+    int avgPrice;        // 평균 매수가
+    RiskMetrics risk;    // 변동성/샤프 등 위험 지표
+};
+
+static_assert(is_trivially_copyable<StrategyReport>::value, "StrategyReport는 문자열을 복사하지 않는다");
+
+// DrawdownTracker 구조체 (자산 곡선을 저장하지 않고 MDD를 온라인으로 계산)
+struct DrawdownTracker
+{
+    long peakEquity;   // 현재 고점
+    long troughEquity; // 현재 고점 이후 최저점
+    double maxDD;      // 지난 고점 구간들의 최대 낙폭 (비율)
+
+    DrawdownTracker() : peakEquity(0), troughEquity(0), maxDD(0.0) {}
 
-    Stock *getStock(string code)
+    // 고점 구간의 낙폭은 최저점에서 최대이므로 고점이 갱신될 때만 계산
+    void closePeak()
     {
-        for (Stock *s : stocks)
+        if (peakEquity > 0)
         {
-            if (s->getCode() == code)
-                return s;
+            double dd = (double)(peakEquity - troughEquity) / peakEquity;
+            if (dd > maxDD)
+                maxDD = dd;
         }
-        return nullptr;
     }
 
-    void simulatePriceChange()
+    void track(long equity)
     {
-        for (Stock *stock : stocks)
+        if (equity > peakEquity)
         {
-            int randVal = rand() % 100;
-            double rate;
-
-            if (randVal < 95)
-            {
-                // 95%: -3% ~ +3%
-                rate = ((rand() % 601) - 300) / 10000.0;
-            }
-            else
-            {
-                // 5%: -15% ~ -5% 급락
-                rate = -((rand() % 1001) + 500) / 10000.0;
-            }
+            closePeak();
+            peakEquity = equity;
+            troughEquity = equity;
+        }
+        else if (equity < troughEquity)
+        {
+            troughEquity = equity;
+        }
+    }
 
-            int newPrice = (int)(stock->getCurrentPrice() * (1 + rate));
-            if (newPrice < 1)
-                newPrice = 1;
-            stock->updatePrice(newPrice);
+    // 최대 낙폭 (%) - 자산 곡선 전체를 다시 훑어 구한 값과 같다
+    double getMaxDrawdown() const
+    {
+        double result = maxDD;
+        if (peakEquity > 0)
+        {
+            double dd = (double)(peakEquity - troughEquity) / peakEquity;
+            if (dd > result)
+                result = dd;
         }
+        return result * 100.0;
     }
 };
 
-// Account 클래스
-class Account
+// RiskTracker 구조체 (자산 곡선을 저장하지 않고 수익률 위험 지표를 온라인으로 계산)
+// 기간 수익률은 최대 BLOCK개씩 첫 값 기준 shift 합으로 모은 뒤 Chan 방식으로 Welford 누적에 합친다.
+// 틱마다 나눗셈 체인이 없어 빠르고, 블록 단위 병합이라 긴 구간에서도 오차가 쌓이지 않는다.
+// 최근 window개 수익률의 이동 변동성은 밀어내기 합으로 유지하고 REBASE개마다 버퍼에서 다시 계산한다.
+// 창 크기가 2 미만이면 이동 변동성을 계산하지 않는다 (틱당 비용이 가장 큰 부분).
+struct RiskTracker
 {
-private:
-    string accountNumber;
-    long balance;
-    Portfolio portfolio;
-    vector<Order> orders;
-    vector<Transaction> transactions;
+    static const size_t BLOCK = 64;
+    static const size_t REBASE = 1024;
+
+    long startEquity;
+    long lastEquity;
+
+    uint64_t count; // 병합된 수익률 개수
+    double mean;    // 병합된 수익률 평균
+    double m2;      // 병합된 편차 제곱합
+    size_t blockCount;
+    double blockShift;
+    double blockSum;   // (r - blockShift) 합
+    double blockSumSq; // (r - blockShift)^2 합
+    double downsideTarget; // 소르티노 기준 수익률 (기간당, 샤프와 같은 무위험 수익률)
+    double downsideSq;     // 기준 미만 초과수익률 제곱합 (소르티노용)
+
+    long peakEquity;
+    uint64_t underwater;    // 현재 고점 이후 고점 아래에 머문 기간
+    uint64_t maxUnderwater; // 가장 긴 낙폭 기간
+
+    vector<double> window; // 최근 수익률 (원형 버퍼)
+    size_t windowPos;
+    size_t windowCount;
+    size_t sinceRebase;
+    double windowShift;
+    double windowSum;   // (r - windowShift) 합
+    double windowSumSq; // (r - windowShift)^2 합
+    double invWindow;   // 1 / window 크기
+    double maxWindowM2; // 이동 구간 편차 제곱합의 최대 (분산 = / (w - 1))
+
+    explicit RiskTracker(size_t windowSize = DEFAULT_ROLLING_WINDOW) : downsideTarget(0.0)
+    {
+        setWindowSize(windowSize);
+        start(0);
+    }
 
-public:
-    Account(string accNum, long initBal) : accountNumber(accNum), balance(initBal) {}
+    // compute와 엔진이 같은 식으로 기간당 기준 수익률을 얻도록 한 곳에 둔다
+    static double periodTarget(double periodsPerYear, double riskFreeRate)
+    {
+        return riskFreeRate / periodsPerYear;
+    }
 
-    void deposit(long amount)
+    // 기록 전에 compute에 넘길 값으로 설정 (start로 초기화되지 않는다)
+    void setDownsideTarget(double periodsPerYear, double riskFreeRate)
     {
-        if (amount > 0)
-            balance += amount;
+        downsideTarget = periodTarget(periodsPerYear, riskFreeRate);
     }
 
-    bool withdraw(long amount)
+    // 초기 자산에서 다시 시작 (이동 구간 버퍼는 재사용)
+    void start(long initialEquity)
+    {
+        startEquity = initialEquity;
+        lastEquity = initialEquity;
+        count = 0;
+        mean = 0.0;
+        m2 = 0.0;
+        blockCount = 0;
+        blockShift = 0.0;
+        blockSum = 0.0;
+        blockSumSq = 0.0;
+        downsideSq = 0.0;
+        peakEquity = 0;
+        underwater = 0;
+        maxUnderwater = 0;
+        resetWindow();
+    }
+
+    void resetWindow()
+    {
+        windowPos = 0;
+        windowCount = 0;
+        sinceRebase = 0;
+        windowShift = 0.0;
+        windowSum = 0.0;
+        windowSumSq = 0.0;
+        invWindow = window.empty() ? 0.0 : 1.0 / window.size();
+        maxWindowM2 = 0.0;
+    }
+
+    void setWindowSize(size_t windowSize)
+    {
+        window.assign(windowSize < 2 ? 0 : windowSize, 0.0);
+        resetWindow();
+    }
+
+    // 블록을 (count, mean, m2)에 합친 결과 (블록은 그대로 둔다)
+    void mergedMoments(uint64_t &n, double &mu, double &sq) const
+    {
+        n = count;
+        mu = mean;
+        sq = m2;
+        if (blockCount == 0)
+            return;
+
+        double nb = (double)blockCount;
+        double blockMean = blockShift + blockSum / nb;
+        double blockM2 = max(0.0, blockSumSq - blockSum * blockSum / nb);
+        uint64_t total = count + blockCount;
+        double delta = blockMean - mean;
+        mu = mean + delta * nb / total;
+        sq = m2 + blockM2 + delta * delta * ((double)count * nb / total);
+        n = total;
+    }
+
+    void flushBlock()
+    {
+        mergedMoments(count, mean, m2);
+        blockCount = 0;
+        blockSum = 0.0;
+        blockSumSq = 0.0;
+    }
+
+    double windowM2() const
+    {
+        return max(0.0, windowSumSq - windowSum * windowSum * invWindow);
+    }
+
+    void addReturn(double r)
+    {
+        if (blockCount == 0)
+            blockShift = r;
+        double d = r - blockShift;
+        blockSum += d;
+        blockSumSq += d * d;
+        if (++blockCount == BLOCK)
+            flushBlock();
+        double shortfall = r - downsideTarget;
+        if (shortfall < 0)
+            downsideSq += shortfall * shortfall;
+        if (!window.empty())
+            pushWindow(r);
+    }
+
+    void pushWindow(double r)
+    {
+        size_t w = window.size();
+        if (windowCount < w)
+        {
+            if (windowCount == 0)
+                windowShift = r;
+            double dw = r - windowShift;
+            windowSum += dw;
+            windowSumSq += dw * dw;
+            windowCount++;
+        }
+        else
+        {
+            double dOld = window[windowPos] - windowShift;
+            double dNew = r - windowShift;
+            windowSum += dNew - dOld;
+            windowSumSq += dNew * dNew - dOld * dOld;
+        }
+        window[windowPos] = r;
+        windowPos = (windowPos + 1 == w) ? 0 : windowPos + 1;
+
+        if (windowCount == w)
+        {
+            // 주기적으로 현재 평균을 기준으로 다시 합산해 밀어내기 잔차를 지운다
+            if (++sinceRebase == REBASE)
+            {
+                sinceRebase = 0;
+                double sum = 0.0;
+                for (double x : window)
+                    sum += x;
+                windowShift = sum / w;
+                windowSum = 0.0;
+                windowSumSq = 0.0;
+                for (double x : window)
+                {
+                    windowSum += x - windowShift;
+                    windowSumSq += (x - windowShift) * (x - windowShift);
+                }
+            }
+            double wm2 = windowM2();
+            if (wm2 > maxWindowM2)
+                maxWindowM2 = wm2;
+        }
+    }
+
+    void track(long equity)
+    {
+        if (lastEquity > 0)
+            addReturn((double)(equity - lastEquity) / lastEquity);
+        lastEquity = equity;
+
+        // 고점은 DrawdownTracker와 같이 첫 기록부터 센다
+        if (equity >= peakEquity)
+        {
+            peakEquity = equity;
+            underwater = 0;
+        }
+        else if (++underwater > maxUnderwater)
+        {
+            maxUnderwater = underwater;
+        }
+    }
+
+    // periodsPerYear: 1년 기간 수 (일봉 252), riskFreeRate: 연 무위험 수익률,
+    // maxDrawdownPct: 같은 구간의 MDD (%)
+    // 소르티노의 하방 편차는 setDownsideTarget에 같은 값을 넘겼을 때 분자와 같은 기준이 된다
+    RiskMetrics compute(double periodsPerYear, double riskFreeRate, double maxDrawdownPct) const
+    {
+        uint64_t n;
+        double mu, sq;
+        mergedMoments(n, mu, sq);
+
+        RiskMetrics r;
+        double annualFactor = sqrt(periodsPerYear);
+        double periodRiskFree = periodTarget(periodsPerYear, riskFreeRate);
+        double stddev = (n > 1) ? sqrt(sq / (n - 1)) : 0.0;
+        double downside = (n > 0) ? sqrt(downsideSq / n) : 0.0;
+
+        r.annualReturn = 0.0;
+        if (n > 0 && startEquity > 0 && lastEquity > 0)
+            r.annualReturn = (pow((double)lastEquity / startEquity, periodsPerYear / n) - 1.0) * 100.0;
+        r.annualVolatility = stddev * annualFactor * 100.0;
+        r.sharpeRatio = (stddev > 0) ? (mu - periodRiskFree) / stddev * annualFactor : 0.0;
+        r.sortinoRatio = (downside > 0) ? (mu - periodRiskFree) / downside * annualFactor : 0.0;
+        r.calmarRatio = (maxDrawdownPct > 0) ? r.annualReturn / maxDrawdownPct : 0.0;
+        r.maxDrawdownDuration = (long)maxUnderwater;
+
+        r.rollingVolatility = 0.0;
+        r.maxRollingVolatility = 0.0;
+        if (!window.empty())
+        {
+            double w1 = (double)(window.size() - 1);
+            if (windowCount == window.size())
+                r.rollingVolatility = sqrt(windowM2() / w1) * annualFactor * 100.0;
+            r.maxRollingVolatility = sqrt(maxWindowM2 / w1) * annualFactor * 100.0;
+        }
+        return r;
+    }
+
+    // 체크포인트용 (이동 구간 버퍼 포함)
+    void save(SnapshotWriter &w) const
+    {
+        w.pod(startEquity);
+        w.pod(lastEquity);
+        w.pod(count);
+        w.pod(mean);
+        w.pod(m2);
+        w.pod(blockCount);
+        w.pod(blockShift);
+        w.pod(blockSum);
+        w.pod(blockSumSq);
+        w.pod(downsideSq);
+        w.pod(peakEquity);
+        w.pod(underwater);
+        w.pod(maxUnderwater);
+        w.podVector(window);
+        w.pod(windowPos);
+        w.pod(windowCount);
+        w.pod(sinceRebase);
+        w.pod(windowShift);
+        w.pod(windowSum);
+        w.pod(windowSumSq);
+        w.pod(maxWindowM2);
+    }
+
+    bool restore(SnapshotReader &r)
+    {
+        r.pod(startEquity);
+        r.pod(lastEquity);
+        r.pod(count);
+        r.pod(mean);
+        r.pod(m2);
+        r.pod(blockCount);
+        r.pod(blockShift);
+        r.pod(blockSum);
+        r.pod(blockSumSq);
+        r.pod(downsideSq);
+        r.pod(peakEquity);
+        r.pod(underwater);
+        r.pod(maxUnderwater);
+        r.podVector(window);
+        r.pod(windowPos);
+        r.pod(windowCount);
+        r.pod(sinceRebase);
+        r.pod(windowShift);
+        r.pod(windowSum);
+        r.pod(windowSumSq);
+        r.pod(maxWindowM2);
+        invWindow = window.empty() ? 0.0 : 1.0 / window.size();
+        if (blockCount >= BLOCK || windowCount > window.size() ||
+            (!window.empty() && windowPos >= window.size()))
+            return false;
+        return r.ok();
+    }
+};
+
+// PriceBar 구조체 (OHLCV 한 봉)
+struct PriceBar
+{
+    long long timestamp;
+    int open;
+    int high;
+    int low;
+    int close;
+    long long volume;
+};
+
+// == 계측 (프로파일링) ==
+
+// -DOOP_PROFILE=1로 빌드하면 엔진/계좌 구간 계측, 전략별 사이클, 할당 카운터가 켜진다.
+// 기본 빌드에서는 아래 매크로가 모두 비어 있어 코드가 생성되지 않는다.
+#if OOP_PROFILE
+
+// 계측 구간
+enum ProfileZone
+{
+    ZONE_RUN_BATTLE,
+    ZONE_BUILD_REPORT,
+    ZONE_FINALIZE_RISK, // buildReport 안의 MDD/위험 지표 마무리 (곡선은 다시 읽지 않는다)
+    ZONE_PLACE_ORDER,
+    ZONE_EXECUTE_ORDER,
+    ZONE_EXECUTE_ORDERS,
+    ZONE_COUNT
+};
+
+static const char *const PROFILE_ZONE_NAMES[ZONE_COUNT] = {
+    "runBattle", "buildReport", "finalizeRisk", "placeOrder", "executeOrder", "executeOrders"};
+
+// 전역 operator new 호출 수 (전체 / 현재 스레드)
+static atomic<uint64_t> profileAllocCount(0);
+static atomic<uint64_t> profileAllocBytes(0);
+static atomic<uint64_t> profileFreeCount(0);
+static thread_local uint64_t profileThreadAllocs = 0;
+
+// 전역 operator new/delete 교체 (new[], nothrow 버전은 표준상 이 함수들로 넘어온다)
+void *operator new(size_t size)
+{
+    profileAllocCount.fetch_add(1, memory_order_relaxed);
+    profileAllocBytes.fetch_add(size, memory_order_relaxed);
+    profileThreadAllocs++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p)
+        return;
+    profileFreeCount.fetch_add(1, memory_order_relaxed);
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+// x86이면 TSC, 아니면 steady_clock 틱
+inline uint64_t readCycles()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#else
+    return (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// 트레이스용 작은 스레드 번호 (1부터)
+inline uint32_t profileThreadIndex()
+{
+    static atomic<uint32_t> next(0);
+    static thread_local uint32_t index = next.fetch_add(1, memory_order_relaxed) + 1;
+    return index;
+}
+
+// ZoneStats 구조체 (한 구간의 호출 수, 사이클, 할당 수, 로그2 지연 히스토그램)
+// 여러 스레드의 엔진이 동시에 기록하므로 모두 relaxed 원자 변수
+struct ZoneStats
+{
+    static const int BUCKETS = 48; // buckets[k]: [2^k, 2^(k+1)) 사이클
+
+    atomic<uint64_t> calls;
+    atomic<uint64_t> cycles;
+    atomic<uint64_t> maxCycles;
+    atomic<uint64_t> allocs;
+    atomic<uint64_t> buckets[BUCKETS];
+
+    ZoneStats() { clear(); }
+
+    void clear()
+    {
+        calls.store(0, memory_order_relaxed);
+        cycles.store(0, memory_order_relaxed);
+        maxCycles.store(0, memory_order_relaxed);
+        allocs.store(0, memory_order_relaxed);
+        for (int k = 0; k < BUCKETS; ++k)
+            buckets[k].store(0, memory_order_relaxed);
+    }
+
+    static int bucketOf(uint64_t c)
+    {
+        int k = 0;
+        while (c > 1 && k < BUCKETS - 1)
+        {
+            c >>= 1;
+            k++;
+        }
+        return k;
+    }
+
+    void add(uint64_t c, uint64_t allocCount)
+    {
+        calls.fetch_add(1, memory_order_relaxed);
+        cycles.fetch_add(c, memory_order_relaxed);
+        allocs.fetch_add(allocCount, memory_order_relaxed);
+        buckets[bucketOf(c)].fetch_add(1, memory_order_relaxed);
+        uint64_t prev = maxCycles.load(memory_order_relaxed);
+        while (c > prev && !maxCycles.compare_exchange_weak(prev, c, memory_order_relaxed))
+        {
+        }
+    }
+};
+
+// StrategyProfile 구조체 (전략 하나의 onPrice/onPriceBatch 누적)
+// 배치 호출은 한 번의 호출에 여러 틱으로 센다
+struct StrategyProfile
+{
+    uint64_t calls;
+    uint64_t ticks;
+    uint64_t cycles;
+    uint64_t maxCallCycles;
+    uint64_t allocs;
+
+    StrategyProfile() : calls(0), ticks(0), cycles(0), maxCallCycles(0), allocs(0) {}
+
+    void add(uint64_t c, uint64_t tickCount, uint64_t allocCount)
+    {
+        calls++;
+        ticks += tickCount;
+        cycles += c;
+        allocs += allocCount;
+        if (c > maxCallCycles)
+            maxCallCycles = c;
+    }
+
+    void merge(const StrategyProfile &o)
+    {
+        calls += o.calls;
+        ticks += o.ticks;
+        cycles += o.cycles;
+        allocs += o.allocs;
+        if (o.maxCallCycles > maxCallCycles)
+            maxCallCycles = o.maxCallCycles;
+    }
+};
+
+// Profiler 클래스 (계측 결과 저장소, 프로세스에 하나)
+// 구간 통계는 원자 변수로, 전략별 통계와 트레이스 이벤트는 잠금으로 모은다.
+class Profiler
+{
+private:
+    struct TraceEvent
+    {
+        int zone;
+        uint32_t thread;
+        int64_t beginNs; // origin 기준
+        int64_t durationNs;
+    };
+
+    static const size_t DEFAULT_TRACE_LIMIT = 1 << 16;
+
+    ZoneStats zones[ZONE_COUNT];
+    mutex lock;
+    map<string, StrategyProfile> strategies; // 전략 이름별 누적
+    vector<TraceEvent> trace;
+    size_t traceLimit;
+    uint64_t droppedEvents;
+    chrono::steady_clock::time_point origin;
+    uint64_t originCycles;
+
+    Profiler() : traceLimit(DEFAULT_TRACE_LIMIT), droppedEvents(0),
+                 origin(chrono::steady_clock::now()), originCycles(readCycles()) {}
+
+    static void writeJsonString(ostream &out, const string &s)
+    {
+        out << '"';
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if ((unsigned char)c < 0x20)
+                out << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xF] << "0123456789abcdef"[c & 0xF];
+            else
+                out << c;
+        }
+        out << '"';
+    }
+
+public:
+    static Profiler &instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    ZoneStats &zone(ProfileZone z) { return zones[z]; }
+
+    void recordStrategy(const string &name, const StrategyProfile &p)
+    {
+        lock_guard<mutex> guard(lock);
+        strategies[name].merge(p);
+    }
+
+    void recordTrace(ProfileZone z, chrono::steady_clock::time_point begin,
+                     chrono::steady_clock::time_point end)
+    {
+        TraceEvent e;
+        e.zone = z;
+        e.thread = profileThreadIndex();
+        e.beginNs = chrono::duration_cast<chrono::nanoseconds>(begin - origin).count();
+        e.durationNs = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+
+        lock_guard<mutex> guard(lock);
+        if (trace.size() < traceLimit)
+            trace.push_back(e);
+        else
+            droppedEvents++;
+    }
+
+    // 트레이스 이벤트 최대 개수 (넘으면 버리고 개수만 센다)
+    void setTraceLimit(size_t limit)
+    {
+        lock_guard<mutex> guard(lock);
+        traceLimit = limit;
+    }
+
+    // 시작 이후 경과 시간으로 추정한 사이클/ns
+    double cyclesPerNs() const
+    {
+        int64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+        return (ns > 0) ? (double)(readCycles() - originCycles) / ns : 0.0;
+    }
+
+    void reset()
+    {
+        for (ZoneStats &z : zones)
+            z.clear();
+        lock_guard<mutex> guard(lock);
+        strategies.clear();
+        trace.clear();
+        droppedEvents = 0;
+    }
+
+    // 대시보드용 요약 JSON
+    void writeJson(ostream &out)
+    {
+        lock_guard<mutex> guard(lock);
+        out << "{\"cyclesPerNs\":" << fixed << setprecision(4) << cyclesPerNs();
+        out << ",\"allocations\":{\"count\":" << profileAllocCount.load(memory_order_relaxed)
+            << ",\"bytes\":" << profileAllocBytes.load(memory_order_relaxed)
+            << ",\"frees\":" << profileFreeCount.load(memory_order_relaxed) << "}";
+
+        out << ",\"zones\":[";
+        for (int z = 0; z < ZONE_COUNT; ++z)
+        {
+            const ZoneStats &s = zones[z];
+            uint64_t calls = s.calls.load(memory_order_relaxed);
+            uint64_t cycles = s.cycles.load(memory_order_relaxed);
+            out << (z ? "," : "") << "{\"name\":\"" << PROFILE_ZONE_NAMES[z] << "\""
+                << ",\"calls\":" << calls << ",\"cycles\":" << cycles
+                << ",\"avgCycles\":" << setprecision(1) << (calls ? (double)cycles / calls : 0.0)
+                << ",\"maxCycles\":" << s.maxCycles.load(memory_order_relaxed)
+                << ",\"allocs\":" << s.allocs.load(memory_order_relaxed) << ",\"histogram\":[";
+            // 비어 있지 않은 칸만 (상한 사이클, 개수)
+            bool first = true;
+            for (int k = 0; k < ZoneStats::BUCKETS; ++k)
+            {
+                uint64_t n = s.buckets[k].load(memory_order_relaxed);
+                if (n == 0)
+                    continue;
+                out << (first ? "" : ",") << "{\"ltCycles\":" << (uint64_t(2) << k) << ",\"count\":" << n << "}";
+                first = false;
+            }
+            out << "]}";
+        }
+
+        out << "],\"strategies\":[";
+        bool first = true;
+        for (const auto &kv : strategies)
+        {
+            const StrategyProfile &p = kv.second;
+            out << (first ? "" : ",") << "{\"name\":";
+            writeJsonString(out, kv.first);
+            out << ",\"calls\":" << p.calls << ",\"ticks\":" << p.ticks << ",\"cycles\":" << p.cycles
+                << ",\"cyclesPerTick\":" << setprecision(2) << (p.ticks ? (double)p.cycles / p.ticks : 0.0)
+                << ",\"maxCallCycles\":" << p.maxCallCycles << ",\"allocs\":" << p.allocs << "}";
+            first = false;
+        }
+        out << "],\"trace\":{\"events\":" << trace.size() << ",\"dropped\":" << droppedEvents << "}}" << endl;
+    }
+
+    // Chrome trace event 형식 (chrome://tracing, Perfetto에서 열림)
+    void writeTrace(ostream &out)
+    {
+        lock_guard<mutex> guard(lock);
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        out << fixed << setprecision(3);
+        for (size_t i = 0; i < trace.size(); ++i)
+        {
+            const TraceEvent &e = trace[i];
+            out << (i ? ",\n" : "\n") << "{\"name\":\"" << PROFILE_ZONE_NAMES[e.zone]
+                << "\",\"cat\":\"oop\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                << ",\"ts\":" << e.beginNs / 1000.0 << ",\"dur\":" << e.durationNs / 1000.0 << "}";
+        }
+        out << "\n]}" << endl;
+    }
+
+    // 요약 JSON과 트레이스를 파일로 저장
+    bool writeFiles(const string &jsonPath, const string &tracePath)
+    {
+        ofstream json(jsonPath.c_str());
+        ofstream traceFile(tracePath.c_str());
+        if (!json || !traceFile)
+            return false;
+        writeJson(json);
+        writeTrace(traceFile);
+        return (bool)json && (bool)traceFile;
+    }
+};
+
+// ProfileScope 클래스 (생성~소멸 구간을 ZoneStats에 기록, traced면 트레이스 이벤트도 남김)
+class ProfileScope
+{
+private:
+    ProfileZone zone;
+    bool traced;
+    uint64_t startAllocs;
+    chrono::steady_clock::time_point startTime;
+    uint64_t startCycles;
+
+public:
+    ProfileScope(ProfileZone z, bool trace)
+        : zone(z), traced(trace), startAllocs(profileThreadAllocs)
+    {
+        if (traced)
+            startTime = chrono::steady_clock::now();
+        startCycles = readCycles();
+    }
+
+    ~ProfileScope()
+    {
+        uint64_t cycles = readCycles() - startCycles;
+        Profiler &p = Profiler::instance();
+        p.zone(zone).add(cycles, profileThreadAllocs - startAllocs);
+        if (traced)
+            p.recordTrace(zone, startTime, chrono::steady_clock::now());
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+// StrategyProfileScope 클래스 (전략 호출 한 번을 재서 Profiler에 넘김)
+class StrategyProfileScope
+{
+private:
+    string name; // 이름은 호출 전에 복사 (할당이 계측에 섞이지 않도록)
+    uint64_t ticks;
+    uint64_t startAllocs;
+    uint64_t startCycles;
+
+public:
+    StrategyProfileScope(const string &strategyName, uint64_t tickCount)
+        : name(strategyName), ticks(tickCount), startAllocs(profileThreadAllocs), startCycles(readCycles()) {}
+
+    ~StrategyProfileScope()
+    {
+        StrategyProfile p;
+        p.add(readCycles() - startCycles, ticks, profileThreadAllocs - startAllocs);
+        Profiler::instance().recordStrategy(name, p);
+    }
+
+    StrategyProfileScope(const StrategyProfileScope &) = delete;
+    StrategyProfileScope &operator=(const StrategyProfileScope &) = delete;
+};
+
+#define OOP_PROFILE_CONCAT2(a, b) a##b
+#define OOP_PROFILE_CONCAT(a, b) OOP_PROFILE_CONCAT2(a, b)
+// 구간 통계 + 트레이스 이벤트 (호출이 드문 구간용)
+#define OOP_PROFILE_SCOPE(zone) ProfileScope OOP_PROFILE_CONCAT(profileScope_, __LINE__)(zone, true)
+// 구간 통계만 (주문처럼 호출이 잦은 구간용)
+#define OOP_PROFILE_LATENCY(zone) ProfileScope OOP_PROFILE_CONCAT(profileScope_, __LINE__)(zone, false)
+
+#else
+
+#define OOP_PROFILE_SCOPE(zone) ((void)0)
+#define OOP_PROFILE_LATENCY(zone) ((void)0)
+
+#endif
+
+// == 기본 클래스 설계 ==
+
+// MappedFile 클래스 (읽기 전용 파일 매핑)
+// mmap을 쓸 수 없는 환경에서는 파일 전체를 버퍼로 읽어 둔다.
+class MappedFile
+{
+private:
+    const char *base;
+    size_t size;
+    bool mapped;
+    vector<char> buffer;
+
+public:
+    MappedFile() : base(nullptr), size(0), mapped(false) {}
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (mapped)
+            munmap((void *)base, size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // 빈 파일이거나 열 수 없으면 false
+    bool open(const string &path)
+    {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+        size_t fileSize = (size_t)st.st_size;
+
+        void *addr = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            return false;
+        base = (const char *)addr;
+        size = fileSize;
+        mapped = true;
+#else
+        FILE *fp = fopen(path.c_str(), "rb");
+        if (!fp)
+            return false;
+        fseek(fp, 0, SEEK_END);
+        long len = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (len <= 0)
+        {
+            fclose(fp);
+            return false;
+        }
+        buffer.resize((size_t)len);
+        bool readOk = fread(buffer.data(), 1, (size_t)len, fp) == (size_t)len;
+        fclose(fp);
+        if (!readOk)
+            return false;
+        base = buffer.data();
+        size = (size_t)len;
+#endif
+        return true;
+    }
+
+    const char *data() const { return base; }
+    size_t getSize() const { return size; }
+};
+
+// PriceColumnStore 클래스 (바이너리 컬럼형 가격 저장소)
+// 파일 구조: [헤더 64바이트][timestamp][open][high][low][close][volume]
+// 각 컬럼은 연속 배열이며, 파일을 메모리 매핑해서 복사 없이 바로 읽는다.
+class PriceColumnStore
+{
+public:
+    enum Column
+    {
+        TIMESTAMP,
+        OPEN,
+        HIGH,
+        LOW,
+        CLOSE,
+        VOLUME,
+        COLUMN_COUNT
+    };
+
+private:
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t rowCount;
+        uint64_t offsets[COLUMN_COUNT];
+    };
+
+    static const uint32_t FORMAT_VERSION = 1;
+
+    MappedFile file;
+    size_t rowCount;
+    uint64_t offsets[COLUMN_COUNT];
+
+    PriceColumnStore() : rowCount(0) {}
+
+    static size_t columnWidth(int col)
+    {
+        return (col == TIMESTAMP || col == VOLUME) ? sizeof(int64_t) : sizeof(int32_t);
+    }
+
+    template <typename T>
+    const T *column(int col) const
+    {
+        return reinterpret_cast<const T *>(file.data() + offsets[col]);
+    }
+
+public:
+    PriceColumnStore(const PriceColumnStore &) = delete;
+    PriceColumnStore &operator=(const PriceColumnStore &) = delete;
+
+    // 봉 데이터를 컬럼형 파일로 저장
+    static bool write(const string &path, const vector<PriceBar> &bars)
+    {
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "OOPC", 4);
+        header.version = FORMAT_VERSION;
+        header.rowCount = bars.size();
+
+        uint64_t offset = sizeof(FileHeader);
+        for (int col = 0; col < COLUMN_COUNT; ++col)
+        {
+            header.offsets[col] = offset;
+            offset += columnWidth(col) * bars.size();
+        }
+
+        FILE *fp = fopen(path.c_str(), "wb");
+        if (!fp)
+            return false;
+
+        bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+        vector<int64_t> wide(bars.size());
+        vector<int32_t> narrow(bars.size());
+        for (int col = 0; col < COLUMN_COUNT && ok; ++col)
+        {
+            for (size_t i = 0; i < bars.size(); ++i)
+            {
+                const PriceBar &b = bars[i];
+                switch (col)
+                {
+                case TIMESTAMP: wide[i] = b.timestamp; break;
+                case OPEN: narrow[i] = b.open; break;
+                case HIGH: narrow[i] = b.high; break;
+                case LOW: narrow[i] = b.low; break;
+                case CLOSE: narrow[i] = b.close; break;
+                case VOLUME: wide[i] = b.volume; break;
+                }
+            }
+            if (bars.empty())
+                continue;
+            if (columnWidth(col) == sizeof(int64_t))
+                ok = fwrite(wide.data(), sizeof(int64_t), wide.size(), fp) == wide.size();
+            else
+                ok = fwrite(narrow.data(), sizeof(int32_t), narrow.size(), fp) == narrow.size();
+        }
+
+        if (fclose(fp) != 0)
+            ok = false;
+        return ok;
+    }
+
+    // 파일을 열어 매핑 (실패 시 nullptr)
+    static shared_ptr<PriceColumnStore> open(const string &path)
+    {
+        shared_ptr<PriceColumnStore> store(new PriceColumnStore());
+        if (!store->file.open(path) || store->file.getSize() < sizeof(FileHeader))
+            return nullptr;
+        size_t fileSize = store->file.getSize();
+
+        FileHeader header;
+        memcpy(&header, store->file.data(), sizeof(header));
+        if (memcmp(header.magic, "OOPC", 4) != 0 || header.version != FORMAT_VERSION)
+            return nullptr;
+
+        // 헤더 값은 신뢰할 수 없으므로 offset + width * rowCount를 직접 계산하지 않고
+        // 나눗셈으로 비교해 오버플로로 범위 검사를 통과하는 일을 막는다
+        for (int col = 0; col < COLUMN_COUNT; ++col)
+        {
+            uint64_t offset = header.offsets[col];
+            uint64_t width = columnWidth(col);
+            if (offset % width != 0 || offset > fileSize || header.rowCount > (fileSize - offset) / width)
+                return nullptr;
+            store->offsets[col] = header.offsets[col];
+        }
+        store->rowCount = (size_t)header.rowCount;
+        return store;
+    }
+
+    size_t getRowCount() const { return rowCount; }
+    const int64_t *getTimestamps() const { return column<int64_t>(TIMESTAMP); }
+    const int32_t *getOpens() const { return column<int32_t>(OPEN); }
+    const int32_t *getHighs() const { return column<int32_t>(HIGH); }
+    const int32_t *getLows() const { return column<int32_t>(LOW); }
+    const int32_t *getCloses() const { return column<int32_t>(CLOSE); }
+    const int64_t *getVolumes() const { return column<int64_t>(VOLUME); }
+};
+
+// Arena 클래스 (한 번의 실행에 쓰는 메모리를 블록 단위로 몰아서 할당)
+// 개별 해제는 하지 않고 reset()으로 전체를 O(1)에 되돌린다.
+// 소멸자 호출은 사용하는 쪽의 책임이다.
+class Arena
+{
+private:
+    struct Block
+    {
+        char *data;
+        size_t size;
+    };
+
+    vector<Block> blocks;
+    size_t current; // 사용 중인 블록
+    size_t offset;  // 현재 블록에서 사용한 바이트
+    size_t blockSize;
+
+    void *tryAllocate(size_t size, size_t align)
+    {
+        Block &block = blocks[current];
+        uintptr_t start = (uintptr_t)(block.data + offset);
+        uintptr_t aligned = (start + align - 1) & ~(uintptr_t)(align - 1);
+        size_t used = (size_t)(aligned - (uintptr_t)block.data) + size;
+        if (used > block.size)
+            return nullptr;
+        offset = used;
+        return (void *)aligned;
+    }
+
+public:
+    explicit Arena(size_t defaultBlockSize = 64 * 1024)
+        : current(0), offset(0), blockSize(defaultBlockSize) {}
+
+    ~Arena()
+    {
+        for (Block &block : blocks)
+            ::operator delete(block.data);
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t align = alignof(max_align_t))
+    {
+        // reset 이후에는 이미 잡아 둔 블록부터 다시 쓴다
+        while (current < blocks.size())
+        {
+            void *p = tryAllocate(size, align);
+            if (p)
+                return p;
+            if (current + 1 == blocks.size())
+                break;
+            ++current;
+            offset = 0;
+        }
+
+        size_t newSize = max(blockSize, size + align);
+        Block block = {(char *)::operator new(newSize), newSize};
+        blocks.push_back(block);
+        current = blocks.size() - 1;
+        offset = 0;
+        return tryAllocate(size, align);
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+    }
+
+    void reset()
+    {
+        current = 0;
+        offset = 0;
+    }
+
+    size_t getReservedBytes() const
+    {
+        size_t total = 0;
+        for (const Block &block : blocks)
+            total += block.size;
+        return total;
+    }
+};
+
+// ArenaAllocator (STL 컨테이너용, arena가 없으면 일반 힙 사용)
+template <typename T>
+struct ArenaAllocator
+{
+    typedef T value_type;
+    typedef true_type propagate_on_container_copy_assignment;
+    typedef true_type propagate_on_container_move_assignment;
+    typedef true_type propagate_on_container_swap;
+
+    Arena *arena;
+
+    ArenaAllocator(Arena *a = nullptr) noexcept : arena(a) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena(other.arena) {}
+
+    T *allocate(size_t n)
+    {
+        if (arena)
+            return (T *)arena->allocate(n * sizeof(T), alignof(T));
+        return (T *)::operator new(n * sizeof(T));
+    }
+
+    // arena 메모리는 reset 때 한꺼번에 돌아간다
+    void deallocate(T *p, size_t) noexcept
+    {
+        if (!arena)
+            ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena == b.arena; }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena != b.arena; }
+
+typedef vector<long, ArenaAllocator<long>> EquityBuffer;
+
+// 지표 종류 (기간 period는 가격 칸 수)
+enum IndicatorType
+{
+    INDICATOR_SMA,         // 단순 이동 평균
+    INDICATOR_EMA,         // 지수 이동 평균 (alpha = 2 / (period + 1))
+    INDICATOR_ROLLING_STD, // 이동 표본 표준편차
+    INDICATOR_ROLLING_MAX, // 이동 최고가
+    INDICATOR_ROLLING_MIN  // 이동 최저가
+};
+
+// IndicatorCache 클래스 (가격 이력의 지표 시계열을 처음 요청될 때 한 번만 계산해 공유)
+// i번째 값은 prices[i - period + 1 .. i] 구간 기준이며, 앞쪽 period - 1칸은 있는 만큼만 쓴다.
+// 여러 스레드가 동시에 요청해도 같은 지표는 한 번만 계산되고, 반환한 배열은 bind 전까지 유효하다.
+// 이동 합은 가격을 정수로 누적한 prefix 합의 차로 구해 구간 이동에 따른 오차가 없다.
+class IndicatorCache
+{
+private:
+    struct Series
+    {
+        once_flag once;
+        vector<double> values;
+    };
+
+    // 가운데 값 shift 기준 정수 prefix 합 (2^64 나머지 연산, 구간 합이 범위 안이면 정확)
+    struct PrefixSums
+    {
+        once_flag once;
+        int shift;
+        int64_t range; // 최고가 - 최저가
+        vector<uint64_t> sum;
+        vector<uint64_t> sumSq;
+    };
+
+    const int *prices;
+    size_t length;
+    mutable mutex lock; // series 맵과 prefix 포인터만 보호 (계산은 잠금 밖에서)
+    mutable map<pair<int, size_t>, shared_ptr<Series>> series;
+    mutable shared_ptr<PrefixSums> prefix;
+
+    const PrefixSums &prefixSums() const
+    {
+        shared_ptr<PrefixSums> entry;
+        {
+            lock_guard<mutex> guard(lock);
+            if (!prefix)
+                prefix = make_shared<PrefixSums>();
+            entry = prefix;
+        }
+        call_once(entry->once, [&]()
+                  {
+            int lo = *min_element(prices, prices + length);
+            int hi = *max_element(prices, prices + length);
+            entry->shift = lo + (hi - lo) / 2;
+            entry->range = (int64_t)hi - lo;
+            entry->sum.resize(length + 1);
+            entry->sumSq.resize(length + 1);
+            entry->sum[0] = 0;
+            entry->sumSq[0] = 0;
+            for (size_t i = 0; i < length; ++i)
+            {
+                uint64_t d = (uint64_t)(int64_t)(prices[i] - entry->shift);
+                entry->sum[i + 1] = entry->sum[i] + d;
+                entry->sumSq[i + 1] = entry->sumSq[i] + d * d;
+            } });
+        return *entry;
+    }
+
+    // 앞쪽 미완성 구간을 포함한 i번째 구간의 시작
+    static size_t windowBegin(size_t i, size_t period)
+    {
+        return (i + 1 > period) ? i + 1 - period : 0;
+    }
+
+    void computeSma(size_t period, double *out) const
+    {
+        const PrefixSums &p = prefixSums();
+        const uint64_t *sum = p.sum.data();
+        size_t warm = min(period - 1, length);
+        for (size_t i = 0; i < warm; ++i)
+            out[i] = p.shift + (double)(int64_t)sum[i + 1] / (i + 1);
+        // 구간이 꽉 찬 뒤에는 분기 없는 루프 (벡터화)
+        double inv = 1.0 / period;
+        for (size_t i = warm; i < length; ++i)
+            out[i] = p.shift + (double)(int64_t)(sum[i + 1] - sum[i + 1 - period]) * inv;
+    }
+
+    void computeEma(size_t period, double *out) const
+    {
+        double alpha = 2.0 / (period + 1);
+        double ema = prices[0];
+        for (size_t i = 0; i < length; ++i)
+        {
+            ema += alpha * (prices[i] - ema);
+            out[i] = ema;
+        }
+    }
+
+    void computeStd(size_t period, double *out) const
+    {
+        const PrefixSums &p = prefixSums();
+        // n * sumSq - sum^2 >= 0은 n * range <= 2^32이면 64비트 안에서 정확하다
+        if ((double)period * (double)p.range <= 4294967296.0)
+        {
+            const uint64_t *sum = p.sum.data();
+            const uint64_t *sumSq = p.sumSq.data();
+            for (size_t i = 0; i < length; ++i)
+            {
+                size_t begin = windowBegin(i, period);
+                uint64_t n = i + 1 - begin;
+                uint64_t s1 = sum[i + 1] - sum[begin];
+                uint64_t s2 = sumSq[i + 1] - sumSq[begin];
+                uint64_t m = n * s2 - s1 * s1;
+                out[i] = (n > 1) ? sqrt((double)m / ((double)n * (n - 1))) : 0.0;
+            }
+            return;
+        }
+
+        // 변동 폭이 너무 크면 구간마다 두 번 훑어서 계산
+        for (size_t i = 0; i < length; ++i)
+        {
+            size_t begin = windowBegin(i, period);
+            size_t n = i + 1 - begin;
+            double mean = 0.0;
+            for (size_t j = begin; j <= i; ++j)
+                mean += prices[j];
+            mean /= n;
+            double sq = 0.0;
+            for (size_t j = begin; j <= i; ++j)
+                sq += (prices[j] - mean) * (prices[j] - mean);
+            out[i] = (n > 1) ? sqrt(sq / (n - 1)) : 0.0;
+        }
+    }
+
+    // van Herk/Gil-Werman: period 크기 블록의 앞쪽 누적/뒤쪽 누적 극값을 합쳐 구간마다 O(1)
+    template <typename Pick>
+    void computeExtreme(size_t period, double *out, Pick pick) const
+    {
+        vector<int> forward(length), backward(length);
+        for (size_t b = 0; b < length; b += period)
+        {
+            size_t e = min(b + period, length);
+            forward[b] = prices[b];
+            for (size_t i = b + 1; i < e; ++i)
+                forward[i] = pick(forward[i - 1], prices[i]);
+            backward[e - 1] = prices[e - 1];
+            for (size_t i = e - 1; i > b; --i)
+                backward[i - 1] = pick(backward[i], prices[i - 1]);
+        }
+
+        size_t warm = min(period - 1, length);
+        for (size_t i = 0; i < warm; ++i)
+            out[i] = forward[i]; // 첫 블록 안에서는 앞쪽 누적이 곧 구간 극값
+        const int *f = forward.data();
+        const int *bw = backward.data();
+        for (size_t i = warm; i < length; ++i)
+            out[i] = pick(bw[i + 1 - period], f[i]);
+    }
+
+    void compute(IndicatorType type, size_t period, vector<double> &values) const
+    {
+        values.resize(length);
+        double *out = values.data();
+        switch (type)
+        {
+        case INDICATOR_SMA:
+            computeSma(period, out);
+            break;
+        case INDICATOR_EMA:
+            computeEma(period, out);
+            break;
+        case INDICATOR_ROLLING_STD:
+            computeStd(period, out);
+            break;
+        case INDICATOR_ROLLING_MAX:
+            computeExtreme(period, out, [](int a, int b)
+                           { return a > b ? a : b; });
+            break;
+        case INDICATOR_ROLLING_MIN:
+            computeExtreme(period, out, [](int a, int b)
+                           { return a < b ? a : b; });
+            break;
+        }
+    }
+
+public:
+    IndicatorCache() : prices(nullptr), length(0) {}
+
+    // 가격 이력이 바뀔 때 Stock이 호출 (계산해 둔 지표는 버린다)
+    // 다른 스레드가 지표를 읽는 중에 호출하면 안 된다
+    void bind(const int *data, size_t len)
+    {
+        prices = data;
+        length = len;
+        if (!series.empty())
+            series.clear();
+        prefix.reset();
+    }
+
+    // 길이 getLength()인 지표 배열 (이력이 비었거나 period가 0이면 nullptr)
+    const double *get(IndicatorType type, size_t period) const
+    {
+        if (period == 0 || length == 0 || !prices)
+            return nullptr;
+
+        shared_ptr<Series> entry;
+        {
+            lock_guard<mutex> guard(lock);
+            shared_ptr<Series> &slot = series[make_pair((int)type, period)];
+            if (!slot)
+                slot = make_shared<Series>();
+            entry = slot;
+        }
+        call_once(entry->once, [&]()
+                  { compute(type, period, entry->values); });
+        return entry->values.data();
+    }
+
+    const double *sma(size_t period) const { return get(INDICATOR_SMA, period); }
+    const double *ema(size_t period) const { return get(INDICATOR_EMA, period); }
+    const double *rollingStd(size_t period) const { return get(INDICATOR_ROLLING_STD, period); }
+    const double *rollingMax(size_t period) const { return get(INDICATOR_ROLLING_MAX, period); }
+    const double *rollingMin(size_t period) const { return get(INDICATOR_ROLLING_MIN, period); }
+
+    size_t getLength() const { return length; }
+
+    size_t getSeriesCount() const
+    {
+        lock_guard<mutex> guard(lock);
+        return series.size();
+    }
+};
+
+// Stock 클래스
+class Stock
+{
+private:
+    string code;
+    string name;
+    int currentPrice;
+    int previousPrice;
+    int symbolId; // Market에 등록될 때 부여되는 고유 번호 (-1: 미등록)
+    vector<int> priceHistory;
+    shared_ptr<const PriceColumnStore> historyStore; // 매핑된 저장소 (있으면 종가 컬럼 사용)
+    const int *historyData;
+    size_t historyLength;
+    IndicatorCache indicators; // 가격 이력 기준 지표 (이력이 바뀌면 다시 bind)
+
+    // 매핑된 데이터에 값을 추가해야 하면 먼저 복사해서 소유
+    void detachStore()
+    {
+        if (!historyStore)
+            return;
+        priceHistory.assign(historyData, historyData + historyLength);
+        historyStore.reset();
+    }
+
+    void historyChanged()
+    {
+        indicators.bind(historyData, historyLength);
+    }
+
+public:
+    Stock(string c, string n, int p)
+        : code(c), name(n), currentPrice(p), previousPrice(p), symbolId(-1),
+          historyData(nullptr), historyLength(0) {}
+
+    // historyData가 자기 자신의 버퍼를 가리키므로 복사 금지
+    Stock(const Stock &) = delete;
+    Stock &operator=(const Stock &) = delete;
+
+    void updatePrice(int newPrice)
+    {
+        previousPrice = currentPrice;
+        currentPrice = newPrice;
+    }
+
+    void addPriceHistory(int price)
+    {
+        detachStore();
+        priceHistory.push_back(price);
+        historyData = priceHistory.data();
+        historyLength = priceHistory.size();
+        historyChanged();
+    }
+
+    // 기존 버퍼를 재사용해 길이 len의 쓰기 가능한 이력을 준비
+    int *prepareHistory(size_t len)
+    {
+        historyStore.reset();
+        priceHistory.resize(len);
+        historyData = priceHistory.data();
+        historyLength = len;
+        historyChanged(); // 지표는 값을 채운 뒤 처음 요청될 때 계산된다
+        return priceHistory.data();
+    }
+
+    // 이미 만들어진 가격 배열을 통째로 넘겨받는다
+    void setPriceHistory(vector<int> &&prices)
+    {
+        historyStore.reset();
+        priceHistory = move(prices);
+        historyData = priceHistory.data();
+        historyLength = priceHistory.size();
+        historyChanged();
+    }
+
+    // 컬럼형 저장소의 종가를 복사 없이 가격 이력으로 사용
+    void attachHistory(shared_ptr<const PriceColumnStore> store)
+    {
+        priceHistory.clear();
+        priceHistory.shrink_to_fit();
+        historyStore = store;
+        historyData = store ? store->getCloses() : nullptr;
+        historyLength = store ? store->getRowCount() : 0;
+        historyChanged();
+    }
+
+    bool loadHistory(const string &path)
+    {
+        shared_ptr<PriceColumnStore> store = PriceColumnStore::open(path);
+        if (!store)
+            return false;
+        attachHistory(store);
+        return true;
+    }
+
+    double getChangeRate() const
+    {
+        if (previousPrice == 0)
+            return 0.0;
+        return (double)(currentPrice - previousPrice) / previousPrice * 100.0;
+    }
+
+    int getPriceAt(size_t idx) const
+    {
+        if (idx >= historyLength)
+            return -1;
+        return historyData[idx];
+    }
+
+    size_t getHistoryLength() const
+    {
+        return historyLength;
+    }
+
+    const int *getHistoryData() const { return historyData; }
+    const PriceColumnStore *getHistoryStore() const { return historyStore.get(); }
+    // 읽기 전용으로 공유되는 지표 캐시 (스윕 워커들이 동시에 써도 된다)
+    const IndicatorCache &getIndicators() const { return indicators; }
+
+    const string &getCode() const { return code; }
+    const string &getName() const { return name; }
+    int getCurrentPrice() const { return currentPrice; }
+    int getPreviousPrice() const { return previousPrice; }
+    int getSymbolId() const { return symbolId; }
+    void setSymbolId(int id) { symbolId = id; }
+};
+
+// Position 클래스
+class Position
+{
+private:
+    Stock *stock;
+    int quantity;
+    int avgPrice;
+    Money totalInvested;
+
+public:
+    Position(Stock *s = nullptr, int qty = 0, int price = 0)
+        : stock(s), quantity(qty), avgPrice(price)
+    {
+        if (qty > 0)
+        {
+            totalInvested = Money::of(price, qty);
+        }
+    }
+
+    // 스냅샷 복원용 (평단과 투자원금을 저장된 값 그대로)
+    Position(Stock *s, int qty, int price, Money invested)
+        : stock(s), quantity(qty), avgPrice(price), totalInvested(invested) {}
+
+    void addQuantity(int qty, int price)
+    {
+        totalInvested += Money::of(price, qty);
+        quantity += qty;
+        avgPrice = (quantity > 0) ? (int)(totalInvested.won / quantity) : 0;
+    }
+
+    bool reduceQuantity(int qty)
+    {
+        if (qty > quantity)
+            return false;
+        quantity -= qty;
+        // 매도 시에는 평균단가가 변하지 않고 totalInvested 비례 감소
+        if (quantity == 0)
+        {
+            totalInvested = Money();
+            avgPrice = 0;
+        }
+        else
+        {
+            totalInvested = Money::of(avgPrice, quantity);
+        }
+        return true;
+    }
+
+    Money getCurrentValue() const
+    {
+        if (!stock)
+            return Money();
+        return Money::of(stock->getCurrentPrice(), quantity);
+    }
+
+    Money getProfit() const
+    {
+        return getCurrentValue() - totalInvested;
+    }
+
+    double getProfitRate() const
+    {
+        if (totalInvested.won == 0)
+            return 0.0;
+        return (double)getProfit().won / totalInvested.won * 100.0;
+    }
+
+    int getQuantity() const { return quantity; }
+    int getAvgPrice() const { return avgPrice; }
+    Money getTotalInvested() const { return totalInvested; }
+    Stock *getStock() const { return stock; }
+};
+
+// PriceListener 클래스 (시세 변경 알림을 받는 인터페이스)
+class PriceListener
+{
+public:
+    virtual ~PriceListener() {}
+    virtual void onPriceUpdate(int symbolId, int newPrice) = 0;
+    // 구독 중인 Market이 소멸할 때 (이후 그 Market을 가리키면 안 된다)
+    virtual void onMarketClosed(const Market &m) {}
+};
+
+// PriceStepListener 클래스 (Market의 시세 변경 묶음이 끝날 때마다 한 번 알림)
+// symbolIds[0..count)가 이번에 바뀐 종목이다.
+class PriceStepListener
+{
+public:
+    virtual ~PriceStepListener() {}
+    virtual void onPriceStep(const Market &m, const int *symbolIds, size_t count) = 0;
+};
+
+// Portfolio 클래스
+// 보유 종목을 symbolId로 바로 찾는 연속 배열에 두고, 평가금액/투자원금 합계를
+// 체결과 시세 변경 때마다 갱신해 합계 조회를 O(1)로 만든다.
+// (시세는 Market을 통해 바뀌어야 한다 - 직접 바꾼 경우 revalue() 호출)
+class Portfolio : public PriceListener
+{
+private:
+    vector<Position> positions; // 보유 종목 (빈 칸 없이 연속)
+    vector<int> markPrices;     // positions[i]를 평가한 가격
+    vector<int> slotBySymbol;   // symbolId -> positions 위치 (-1: 미보유)
+    Money totalValue;           // 보유 수량 x 평가 가격 합계
+    Money totalInvested;
+    Market *priceSource;        // 보유 종목이 속한 Market (소멸하면 nullptr)
+
+    int findSlot(int symbolId) const
+    {
+        if (symbolId < 0 || symbolId >= (int)slotBySymbol.size())
+            return -1;
+        return slotBySymbol[symbolId];
+    }
+
+    // 코드 조회는 선형 탐색 (주문 처리 경로는 symbolId를 쓴다)
+    int findSlot(const string &code) const
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            if (positions[i].getStock()->getCode() == code)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    void markSlot(int slot, int price)
+    {
+        totalValue += Money::of(price - markPrices[slot], positions[slot].getQuantity());
+        markPrices[slot] = price;
+    }
+
+    // 마지막 원소와 자리 교환 후 제거
+    void removeSlot(int slot)
+    {
+        int symbolId = positions[slot].getStock()->getSymbolId();
+        int last = (int)positions.size() - 1;
+        if (slot != last)
+        {
+            positions[slot] = positions[last];
+            markPrices[slot] = markPrices[last];
+            slotBySymbol[positions[slot].getStock()->getSymbolId()] = slot;
+        }
+        positions.pop_back();
+        markPrices.pop_back();
+        slotBySymbol[symbolId] = -1;
+    }
+
+public:
+    Portfolio() : priceSource(nullptr) {}
+
+    // Market에 리스너로 등록되므로 복사 금지
+    Portfolio(const Portfolio &) = delete;
+    Portfolio &operator=(const Portfolio &) = delete;
+
+    // Market에 등록된 종목만 보유할 수 있다 (symbolId가 없으면 false)
+    bool addPosition(Stock *s, int qty, int price)
+    {
+        int symbolId = s->getSymbolId();
+        if (symbolId < 0)
+            return false;
+        if (symbolId >= (int)slotBySymbol.size())
+            slotBySymbol.resize(symbolId + 1, -1);
+
+        int slot = slotBySymbol[symbolId];
+        if (slot < 0)
+        {
+            slot = (int)positions.size();
+            slotBySymbol[symbolId] = slot;
+            positions.push_back(Position(s));
+            markPrices.push_back(s->getCurrentPrice());
+        }
+        else
+        {
+            markSlot(slot, s->getCurrentPrice());
+        }
+
+        Position &pos = positions[slot];
+        totalInvested -= pos.getTotalInvested();
+        pos.addQuantity(qty, price);
+        totalInvested += pos.getTotalInvested();
+        totalValue += Money::of(markPrices[slot], qty);
+        return true;
+    }
+
+    bool reducePosition(int symbolId, int qty)
+    {
+        int slot = findSlot(symbolId);
+        if (slot < 0)
+            return false;
+
+        Position &pos = positions[slot];
+        markSlot(slot, pos.getStock()->getCurrentPrice());
+        Money investedBefore = pos.getTotalInvested();
+        if (!pos.reduceQuantity(qty))
+            return false;
+
+        totalInvested += pos.getTotalInvested() - investedBefore;
+        totalValue -= Money::of(markPrices[slot], qty);
+        if (pos.getQuantity() == 0)
+            removeSlot(slot);
+        return true;
+    }
+
+    bool reducePosition(const string &code, int qty)
+    {
+        int slot = findSlot(code);
+        return slot >= 0 && reducePosition(positions[slot].getStock()->getSymbolId(), qty);
+    }
+
+    Position *getPosition(int symbolId)
+    {
+        int slot = findSlot(symbolId);
+        return (slot < 0) ? nullptr : &positions[slot];
+    }
+
+    Position *getPosition(const string &code)
+    {
+        int slot = findSlot(code);
+        return (slot < 0) ? nullptr : &positions[slot];
+    }
+
+    bool hasPosition(int symbolId) const { return findSlot(symbolId) >= 0; }
+    bool hasPosition(const string &code) const { return findSlot(code) >= 0; }
+
+    // Market 시세 알림 - 보유 종목이면 평가금액 합계만 차이만큼 갱신
+    void onPriceUpdate(int symbolId, int newPrice) override
+    {
+        int slot = findSlot(symbolId);
+        if (slot >= 0)
+            markSlot(slot, newPrice);
+    }
+
+    void onMarketClosed(const Market &m) override
+    {
+        if (priceSource == &m)
+            priceSource = nullptr;
+    }
+
+    void setPriceSource(Market *m) { priceSource = m; }
+    Market *getPriceSource() const { return priceSource; }
+
+    // 전 종목을 현재가로 다시 평가 (Market을 거치지 않고 시세를 바꾼 경우)
+    void revalue()
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+            markSlot((int)i, positions[i].getStock()->getCurrentPrice());
+    }
+
+    // 체크포인트용 (종목은 symbolId로 저장, 평가 가격은 복원 시점 현재가를 쓴다)
+    void save(SnapshotWriter &w) const
+    {
+        w.pod((uint64_t)positions.size());
+        for (const Position &pos : positions)
+        {
+            w.pod(pos.getStock()->getSymbolId());
+            w.pod(pos.getQuantity());
+            w.pod(pos.getAvgPrice());
+            w.pod(pos.getTotalInvested());
+        }
+    }
+
+    // 빈 포트폴리오에만 복원된다 (stocks는 symbolId 순 종목 목록, 예: Market::getStocks())
+    // 없는 종목이 있거나 데이터가 잘렸으면 false이고 내용은 바뀌지 않는다
+    bool restore(SnapshotReader &r, const vector<Stock *> &stocks)
+    {
+        uint64_t count = 0;
+        if (!positions.empty() || !r.pod(count))
+            return false;
+
+        vector<Position> restored;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            int symbolId = -1, qty = 0, price = 0;
+            Money invested;
+            if (!r.pod(symbolId) || !r.pod(qty) || !r.pod(price) || !r.pod(invested))
+                return false;
+            if (symbolId < 0 || symbolId >= (int)stocks.size() || qty <= 0)
+                return false;
+            restored.push_back(Position(stocks[symbolId], qty, price, invested));
+        }
+
+        for (const Position &pos : restored)
+        {
+            int symbolId = pos.getStock()->getSymbolId();
+            if (symbolId >= (int)slotBySymbol.size())
+                slotBySymbol.resize(symbolId + 1, -1);
+            slotBySymbol[symbolId] = (int)positions.size();
+            positions.push_back(pos);
+            markPrices.push_back(pos.getStock()->getCurrentPrice());
+            totalValue += pos.getCurrentValue();
+            totalInvested += pos.getTotalInvested();
+        }
+        return true;
+    }
+
+    Money getTotalValue() const { return totalValue; }
+    Money getTotalInvested() const { return totalInvested; }
+    Money getTotalProfit() const { return totalValue - totalInvested; }
+
+    size_t getPositionCount() const { return positions.size(); }
+    const vector<Position> &getPositions() const { return positions; }
+
+    void printPortfolio() const
+    {
+        // 출력은 종목 코드 순
+        vector<const Position *> sorted;
+        sorted.reserve(positions.size());
+        for (const Position &pos : positions)
+            sorted.push_back(&pos);
+        sort(sorted.begin(), sorted.end(), [](const Position *a, const Position *b)
+             { return a->getStock()->getCode() < b->getStock()->getCode(); });
+
+        cout << "=== 보유 종목 현황 ===" << endl;
+        for (const Position *pos : sorted)
+        {
+            cout << "[" << pos->getStock()->getCode() << "] " << pos->getStock()->getName()
+                 << " | 수량: " << pos->getQuantity()
+                 << " | 평단: " << pos->getAvgPrice()
+                 << " | 현재가: " << pos->getStock()->getCurrentPrice()
+                 << " | 수익률: " << fixed << setprecision(2) << pos->getProfitRate() << "%" << endl;
+        }
+    }
+};
+
+// IdSequence 클래스 (여러 스레드에서 쓰는 채번기)
+// 스레드마다 번호를 블록 단위로 받아 두고 쓰므로 공유 카운터 경합이 거의 없다.
+// 한 스레드 안에서는 번호가 연속으로 증가한다.
+template <typename Owner>
+class IdSequence
+{
+private:
+    static const int BLOCK_SIZE = 1024;
+    static atomic<int> nextBlockStart;
+    static thread_local int cursor;
+    static thread_local int limit;
+
+public:
+    static int take()
+    {
+        if (cursor == limit)
+        {
+            cursor = nextBlockStart.fetch_add(BLOCK_SIZE, memory_order_relaxed);
+            limit = cursor + BLOCK_SIZE;
+        }
+        return cursor++;
+    }
+
+    // 스냅샷에서 복원한 번호와 겹치지 않도록 이후 블록을 id 다음부터 나눠 준다
+    // (호출 스레드가 받아 둔 블록도 버린다 - 다른 스레드는 복원 전에 번호를 받아 두지 않아야 한다)
+    static void advancePast(int id)
+    {
+        int next = nextBlockStart.load(memory_order_relaxed);
+        while (next <= id && !nextBlockStart.compare_exchange_weak(next, id + 1, memory_order_relaxed))
+        {
+        }
+        if (cursor <= id)
+            cursor = limit;
+    }
+};
+
+template <typename Owner>
+atomic<int> IdSequence<Owner>::nextBlockStart(1);
+template <typename Owner>
+thread_local int IdSequence<Owner>::cursor = 0;
+template <typename Owner>
+thread_local int IdSequence<Owner>::limit = 0;
+
+// Order 클래스
+class Order
+{
+private:
+    int orderId;
+    int symbolId; // Market 종목 번호 (코드/이름은 출력할 때 Stock에서 찾는다)
+    OrderType orderType;
+    PriceType priceType;
+    int requestedPrice;
+    int quantity;
+    OrderStatus status;
+    time_t timestamp;
+
+public:
+    Order(int symbol, OrderType ot, PriceType pt, int price, int qty)
+        : orderId(IdSequence<Order>::take()), symbolId(symbol), orderType(ot),
+          priceType(pt), requestedPrice(price), quantity(qty),
+          status(PENDING), timestamp(time(0)) {}
+
+    void execute() { status = COMPLETED; }
+    void cancel() { status = CANCELLED; }
+
+    bool isPending() const { return status == PENDING; }
+    int getOrderId() const { return orderId; }
+    int getSymbolId() const { return symbolId; }
+    OrderType getOrderType() const { return orderType; }
+    PriceType getPriceType() const { return priceType; }
+    int getRequestedPrice() const { return requestedPrice; }
+    int getQuantity() const { return quantity; }
+
+    // 지정가 주문이 현재가에서 체결 가능한지 (시장가는 항상 가능)
+    bool isMarketable(int currentPrice) const
+    {
+        if (priceType == MARKET)
+            return true;
+        return (orderType == BUY) ? currentPrice <= requestedPrice
+                                  : currentPrice >= requestedPrice;
+    }
+
+    // stock은 symbolId에 해당하는 종목 (없으면 nullptr)
+    void printOrder(const Stock *stock) const
+    {
+        string typeStr = (orderType == BUY) ? "매수" : "매도";
+        string statusStr = (status == PENDING) ? "대기" : (status == COMPLETED ? "체결" : "취소");
+        cout << "주문 #" << orderId << " [" << (stock ? stock->getCode() : "?") << "] " << typeStr
+             << " " << quantity << "주 (" << statusStr << ")" << endl;
+    }
+};
+
+static_assert(is_trivially_copyable<Order>::value, "Order는 큐/버퍼에 그대로 복사된다");
+
+// Transaction 클래스
+class Transaction
+{
+private:
+    int transactionId;
+    int orderId;
+    int symbolId; // 종목 코드/이름은 출력할 때 Stock에서 찾는다
+    OrderType type;
+    int quantity;
+    int price;
+    Money totalAmount;
+    Money fee;
+    time_t timestamp;
+
+public:
+    Transaction(const Order &order, const Stock *stock, int execPrice,
+                const FeeSchedule &feeSchedule = DEFAULT_FEE_SCHEDULE)
+        : Transaction(order, stock, execPrice, order.getQuantity(), feeSchedule) {}
+
+    // 부분 체결용 (execQty만큼만 체결)
+    Transaction(const Order &order, const Stock *stock, int execPrice, int execQty,
+                const FeeSchedule &feeSchedule = DEFAULT_FEE_SCHEDULE)
+        : transactionId(IdSequence<Transaction>::take()), orderId(order.getOrderId()),
+          symbolId(stock->getSymbolId()), type(order.getOrderType()),
+          quantity(execQty), price(execPrice), totalAmount(Money::of(execPrice, execQty)),
+          fee(feeSchedule.feeOn(totalAmount)), timestamp(time(0)) {}
+
+    Money getNetAmount() const
+    {
+        return (type == BUY) ? totalAmount + fee : totalAmount - fee;
+    }
+
+    int getTransactionId() const { return transactionId; }
+    int getOrderId() const { return orderId; }
+    int getSymbolId() const { return symbolId; }
+    OrderType getType() const { return type; }
+    bool isBuy() const { return type == BUY; }
+    int getQuantity() const { return quantity; }
+    int getPrice() const { return price; }
+    Money getTotalAmount() const { return totalAmount; }
+    Money getFee() const { return fee; }
+    time_t getTimestamp() const { return timestamp; }
+
+    // stock은 symbolId에 해당하는 종목 (없으면 nullptr)
+    void printLog(const Stock *stock) const
+    {
+        cout << "거래 #" << transactionId << " [" << (type == BUY ? "BUY" : "SELL") << "] "
+             << (stock ? stock->getName() : "?") << " " << quantity << "주 @ " << price << "원" << endl;
+    }
+};
+
+static_assert(is_trivially_copyable<Transaction>::value, "Transaction은 문자열 없이 고정 크기");
+
+// [0, count) 구간을 스레드 수만큼 나눠 fn(begin, end)를 병렬 실행
+// threads가 0이면 하드웨어 코어 수만큼 사용
+template <typename Fn>
+void parallelForRanges(size_t count, unsigned int threads, Fn fn)
+{
+    if (count == 0)
+        return;
+    if (threads == 0)
+        threads = thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    if (threads > count)
+        threads = (unsigned int)count;
+
+    size_t chunk = (count + threads - 1) / threads;
+    vector<thread> pool;
+    for (unsigned int t = 1; t < threads; ++t)
+    {
+        size_t begin = t * chunk;
+        size_t end = min(count, begin + chunk);
+        if (begin < end)
+            pool.emplace_back(fn, begin, end);
+    }
+    fn((size_t)0, min(count, chunk)); // 첫 구간은 호출 스레드가 처리
+
+    for (thread &th : pool)
+        th.join();
+}
+
+// CounterRng 구조체 (카운터 기반 난수)
+// (seed, stream, counter)에서 바로 값을 계산하므로 내부 상태가 없고,
+// 어느 스레드에서 어떤 순서로 뽑아도 결과가 같다.
+struct CounterRng
+{
+    static uint64_t mix(uint64_t x)
+    {
+        // splitmix64 finalizer
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    static uint64_t at(uint64_t seed, uint64_t stream, uint64_t counter)
+    {
+        uint64_t key = mix(seed ^ (stream * 0x9E3779B97F4A7C15ULL));
+        return mix(key + counter * 0xD1B54A32D192ED03ULL);
+    }
+};
+
+// MarketSimulator 클래스
+// 95%: -3% ~ +3%, 5%: -15% ~ -5% 급락 으로 바뀌는 등락률을 만든다.
+// 종목마다 stream(= symbolId)이 따로 있어 종목 수와 관계없이 재현된다.
+class MarketSimulator
+{
+private:
+    uint64_t seed;
+    uint64_t step; // 다음에 쓸 카운터
+
+public:
+    MarketSimulator(uint64_t s = 0) : seed(s), step(0) {}
+
+    void setSeed(uint64_t s)
+    {
+        seed = s;
+        step = 0;
+    }
+
+    // 난수 하나로 구간(하위 비트)과 크기(상위 비트)를 함께 정한다
+    static double drawRate(uint64_t bits)
+    {
+        uint32_t regime = (uint32_t)(bits % 100);
+        uint32_t magnitude = (uint32_t)(bits >> 32);
+        if (regime < 95)
+            return ((int)(magnitude % 601) - 300) / 10000.0;
+        return -((int)(magnitude % 1001) + 500) / 10000.0;
+    }
+
+    static int applyRate(int price, double rate)
+    {
+        int newPrice = (int)(price * (1 + rate));
+        return (newPrice < 1) ? 1 : newPrice;
+    }
+
+    // 종목 [firstStream, firstStream + count)의 counter 번째 등락률
+    void fillRates(uint64_t counter, size_t firstStream, size_t count, double *out) const
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = drawRate(CounterRng::at(seed, firstStream + i, counter));
+        }
+    }
+
+    // 한 종목의 경로를 out[0..steps)에 생성 (out[0]은 startPrice에서 한 번 움직인 값)
+    void generatePath(uint64_t stream, uint64_t firstCounter, int startPrice, size_t steps, int *out) const
+    {
+        int price = startPrice;
+        for (size_t i = 0; i < steps; ++i)
+        {
+            price = applyRate(price, drawRate(CounterRng::at(seed, stream, firstCounter + i)));
+            out[i] = price;
+        }
+    }
+
+    // 다음 스텝의 카운터를 하나 가져간다
+    uint64_t advance() { return step++; }
+
+    // 여러 스텝을 한 번에 예약 (generatePath용)
+    uint64_t advance(size_t steps)
+    {
+        uint64_t first = step;
+        step += steps;
+        return first;
+    }
+
+    uint64_t getSeed() const { return seed; }
+    uint64_t getStep() const { return step; }
+
+    // 카운터 기반이라 (seed, step)만 있으면 이후 난수열이 그대로 이어진다
+    void save(SnapshotWriter &w) const
+    {
+        w.pod(seed);
+        w.pod(step);
+    }
+
+    bool restore(SnapshotReader &r)
+    {
+        return r.pod(seed) && r.pod(step);
+    }
+};
+
+// Market 클래스
+class Market
+{
+private:
+    vector<Stock *> stocks;                   // 인덱스 = symbolId
+    vector<char> stockInArena;                // stocks[i]가 stockArena에 있는지
+    unordered_map<string, int> symbolIndex;   // 종목 코드 -> symbolId
+    Arena stockArena;
+    MarketSimulator simulator;
+    vector<double> rateBuffer;
+    vector<vector<PriceListener *>> priceListeners; // symbolId별 시세 구독자
+    vector<PriceStepListener *> stepListeners;      // 변경 묶음 단위 구독자
+    vector<int> allSymbolIds;                       // 0..n-1 (전 종목 변경 알림용)
+
+    void registerStock(Stock *stock, bool inArena)
+    {
+        int id = (int)stocks.size();
+        stock->setSymbolId(id);
+        stocks.push_back(stock);
+        stockInArena.push_back(inArena ? 1 : 0);
+        symbolIndex.emplace(stock->getCode(), id);
+        priceListeners.emplace_back();
+        allSymbolIds.push_back(id);
+    }
+
+    void notifyStep(const int *symbolIds, size_t count)
+    {
+        for (PriceStepListener *listener : stepListeners)
+            listener->onPriceStep(*this, symbolIds, count);
+    }
+
+    void notifyPrice(size_t symbolId, int price)
+    {
+        for (PriceListener *listener : priceListeners[symbolId])
+            listener->onPriceUpdate((int)symbolId, price);
+    }
+
+public:
+    Market() {}
+    ~Market()
+    {
+        // 아직 구독 중인 계좌가 이 Market을 가리키지 않도록 알린다
+        for (const vector<PriceListener *> &list : priceListeners)
+        {
+            for (PriceListener *listener : list)
+                listener->onMarketClosed(*this);
+        }
+
+        for (size_t i = 0; i < stocks.size(); ++i)
+        {
+            if (stockInArena[i])
+                stocks[i]->~Stock(); // 메모리는 stockArena가 한 번에 해제
+            else
+                delete stocks[i];
+        }
+    }
+
+    Market(const Market &) = delete;
+    Market &operator=(const Market &) = delete;
+
+    // new로 만든 종목을 넘기면 Market이 delete한다
+    // 같은 코드가 이미 있으면 먼저 등록된 종목이 조회된다
+    void addStock(Stock *stock)
+    {
+        registerStock(stock, false);
+    }
+
+    // 종목 객체를 Market 내부 arena에 연속으로 생성
+    Stock *emplaceStock(const string &code, const string &name, int price)
+    {
+        Stock *stock = stockArena.create<Stock>(code, name, price);
+        registerStock(stock, true);
+        return stock;
+    }
+
+    Stock *getStock(const string &code) const
+    {
+        auto it = symbolIndex.find(code);
+        if (it == symbolIndex.end())
+            return nullptr;
+        return stocks[it->second];
+    }
+
+    // 없는 코드면 -1
+    int getSymbolId(const string &code) const
+    {
+        auto it = symbolIndex.find(code);
+        return (it == symbolIndex.end()) ? -1 : it->second;
+    }
+
+    Stock *getStockById(int id) const
+    {
+        if (id < 0 || id >= (int)stocks.size())
+            return nullptr;
+        return stocks[id];
+    }
+
+    size_t getStockCount() const { return stocks.size(); }
+    const vector<Stock *> &getStocks() const { return stocks; }
+
+    void setSeed(uint64_t seed) { simulator.setSeed(seed); }
+    const MarketSimulator &getSimulator() const { return simulator; }
+
+    // 해당 종목 시세가 Market을 통해 바뀔 때마다 listener에 알린다
+    bool subscribePrice(int symbolId, PriceListener *listener)
+    {
+        if (symbolId < 0 || symbolId >= (int)stocks.size())
+            return false;
+        priceListeners[symbolId].push_back(listener);
+        return true;
+    }
+
+    bool unsubscribePrice(int symbolId, PriceListener *listener)
+    {
+        if (symbolId < 0 || symbolId >= (int)stocks.size())
+            return false;
+        vector<PriceListener *> &list = priceListeners[symbolId];
+        auto it = find(list.begin(), list.end(), listener);
+        if (it == list.end())
+            return false;
+        *it = list.back();
+        list.pop_back();
+        return true;
+    }
+
+    // 시세 변경이 한 번 끝날 때마다 (simulatePriceChange 1회, setPrice 1회) 알린다
+    void addPriceStepListener(PriceStepListener *listener)
+    {
+        stepListeners.push_back(listener);
+    }
+
+    bool removePriceStepListener(PriceStepListener *listener)
+    {
+        auto it = find(stepListeners.begin(), stepListeners.end(), listener);
+        if (it == stepListeners.end())
+            return false;
+        stepListeners.erase(it);
+        return true;
+    }
+
+    // 구독자에게 알리면서 시세 변경
+    bool setPrice(int symbolId, int newPrice)
+    {
+        Stock *stock = getStockById(symbolId);
+        if (!stock)
+            return false;
+        stock->updatePrice(newPrice);
+        notifyPrice(symbolId, newPrice);
+        notifyStep(&allSymbolIds[symbolId], 1);
+        return true;
+    }
+
+    void simulatePriceChange()
+    {
+        uint64_t counter = simulator.advance();
+        rateBuffer.resize(stocks.size());
+        simulator.fillRates(counter, 0, stocks.size(), rateBuffer.data());
+
+        for (size_t i = 0; i < stocks.size(); ++i)
+        {
+            Stock *stock = stocks[i];
+            stock->updatePrice(MarketSimulator::applyRate(stock->getCurrentPrice(), rateBuffer[i]));
+            if (!priceListeners[i].empty())
+                notifyPrice(i, stock->getCurrentPrice());
+        }
+        if (!stepListeners.empty())
+            notifyStep(allSymbolIds.data(), allSymbolIds.size());
+    }
+
+    // 난수 상태와 종목별 현재가/직전가 (가격 이력은 데이터라 담지 않는다)
+    void saveState(SnapshotWriter &w) const
+    {
+        w.header(SNAPSHOT_MARKET);
+        simulator.save(w);
+        w.pod((uint64_t)stocks.size());
+        for (const Stock *stock : stocks)
+        {
+            w.text(stock->getCode());
+            w.pod(stock->getPreviousPrice());
+            w.pod(stock->getCurrentPrice());
+        }
+    }
+
+    // 같은 종목(코드와 순서)이 등록된 Market에만 복원된다 (뒤에 계좌 스냅샷이 이어져도 된다)
+    // 구독자에게는 시세 변경으로 알린다 (계좌는 Market 다음에 복원)
+    bool restoreState(SnapshotReader &r)
+    {
+        MarketSimulator restored;
+        uint64_t count = 0;
+        if (!r.header(SNAPSHOT_MARKET) || !restored.restore(r) || !r.pod(count) || count != stocks.size())
+            return false;
+
+        vector<pair<int, int>> prices(stocks.size());
+        string code;
+        for (size_t i = 0; i < stocks.size(); ++i)
+        {
+            if (!r.text(code) || code != stocks[i]->getCode() ||
+                !r.pod(prices[i].first) || !r.pod(prices[i].second))
+                return false;
+        }
+
+        simulator = restored;
+        for (size_t i = 0; i < stocks.size(); ++i)
+        {
+            stocks[i]->updatePrice(prices[i].first);
+            stocks[i]->updatePrice(prices[i].second); // 직전가, 현재가 순으로 맞춘다
+            if (!priceListeners[i].empty())
+                notifyPrice(i, prices[i].second);
+        }
+        if (!stepListeners.empty())
+            notifyStep(allSymbolIds.data(), allSymbolIds.size());
+        return true;
+    }
+
+    // 모든 종목에 대해 현재가에서 시작하는 steps개짜리 가격 이력을 생성
+    // 종목 구간별로 병렬 생성하며, 결과는 스레드 수와 관계없이 같다
+    // 끝나면 현재가/직전가와 알림이 simulatePriceChange를 steps번 부른 것과 같다
+    void generateHistories(size_t steps, unsigned int threads = 0)
+    {
+        uint64_t firstCounter = simulator.advance(steps);
+        const MarketSimulator &sim = simulator;
+
+        bool replay = !stepListeners.empty();
+        for (size_t i = 0; i < stocks.size() && !replay; ++i)
+            replay = !priceListeners[i].empty();
+
+        parallelForRanges(stocks.size(), threads, [&](size_t begin, size_t end)
+                          {
+            for (size_t i = begin; i < end; ++i)
+            {
+                vector<int> path(steps);
+                sim.generatePath(i, firstCounter, stocks[i]->getCurrentPrice(), steps, path.data());
+                if (!replay && steps > 0)
+                {
+                    if (steps > 1)
+                        stocks[i]->updatePrice(path[steps - 2]);
+                    stocks[i]->updatePrice(path[steps - 1]);
+                }
+                stocks[i]->setPriceHistory(move(path));
+            } });
+
+        if (!replay)
+            return;
+
+        // 구독자가 있으면 스텝 순서대로 시세를 옮기며 알린다 (한 스레드에서)
+        for (size_t t = 0; t < steps; ++t)
+        {
+            for (size_t i = 0; i < stocks.size(); ++i)
+            {
+                int price = stocks[i]->getHistoryData()[t];
+                stocks[i]->updatePrice(price);
+                if (!priceListeners[i].empty())
+                    notifyPrice(i, price);
+            }
+            if (!stepListeners.empty())
+                notifyStep(allSymbolIds.data(), allSymbolIds.size());
+        }
+    }
+};
+
+// LimitOrderBook 클래스 (한 종목의 지정가 대기 주문을 가격대별로 관리)
+// 주문마다 가격대 목록 안의 위치를 기억해 두어 취소/체결 시 가격대를 훑지 않고 O(1)에 뺀다.
+class LimitOrderBook
+{
+private:
+    typedef map<int, list<int>> Side; // 지정가 -> 주문 번호 (접수 순)
+
+    // 주문이 들어 있는 가격대와 그 안의 위치 (map/list 반복자는 다른 원소를 넣고 빼도 유지된다)
+    struct Entry
+    {
+        Side::iterator level;
+        list<int>::iterator pos;
+    };
+
+    Side bids;
+    Side asks;
+    unordered_map<int, Entry> entries; // 주문 번호 -> 위치
+
+    void insert(Side &side, int price, int orderId)
+    {
+        auto level = side.emplace(price, list<int>()).first;
+        level->second.push_back(orderId);
+        entries[orderId] = {level, prev(level->second.end())};
+    }
+
+    static void saveSide(SnapshotWriter &w, const Side &side)
+    {
+        w.pod((uint64_t)side.size());
+        for (const auto &level : side)
+        {
+            w.pod(level.first);
+            w.pod((uint64_t)level.second.size());
+            for (int id : level.second)
+                w.pod(id);
+        }
+    }
+
+    // 같은 주문 번호가 두 번 나오면 false
+    bool restoreSide(SnapshotReader &r, Side &side)
+    {
+        uint64_t levels = 0;
+        if (!r.pod(levels))
+            return false;
+        for (uint64_t i = 0; i < levels && r.ok(); ++i)
+        {
+            int price = 0;
+            uint64_t n = 0;
+            r.pod(price);
+            r.pod(n);
+            for (uint64_t k = 0; k < n; ++k)
+            {
+                int id = 0;
+                if (!r.pod(id) || entries.count(id))
+                    return false;
+                insert(side, price, id);
+            }
+        }
+        return r.ok();
+    }
+
+public:
+    LimitOrderBook() {}
+
+    // entries가 자기 컨테이너의 반복자를 들고 있으므로 복사 금지
+    LimitOrderBook(const LimitOrderBook &) = delete;
+    LimitOrderBook &operator=(const LimitOrderBook &) = delete;
+
+    void add(const Order &order)
+    {
+        insert((order.getOrderType() == BUY) ? bids : asks, order.getRequestedPrice(), order.getOrderId());
+    }
+
+    bool remove(const Order &order)
+    {
+        auto it = entries.find(order.getOrderId());
+        if (it == entries.end())
+            return false;
+
+        Side &side = (order.getOrderType() == BUY) ? bids : asks;
+        Side::iterator level = it->second.level;
+        level->second.erase(it->second.pos);
+        if (level->second.empty())
+            side.erase(level);
+        entries.erase(it);
+        return true;
+    }
+
+    // 현재가에서 체결 가능한 주문 번호를 가격-시간 우선순위로 out에 추가
+    // 체결 가능한 가격대만 방문한다
+    void collectMarketable(int currentPrice, vector<int> &out) const
+    {
+        for (auto it = bids.rbegin(); it != bids.rend() && it->first >= currentPrice; ++it)
+            out.insert(out.end(), it->second.begin(), it->second.end());
+        for (auto it = asks.begin(); it != asks.end() && it->first <= currentPrice; ++it)
+            out.insert(out.end(), it->second.begin(), it->second.end());
+    }
+
+    bool empty() const { return bids.empty() && asks.empty(); }
+
+    // 가격대와 접수 순서를 그대로 저장 (대기 주문 목록에서 다시 만들면 시간 우선순위가 바뀐다)
+    void save(SnapshotWriter &w) const
+    {
+        saveSide(w, bids);
+        saveSide(w, asks);
+    }
+
+    bool restore(SnapshotReader &r)
+    {
+        bids.clear();
+        asks.clear();
+        entries.clear();
+        return restoreSide(r, bids) && restoreSide(r, asks);
+    }
+};
+
+// TransactionSink 클래스 (체결 기록을 받아 가는 인터페이스, 예: 거래 저널)
+class TransactionSink
+{
+public:
+    virtual ~TransactionSink() {}
+    // stock은 체결된 종목 (코드가 필요한 sink용)
+    virtual void onTransaction(const Transaction &tx, const Stock &stock) = 0;
+};
+
+// Account 클래스
+class Account
+{
+private:
+    string accountNumber;
+    Money balance;
+    FeeSchedule feeSchedule;
+    Portfolio portfolio; // 처음 체결한 Market에 묶인다 (symbolId는 Market마다 따로라 한 Market에서만 거래)
+    bool subscribePrices; // false면 Market에 구독하지 않는다 (평가는 외부에서 갱신)
+
+    // executeOrders에서 쓰는 체결 후보 (버퍼는 재사용)
+    typedef unordered_map<int, size_t> PendingIndex;
+    struct BatchTicket
+    {
+        Stock *stock;                 // 첫 단계에서 찾은 종목
+        PendingIndex::iterator entry; // 체결 후 다시 해시하지 않고 지운다 (중복 입력은 slot으로 먼저 거른다)
+        size_t slot;                  // pendingOrders 위치 (묶음이 끝날 때까지 그대로)
+        int symbolId;
+        int orderId;
+        int quantity;
+        OrderType type;
+    };
+    vector<BatchTicket> batchTickets; // 입력 순
+    vector<BatchTicket> batchGrouped; // 매도 종목들 다음 매수 종목들, 각각 symbolId 순 (같은 종목 안에서는 입력 순)
+    vector<size_t> batchBucketStarts;
+    vector<size_t> batchFilledSlots;
+    vector<Order> pendingOrders;                  // 대기 주문
+    PendingIndex pendingIndex;                    // 주문 번호 -> pendingOrders 위치
+    vector<Order> orderArchive;                   // 체결/취소된 주문 (추가만 함)
+    unordered_map<int, LimitOrderBook> limitBooks;    // 종목 번호별 지정가 호가
+    vector<Transaction> transactions;
+    TransactionSink *transactionSink; // 없으면 nullptr
+
+    void recordTransaction(const Transaction &tx, const Stock *stock)
+    {
+        transactions.push_back(tx);
+        if (transactionSink)
+            transactionSink->onTransaction(tx, *stock);
+    }
+
+    // 지정가 호가에서 빼고 보관함에 추가 (번호 색인과 pendingOrders 자리는 호출한 쪽이 정리)
+    void retireOrder(const Order &order)
+    {
+        if (order.getPriceType() == LIMIT)
+        {
+            auto book = limitBooks.find(order.getSymbolId());
+            if (book != limitBooks.end())
+            {
+                book->second.remove(order);
+                if (book->second.empty())
+                    limitBooks.erase(book);
+            }
+        }
+
+        orderArchive.push_back(order);
+    }
+
+    // 대기 목록에서 빼서 보관함으로 이동 (마지막 원소와 자리 교환)
+    void archiveOrder(size_t slot)
+    {
+        retireOrder(pendingOrders[slot]);
+        pendingIndex.erase(pendingOrders[slot].getOrderId());
+
+        size_t last = pendingOrders.size() - 1;
+        if (slot != last)
+        {
+            pendingOrders[slot] = pendingOrders[last];
+            pendingIndex[pendingOrders[slot].getOrderId()] = slot;
+        }
+        pendingOrders.pop_back();
+    }
+
+    // 주문의 종목 번호로 바로 접근 (없는 종목이거나 다른 Market이면 nullptr)
+    // 처음 찾은 Market에 계좌를 묶는다
+    Stock *resolveStock(const Order &order, Market &m)
+    {
+        Market *source = portfolio.getPriceSource();
+        if (source && source != &m)
+            return nullptr;
+        Stock *stock = m.getStockById(order.getSymbolId());
+        if (stock && !source)
+            portfolio.setPriceSource(&m);
+        return stock;
+    }
+
+    // 체결된 묶음 주문 하나를 기록하고 보관함으로 옮긴다
+    // pendingOrders 자리는 묶음이 끝난 뒤 removeFilledSlots가 한 번에 메운다
+    void finishBatchOrder(const BatchTicket &ticket, int price)
+    {
+        Order &order = pendingOrders[ticket.slot];
+        order.execute();
+        recordTransaction(Transaction(order, ticket.stock, price, feeSchedule), ticket.stock);
+        retireOrder(order);
+        pendingIndex.erase(ticket.entry);
+        batchFilledSlots.push_back(ticket.slot);
+    }
+
+    // 체결된 자리를 뒤쪽 [newSize, size)에 남은 대기 주문으로 메운다 (정렬 없이 O(체결 수))
+    // 체결된 주문은 상태가 COMPLETED라 대기 주문과 구분된다
+    void removeFilledSlots()
+    {
+        size_t newSize = pendingOrders.size() - batchFilledSlots.size();
+        size_t tail = newSize;
+        for (size_t slot : batchFilledSlots)
+        {
+            if (slot >= newSize)
+                continue;
+            while (!pendingOrders[tail].isPending())
+                tail++;
+            pendingOrders[slot] = pendingOrders[tail++];
+            pendingIndex[pendingOrders[slot].getOrderId()] = slot;
+        }
+        pendingOrders.erase(pendingOrders.begin() + newSize, pendingOrders.end());
+    }
+
+    // 같은 종목 매도 묶음 group[0, n) - 보유 수량 안에서 앞 주문부터 체결
+    int fillSellGroup(const BatchTicket *group, size_t n, Market &m)
+    {
+        Stock *stock = group[0].stock;
+        int symbolId = stock->getSymbolId();
+        int price = stock->getCurrentPrice();
+        Position *pos = portfolio.getPosition(symbolId);
+        int available = pos ? pos->getQuantity() : 0;
+
+        int soldQty = 0;
+        int filled = 0;
+        Money net;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const BatchTicket &ticket = group[i];
+            // 같은 주문 번호가 여러 번 들어오면 처음 것만 체결된다
+            if (!pendingOrders[ticket.slot].isPending() || available - soldQty < ticket.quantity)
+                continue;
+            Money amount = Money::of(price, ticket.quantity);
+            net += amount - feeSchedule.feeOn(amount);
+            soldQty += ticket.quantity;
+            finishBatchOrder(ticket, price);
+            filled++;
+        }
+
+        if (soldQty > 0)
+        {
+            portfolio.reducePosition(symbolId, soldQty);
+            if (subscribePrices && !portfolio.hasPosition(symbolId))
+                m.unsubscribePrice(symbolId, &portfolio);
+            balance += net;
+        }
+        return filled;
+    }
+
+    // 같은 종목 매수 묶음 group[0, n) - 잔고 안에서 앞 주문부터 체결
+    int fillBuyGroup(const BatchTicket *group, size_t n, Market &m)
+    {
+        Stock *stock = group[0].stock;
+        int symbolId = stock->getSymbolId();
+        int price = stock->getCurrentPrice();
+
+        int boughtQty = 0;
+        int filled = 0;
+        Money spent;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const BatchTicket &ticket = group[i];
+            if (!pendingOrders[ticket.slot].isPending())
+                continue;
+            Money amount = Money::of(price, ticket.quantity);
+            Money cost = amount + feeSchedule.feeOn(amount);
+            if (balance - spent < cost)
+                continue;
+            spent += cost;
+            boughtQty += ticket.quantity;
+            finishBatchOrder(ticket, price);
+            filled++;
+        }
+
+        if (boughtQty > 0)
+        {
+            bool opened = !portfolio.hasPosition(symbolId);
+            portfolio.addPosition(stock, boughtQty, price);
+            if (opened && subscribePrices)
+                m.subscribePrice(symbolId, &portfolio);
+            balance -= spent;
+        }
+        return filled;
+    }
+
+    // 현재가로 체결 (잔고/보유 수량 부족 시 false)
+    // 새로 보유하게 된 종목은 시세를 구독하고, 전량 매도하면 구독을 해지한다
+    bool fillOrder(Order &order, Stock *stock, Market &m)
+    {
+        int symbolId = stock->getSymbolId();
+        int currentPrice = stock->getCurrentPrice();
+        Money totalCost = Money::of(currentPrice, order.getQuantity());
+        Money fee = feeSchedule.feeOn(totalCost);
+
+        if (order.getOrderType() == BUY)
+        {
+            if (balance >= totalCost + fee)
+            {
+                bool opened = !portfolio.hasPosition(symbolId);
+                if (!portfolio.addPosition(stock, order.getQuantity(), currentPrice))
+                    return false;
+                if (opened && subscribePrices)
+                    m.subscribePrice(symbolId, &portfolio);
+                balance -= (totalCost + fee);
+                order.execute();
+                recordTransaction(Transaction(order, stock, currentPrice, feeSchedule), stock);
+                return true;
+            }
+        }
+        else if (order.getOrderType() == SELL)
+        {
+            Position *pos = portfolio.getPosition(symbolId);
+            if (pos && pos->getQuantity() >= order.getQuantity())
+            {
+                portfolio.reducePosition(symbolId, order.getQuantity());
+                if (subscribePrices && !portfolio.hasPosition(symbolId))
+                    m.unsubscribePrice(symbolId, &portfolio);
+                balance += (totalCost - fee);
+                order.execute();
+                recordTransaction(Transaction(order, stock, currentPrice, feeSchedule), stock);
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    Account(string accNum, long initBal, const FeeSchedule &fee = DEFAULT_FEE_SCHEDULE)
+        : accountNumber(accNum), balance(initBal), feeSchedule(fee),
+          subscribePrices(true), transactionSink(nullptr) {}
+
+    // 구독을 해지한다 (Market이 먼저 소멸했으면 이미 알림을 받아 건너뛴다)
+    ~Account()
+    {
+        Market *source = portfolio.getPriceSource();
+        if (!source || !subscribePrices)
+            return;
+        for (const Position &pos : portfolio.getPositions())
+            source->unsubscribePrice(pos.getStock()->getSymbolId(), &portfolio);
+    }
+
+    Account(const Account &) = delete;
+    Account &operator=(const Account &) = delete;
+
+    void deposit(Money amount)
+    {
+        if (amount > Money())
+            balance += amount;
+    }
+
+    bool withdraw(Money amount)
     {
         if (balance >= amount)
         {
-            balance -= amount;
-            return true;
+            balance -= amount;
+            return true;
+        }
+        return false;
+    }
+
+    bool placeOrder(Order order)
+    {
+        OOP_PROFILE_LATENCY(ZONE_PLACE_ORDER);
+        // 간단한 유효성 검사
+        if (!order.isPending() || pendingIndex.count(order.getOrderId()))
+            return false;
+
+        pendingIndex[order.getOrderId()] = pendingOrders.size();
+        pendingOrders.push_back(order);
+        if (order.getPriceType() == LIMIT)
+            limitBooks[order.getSymbolId()].add(order);
+        return true;
+    }
+
+    bool cancelOrder(int orderId)
+    {
+        auto it = pendingIndex.find(orderId);
+        if (it == pendingIndex.end())
+            return false;
+        pendingOrders[it->second].cancel();
+        archiveOrder(it->second);
+        return true;
+    }
+
+    // 지정가 주문은 현재가가 지정가에 도달했을 때만 체결된다
+    bool executeOrder(int orderId, Market &m)
+    {
+        OOP_PROFILE_LATENCY(ZONE_EXECUTE_ORDER);
+        auto it = pendingIndex.find(orderId);
+        if (it == pendingIndex.end())
+            return false;
+
+        size_t slot = it->second;
+        Order &order = pendingOrders[slot];
+
+        Stock *stock = resolveStock(order, m);
+        if (!stock)
+            return false;
+
+        if (!order.isMarketable(stock->getCurrentPrice()))
+            return false;
+        if (!fillOrder(order, stock, m))
+            return false;
+
+        archiveOrder(slot);
+        return true;
+    }
+
+    // 대기 목록을 거치지 않고 현재가로 바로 체결 (SimulationKernel처럼 주문을 바로 처리하는 쪽용)
+    // 체결되면 보관함에 남기고 true, 지정가 미도달/잔고 부족이면 false
+    bool executeImmediately(Order &order, Market &m)
+    {
+        OOP_PROFILE_LATENCY(ZONE_EXECUTE_ORDER);
+        if (!order.isPending())
+            return false;
+        Stock *stock = resolveStock(order, m);
+        if (!stock || !order.isMarketable(stock->getCurrentPrice()))
+            return false;
+        if (!fillOrder(order, stock, m))
+            return false;
+        orderArchive.push_back(order);
+        return true;
+    }
+
+    // 여러 주문을 한 번에 체결, 체결 건수 반환
+    // (체결 중에는 TransactionSink가 이 계좌에 주문을 넣거나 빼지 않아야 한다)
+    // 종목별로 묶어 종목 조회/보유 수량/잔고 확인을 묶음 단위로 처리한다.
+    // 매도를 먼저 체결해 확보한 현금으로 매수하며, 같은 종목 안에서는 주문 번호(접수) 순.
+    // 체결되지 않은 주문은 대기 상태로 남는다.
+    int executeOrders(const int *orderIds, size_t count, Market &m)
+    {
+        OOP_PROFILE_SCOPE(ZONE_EXECUTE_ORDERS);
+        batchTickets.clear();
+        batchTickets.reserve(count);
+        int minSymbol = 0, maxSymbol = -1;
+        bool grouped = true; // 입력이 이미 (매도 먼저, symbolId) 순인지
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto it = pendingIndex.find(orderIds[i]);
+            if (it == pendingIndex.end())
+                continue;
+            Order &order = pendingOrders[it->second];
+            Stock *stock = resolveStock(order, m);
+            if (!stock || !order.isMarketable(stock->getCurrentPrice()))
+                continue;
+            int symbolId = stock->getSymbolId();
+            if (batchTickets.empty())
+            {
+                minSymbol = maxSymbol = symbolId;
+            }
+            else
+            {
+                const BatchTicket &prev = batchTickets.back();
+                if (prev.type != order.getOrderType() ? prev.type == BUY : prev.symbolId > symbolId)
+                    grouped = false;
+                minSymbol = min(minSymbol, symbolId);
+                maxSymbol = max(maxSymbol, symbolId);
+            }
+            batchTickets.push_back({stock, it, it->second, symbolId, order.getOrderId(),
+                                    order.getQuantity(), order.getOrderType()});
+        }
+
+        // symbolId는 Market에서 빈틈없이 매기므로 [minSymbol, maxSymbol] 칸에 세어 나눈다 (비교 정렬 없음)
+        vector<BatchTicket> *tickets = &batchTickets;
+        if (!grouped)
+        {
+            size_t span = (size_t)(maxSymbol - minSymbol) + 1;
+            auto bucketOf = [&](const BatchTicket &t)
+            { return (t.type == SELL ? 0 : span) + (size_t)(t.symbolId - minSymbol); };
+            batchBucketStarts.assign(2 * span + 1, 0);
+            for (const BatchTicket &ticket : batchTickets)
+                batchBucketStarts[bucketOf(ticket) + 1]++;
+            for (size_t b = 1; b < batchBucketStarts.size(); ++b)
+                batchBucketStarts[b] += batchBucketStarts[b - 1];
+            batchGrouped.resize(batchTickets.size());
+            for (const BatchTicket &ticket : batchTickets)
+                batchGrouped[batchBucketStarts[bucketOf(ticket)]++] = ticket;
+            tickets = &batchGrouped;
+        }
+
+        // 정확한 크기로 reserve하면 매 호출마다 재할당되므로 두 배씩 늘린다
+        size_t needed = transactions.size() + tickets->size();
+        if (needed > transactions.capacity())
+            transactions.reserve(max(needed, transactions.capacity() * 2));
+
+        batchFilledSlots.clear();
+        int filled = 0;
+        auto byOrderId = [](const BatchTicket &a, const BatchTicket &b)
+        { return a.orderId < b.orderId; };
+        for (auto begin = tickets->begin(); begin != tickets->end();)
+        {
+            auto end = begin + 1;
+            while (end != tickets->end() && end->stock == begin->stock && end->type == begin->type)
+                ++end;
+
+            // 입력이 접수 순이면 그대로 쓰고, 아니면 이 묶음만 주문 번호 순으로 맞춘다
+            if (!is_sorted(begin, end, byOrderId))
+                sort(begin, end, byOrderId);
+
+            filled += (begin->type == SELL) ? fillSellGroup(&*begin, end - begin, m)
+                                            : fillBuyGroup(&*begin, end - begin, m);
+            begin = end;
+        }
+
+        removeFilledSlots();
+        return filled;
+    }
+
+    int executeOrders(const vector<int> &orderIds, Market &m)
+    {
+        return executeOrders(orderIds.data(), orderIds.size(), m);
+    }
+
+    // 현재가 기준으로 체결 가능한 지정가 주문을 모두 체결, 체결 건수 반환
+    // 종목은 symbolId 순으로 방문한다 (해시 순서에 따라 체결 순서가 바뀌지 않도록)
+    int matchLimitOrders(Market &m)
+    {
+        vector<int> symbols;
+        symbols.reserve(limitBooks.size());
+        for (const auto &entry : limitBooks)
+            symbols.push_back(entry.first);
+        sort(symbols.begin(), symbols.end());
+
+        vector<int> ready;
+        for (int symbolId : symbols)
+        {
+            Stock *stock = m.getStockById(symbolId);
+            if (stock)
+                limitBooks.find(symbolId)->second.collectMarketable(stock->getCurrentPrice(), ready);
+        }
+
+        int filled = 0;
+        for (int orderId : ready)
+        {
+            if (executeOrder(orderId, m))
+                filled++;
+        }
+        return filled;
+    }
+
+    // 잔고, 보유 종목, 대기/보관 주문, 지정가 호가, 체결 기록 (Order/Transaction은 POD라 그대로 복사)
+    void saveState(SnapshotWriter &w) const
+    {
+        w.header(SNAPSHOT_ACCOUNT);
+        w.text(accountNumber);
+        w.pod(balance);
+        w.pod(feeSchedule);
+        w.pod(subscribePrices);
+        w.podVector(pendingOrders);
+        w.podVector(orderArchive);
+        w.podVector(transactions);
+        w.pod((uint64_t)limitBooks.size());
+        for (const auto &entry : limitBooks)
+        {
+            w.pod(entry.first);
+            entry.second.save(w);
+        }
+        portfolio.save(w);
+    }
+
+    // 같은 계좌번호의 새 계좌(보유 종목/대기 주문 없음)에만 복원된다
+    // m의 시세는 먼저 복원해 두어야 하며, 보유 종목은 다시 구독한다
+    // r은 이 계좌 스냅샷 끝에서 멈추므로 Market/여러 계좌 스냅샷을 이어 붙여 한 파일에 둘 수 있다
+    bool restoreState(SnapshotReader &r, Market &m)
+    {
+        if (portfolio.getPositionCount() > 0 || !pendingOrders.empty())
+            return false;
+        if (portfolio.getPriceSource() && portfolio.getPriceSource() != &m)
+            return false;
+
+        string number;
+        Money savedBalance;
+        FeeSchedule savedFee;
+        bool savedSubscribe = true;
+        vector<Order> savedPending, savedArchive;
+        vector<Transaction> savedTransactions;
+        uint64_t bookCount = 0;
+        if (!r.header(SNAPSHOT_ACCOUNT) || !r.text(number) || number != accountNumber ||
+            !r.pod(savedBalance) || !r.pod(savedFee) || !r.pod(savedSubscribe) ||
+            !r.podVector(savedPending) || !r.podVector(savedArchive) ||
+            !r.podVector(savedTransactions) || !r.pod(bookCount))
+            return false;
+
+        unordered_map<int, LimitOrderBook> savedBooks;
+        for (uint64_t i = 0; i < bookCount; ++i)
+        {
+            int symbolId = -1;
+            if (!r.pod(symbolId) || !savedBooks[symbolId].restore(r))
+                return false;
+        }
+        if (!portfolio.restore(r, m.getStocks()))
+            return false;
+
+        balance = savedBalance;
+        feeSchedule = savedFee;
+        subscribePrices = savedSubscribe;
+        pendingOrders.swap(savedPending);
+        orderArchive.swap(savedArchive);
+        transactions.swap(savedTransactions);
+        limitBooks.swap(savedBooks);
+        pendingIndex.clear();
+        int maxOrderId = 0;
+        for (size_t i = 0; i < pendingOrders.size(); ++i)
+        {
+            pendingIndex[pendingOrders[i].getOrderId()] = i;
+            maxOrderId = max(maxOrderId, pendingOrders[i].getOrderId());
+        }
+        for (const Order &order : orderArchive)
+            maxOrderId = max(maxOrderId, order.getOrderId());
+        IdSequence<Order>::advancePast(maxOrderId);
+        int maxTransactionId = 0;
+        for (const Transaction &tx : transactions)
+            maxTransactionId = max(maxTransactionId, tx.getTransactionId());
+        IdSequence<Transaction>::advancePast(maxTransactionId);
+
+        portfolio.setPriceSource(&m);
+        if (subscribePrices)
+        {
+            for (const Position &pos : portfolio.getPositions())
+                m.subscribePrice(pos.getStock()->getSymbolId(), &portfolio);
+        }
+        return true;
+    }
+
+    size_t getPendingOrderCount() const { return pendingOrders.size(); }
+    const vector<Order> &getOrderArchive() const { return orderArchive; }
+    const vector<Transaction> &getTransactions() const { return transactions; }
+
+    // 이후 체결마다 sink에도 전달 (nullptr이면 해제)
+    void setTransactionSink(TransactionSink *sink) { transactionSink = sink; }
+
+    // 보유 종목 시세 구독 여부 (포지션이 없을 때만 바꿀 수 있다)
+    bool setPriceSubscription(bool enabled)
+    {
+        if (portfolio.getPositionCount() > 0)
+            return false;
+        subscribePrices = enabled;
+        return true;
+    }
+
+    const string &getAccountNumber() const { return accountNumber; }
+
+    Money getBalance() const { return balance; }
+    const FeeSchedule &getFeeSchedule() const { return feeSchedule; }
+
+    Money getTotalAssetValue() const
+    {
+        return balance + portfolio.getTotalValue();
+    }
+
+    Portfolio &getPortfolio() { return portfolio; }
+    const Portfolio &getPortfolio() const { return portfolio; }
+
+    void printAccountSummary() const
+    {
+        cout << "계좌번호: " << accountNumber << " | 예수금: " << balance
+             << " | 총 자산: " << getTotalAssetValue() << endl;
+    }
+};
+
+// User 클래스
+class User
+{
+private:
+    string userId;
+    string password;
+    string name;
+    Account account; // 계좌는 User와 수명이 같으므로 별도 할당 없이 보관
+
+public:
+    // 계좌 자동 생성 (임의 번호)
+    User(string id, string pw, string n) : userId(id), password(pw), name(n), account(id, 0) {}
+
+    bool login(string id, string pw) const
+    {
+        return (userId == id && password == pw);
+    }
+
+    Account *getAccount()
+    {
+        return &account;
+    }
+
+    const Account *getAccount() const { return &account; }
+    const string &getUserId() const { return userId; }
+    const string &getName() const { return name; }
+};
+
+// == 다중 사용자 계좌 레지스트리 ==
+
+// AccountSummary 구조체 (printAccountSummary와 같은 항목)
+struct AccountSummary
+{
+    string userId;
+    Money balance;
+    Money totalAsset;
+    Money profit; // 보유 종목 평가손익
+    size_t positionCount;
+};
+
+// AccountRegistry 클래스
+// 사용자를 userId 해시로 샤드에 나눠 두고, 샤드마다 전용 스레드가 자기 계좌만 처리한다.
+// Market 시세 변경은 모든 샤드로 퍼져 병렬로 평가되며, 계좌 데이터에는 락이 없다.
+// 작업은 호출 스레드가 샤드 작업이 모두 끝날 때까지 기다리는 단계 단위로 진행되므로
+// 샤드가 Market을 읽는 동안 Market이 바뀌지 않는다.
+// (addUser와 Market 조작은 한 스레드에서만 호출)
+class AccountRegistry : public PriceStepListener
+{
+private:
+    struct Shard
+    {
+        deque<User> users; // 주소가 바뀌지 않도록 deque
+        unordered_map<string, User *> index;
+        vector<AccountSummary> summaries;
+        thread worker;
+    };
+
+    Market &market;
+    vector<unique_ptr<Shard>> shards;
+
+    // 단계 분배용 (계좌 데이터가 아니라 작업 시작/완료 신호에만 쓴다)
+    mutex dispatchMutex;
+    condition_variable startCv;
+    condition_variable doneCv;
+    function<void(Shard &)> task;
+    uint64_t generation;
+    size_t remaining;
+    bool stopping;
+
+    size_t shardOf(const string &userId) const
+    {
+        return hash<string>()(userId) % shards.size();
+    }
+
+    void workerLoop(Shard *shard)
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                unique_lock<mutex> lock(dispatchMutex);
+                startCv.wait(lock, [&]
+                             { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+
+            task(*shard);
+
+            lock_guard<mutex> lock(dispatchMutex);
+            if (--remaining == 0)
+                doneCv.notify_one();
+        }
+    }
+
+    // 모든 샤드에서 fn을 병렬 실행하고 끝날 때까지 대기
+    void runOnShards(function<void(Shard &)> fn)
+    {
+        unique_lock<mutex> lock(dispatchMutex);
+        task = move(fn);
+        remaining = shards.size();
+        ++generation;
+        startCv.notify_all();
+        doneCv.wait(lock, [&]
+                    { return remaining == 0; });
+    }
+
+    // 바뀐 종목이 보유 종목보다 많으면 전체 재평가가 더 싸다
+    static void markAccount(Account &account, const Market &m, const int *symbolIds, size_t count)
+    {
+        Portfolio &portfolio = account.getPortfolio();
+        if (portfolio.getPositionCount() == 0)
+            return;
+        if (count >= portfolio.getPositionCount())
+        {
+            portfolio.revalue();
+            return;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (portfolio.hasPosition(symbolIds[i]))
+                portfolio.onPriceUpdate(symbolIds[i], m.getStockById(symbolIds[i])->getCurrentPrice());
+        }
+    }
+
+public:
+    // shardCount가 0이면 하드웨어 코어 수
+    AccountRegistry(Market &m, size_t shardCount = 0)
+        : market(m), generation(0), remaining(0), stopping(false)
+    {
+        if (shardCount == 0)
+            shardCount = max(1u, thread::hardware_concurrency());
+        for (size_t i = 0; i < shardCount; ++i)
+            shards.emplace_back(new Shard());
+        for (auto &shard : shards)
+            shard->worker = thread(&AccountRegistry::workerLoop, this, shard.get());
+        market.addPriceStepListener(this);
+    }
+
+    ~AccountRegistry()
+    {
+        market.removePriceStepListener(this);
+        {
+            lock_guard<mutex> lock(dispatchMutex);
+            stopping = true;
+        }
+        startCv.notify_all();
+        for (auto &shard : shards)
+            shard->worker.join();
+    }
+
+    AccountRegistry(const AccountRegistry &) = delete;
+    AccountRegistry &operator=(const AccountRegistry &) = delete;
+
+    // 같은 userId가 있으면 nullptr
+    User *addUser(const string &userId, const string &password, const string &name,
+                  Money initialDeposit = Money())
+    {
+        Shard &shard = *shards[shardOf(userId)];
+        if (shard.index.count(userId))
+            return nullptr;
+
+        shard.users.emplace_back(userId, password, name);
+        User *user = &shard.users.back();
+        // 시세 반영은 레지스트리가 샤드별로 하므로 Market에 직접 구독하지 않는다
+        user->getAccount()->setPriceSubscription(false);
+        user->getAccount()->deposit(initialDeposit);
+        shard.index.emplace(userId, user);
+        return user;
+    }
+
+    User *findUser(const string &userId)
+    {
+        Shard &shard = *shards[shardOf(userId)];
+        auto it = shard.index.find(userId);
+        return (it == shard.index.end()) ? nullptr : it->second;
+    }
+
+    // Market의 시세 변경 알림 - 샤드별로 보유 계좌를 병렬 재평가
+    void onPriceStep(const Market &m, const int *symbolIds, size_t count) override
+    {
+        runOnShards([&](Shard &shard)
+                    {
+            for (User &user : shard.users)
+                markAccount(*user.getAccount(), m, symbolIds, count); });
+    }
+
+    // 모든 사용자에 대해 fn(User&)을 샤드별로 병렬 실행
+    // fn은 자기 계좌만 다뤄야 하며 Market은 읽기만 해야 한다 (예: 주문 체결)
+    void forEachUser(const function<void(User &)> &fn)
+    {
+        runOnShards([&](Shard &shard)
+                    {
+            for (User &user : shard.users)
+                fn(user); });
+    }
+
+    // 계좌별 요약을 샤드에서 병렬로 계산해 모은다 (샤드 순서, 샤드 안에서는 등록 순)
+    vector<AccountSummary> collectSummaries()
+    {
+        runOnShards([](Shard &shard)
+                    {
+            shard.summaries.clear();
+            shard.summaries.reserve(shard.users.size());
+            for (const User &user : shard.users)
+            {
+                const Account *account = user.getAccount();
+                const Portfolio &portfolio = account->getPortfolio();
+                shard.summaries.push_back({user.getUserId(), account->getBalance(),
+                                           account->getTotalAssetValue(), portfolio.getTotalProfit(),
+                                           portfolio.getPositionCount()});
+            } });
+
+        vector<AccountSummary> all;
+        all.reserve(getUserCount());
+        for (const auto &shard : shards)
+            all.insert(all.end(), shard->summaries.begin(), shard->summaries.end());
+        return all;
+    }
+
+    size_t getUserCount() const
+    {
+        size_t total = 0;
+        for (const auto &shard : shards)
+            total += shard->users.size();
+        return total;
+    }
+
+    size_t getShardCount() const { return shards.size(); }
+};
+
+// == 동시 주문 매칭 엔진 ==
+
+// MpscRingQueue 클래스 (고정 크기 lock-free 큐, 생산자 여럿 / 소비자 하나)
+// 칸마다 순번(seq)을 두어 생산자끼리는 CAS 한 번으로 자리를 잡는다.
+template <typename T>
+class MpscRingQueue
+{
+private:
+    // T에 기본 생성자가 없어도 되도록 칸에는 원시 저장 공간만 둔다
+    struct Cell
+    {
+        atomic<size_t> seq;
+        typename aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T *item() { return reinterpret_cast<T *>(&storage); }
+    };
+
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    char padBefore[64];
+    atomic<size_t> tail; // 생산자들이 공유
+    char padAfter[64];   // tail과 head가 같은 캐시 라인에 있지 않도록
+    size_t head;         // 소비자 전용
+
+public:
+    // capacity는 2의 거듭제곱으로 올림
+    explicit MpscRingQueue(size_t capacity) : head(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i)
+            cells[i].seq.store(i, memory_order_relaxed);
+        tail.store(0, memory_order_relaxed);
+    }
+
+    // 꺼내지 않은 항목 정리
+    ~MpscRingQueue()
+    {
+        while (cells[head & mask].seq.load(memory_order_acquire) == head + 1)
+        {
+            cells[head & mask].item()->~T();
+            ++head;
+        }
+    }
+
+    MpscRingQueue(const MpscRingQueue &) = delete;
+    MpscRingQueue &operator=(const MpscRingQueue &) = delete;
+
+    // 가득 차 있으면 false
+    bool tryPush(const T &item)
+    {
+        size_t pos = tail.load(memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                {
+                    new (cell.item()) T(item);
+                    cell.seq.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // 비어 있으면 false (소비자 스레드에서만 호출)
+    bool tryPop(T &out)
+    {
+        Cell &cell = cells[head & mask];
+        size_t seq = cell.seq.load(memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(head + 1) < 0)
+            return false;
+
+        out = move(*cell.item());
+        cell.item()->~T();
+        cell.seq.store(head + mask + 1, memory_order_release);
+        ++head;
+        return true;
+    }
+};
+
+// SymbolOrderBook 클래스 (한 종목의 매수/매도 호가, 가격-시간 우선)
+class SymbolOrderBook
+{
+private:
+    struct RestingOrder
+    {
+        Order order;
+        int remaining;
+    };
+
+    const Stock *stock;
+    map<int, deque<RestingOrder>> bids; // 높은 가격부터 체결
+    map<int, deque<RestingOrder>> asks; // 낮은 가격부터 체결
+    int lastPrice;
+
+    // 반대편 최우선 호가와 체결 가능한지
+    static bool crosses(const Order &incoming, int levelPrice)
+    {
+        if (incoming.getPriceType() == MARKET)
+            return true;
+        return (incoming.getOrderType() == BUY) ? levelPrice <= incoming.getRequestedPrice()
+                                                : levelPrice >= incoming.getRequestedPrice();
+    }
+
+    void fill(const Order &incoming, RestingOrder &resting, int price, int qty, vector<Transaction> &fills)
+    {
+        fills.push_back(Transaction(incoming, stock, price, qty));
+        fills.push_back(Transaction(resting.order, stock, price, qty));
+        resting.remaining -= qty;
+        lastPrice = price;
+    }
+
+public:
+    SymbolOrderBook(const Stock *s = nullptr)
+        : stock(s), lastPrice(s ? s->getCurrentPrice() : 0) {}
+
+    // 체결은 항상 대기 주문의 가격으로 이뤄진다
+    // 남은 수량: 지정가는 호가에 남기고, 시장가는 취소
+    void process(const Order &incoming, vector<Transaction> &fills)
+    {
+        int remaining = incoming.getQuantity();
+
+        if (incoming.getOrderType() == BUY)
+        {
+            while (remaining > 0 && !asks.empty() && crosses(incoming, asks.begin()->first))
+            {
+                auto level = asks.begin();
+                deque<RestingOrder> &queue = level->second;
+                while (remaining > 0 && !queue.empty())
+                {
+                    int qty = min(remaining, queue.front().remaining);
+                    fill(incoming, queue.front(), level->first, qty, fills);
+                    remaining -= qty;
+                    if (queue.front().remaining == 0)
+                        queue.pop_front();
+                }
+                if (queue.empty())
+                    asks.erase(level);
+            }
+        }
+        else
+        {
+            while (remaining > 0 && !bids.empty() && crosses(incoming, bids.rbegin()->first))
+            {
+                auto level = prev(bids.end());
+                deque<RestingOrder> &queue = level->second;
+                while (remaining > 0 && !queue.empty())
+                {
+                    int qty = min(remaining, queue.front().remaining);
+                    fill(incoming, queue.front(), level->first, qty, fills);
+                    remaining -= qty;
+                    if (queue.front().remaining == 0)
+                        queue.pop_front();
+                }
+                if (queue.empty())
+                    bids.erase(level);
+            }
+        }
+
+        if (remaining > 0 && incoming.getPriceType() == LIMIT)
+        {
+            map<int, deque<RestingOrder>> &side = (incoming.getOrderType() == BUY) ? bids : asks;
+            side[incoming.getRequestedPrice()].push_back(RestingOrder{incoming, remaining});
+        }
+    }
+
+    int getLastPrice() const { return lastPrice; }
+    int getBestBid() const { return bids.empty() ? 0 : bids.rbegin()->first; }
+    int getBestAsk() const { return asks.empty() ? 0 : asks.begin()->first; }
+};
+
+// MatchingEngine 클래스
+// 종목을 symbolId 기준으로 샤드에 나누고, 샤드마다 매칭 스레드 하나가
+// 자기 큐의 주문만 처리한다. 여러 게이트웨이 스레드가 동시에 submit할 수 있다.
+class MatchingEngine
+{
+private:
+    struct Shard
+    {
+        MpscRingQueue<Order> queue;
+        unordered_map<int, SymbolOrderBook> books; // 매칭 스레드 전용
+        vector<Transaction> fills;                 // 매칭 스레드 전용
+        atomic<size_t> processed;
+        thread worker;
+
+        explicit Shard(size_t capacity) : queue(capacity), processed(0) {}
+    };
+
+    const Market &market;
+    vector<unique_ptr<Shard>> shards;
+    atomic<bool> accepting;   // submit 허용 여부
+    atomic<int> submitters;   // submit 안에서 push 중인 스레드 수
+    atomic<bool> running;     // 매칭 스레드 종료 신호 (submitters가 0이 된 뒤에 내린다)
+
+    void runShard(Shard &shard)
+    {
+        Order order(-1, BUY, MARKET, 0, 0);
+        int idle = 0;
+        while (true)
+        {
+            // 종료 신호를 먼저 읽어야 그 전에 들어온 주문을 모두 비운 뒤 끝낼 수 있다
+            bool stopRequested = !running.load(memory_order_acquire);
+
+            if (shard.queue.tryPop(order))
+            {
+                idle = 0;
+                int id = order.getSymbolId();
+                auto it = shard.books.find(id);
+                if (it == shard.books.end())
+                    it = shard.books.emplace(id, SymbolOrderBook(market.getStockById(id))).first;
+                it->second.process(order, shard.fills);
+                shard.processed.fetch_add(1, memory_order_release);
+                continue;
+            }
+
+            // 큐가 비었을 때만 종료 (남은 주문은 모두 처리)
+            if (stopRequested)
+                break;
+            if (++idle < 64)
+                this_thread::yield();
+            else
+                this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+
+public:
+    // shardCount가 0이면 하드웨어 코어 수만큼 사용
+    MatchingEngine(const Market &m, unsigned int shardCount = 0, size_t queueCapacity = 1 << 16)
+        : market(m), accepting(true), submitters(0), running(true)
+    {
+        if (shardCount == 0)
+            shardCount = thread::hardware_concurrency();
+        if (shardCount == 0)
+            shardCount = 1;
+
+        for (unsigned int i = 0; i < shardCount; ++i)
+            shards.emplace_back(new Shard(queueCapacity));
+        for (auto &shard : shards)
+            shard->worker = thread(&MatchingEngine::runShard, this, ref(*shard));
+    }
+
+    ~MatchingEngine()
+    {
+        stop();
+    }
+
+    MatchingEngine(const MatchingEngine &) = delete;
+    MatchingEngine &operator=(const MatchingEngine &) = delete;
+
+    // 여러 스레드에서 동시에 호출 가능, 없는 종목이면 false
+    // 큐가 가득 차면 빈자리가 생길 때까지 기다린다
+    // stop()과 겹치면 넣기 전에 false를 돌려주거나, 넣은 주문이 반드시 처리된다
+    bool submit(Order order)
+    {
+        int id = order.getSymbolId();
+        if (!market.getStockById(id))
+            return false;
+
+        // 먼저 등록한 뒤 accepting을 확인해야 stop()이 이 push를 기다린다
+        submitters.fetch_add(1);
+        if (!accepting.load())
+        {
+            submitters.fetch_sub(1);
+            return false;
+        }
+
+        Shard &shard = *shards[id % shards.size()];
+        while (!shard.queue.tryPush(order))
+            this_thread::yield();
+        submitters.fetch_sub(1, memory_order_release);
+        return true;
+    }
+
+    // 새 주문을 막고, 진행 중인 submit이 끝나길 기다린 뒤
+    // 큐에 남은 주문까지 모두 처리하고 매칭 스레드 종료
+    void stop()
+    {
+        accepting.store(false);
+        while (submitters.load(memory_order_acquire) != 0)
+            this_thread::yield();
+        running.store(false, memory_order_release);
+        for (auto &shard : shards)
+        {
+            if (shard->worker.joinable())
+                shard->worker.join();
+        }
+    }
+
+    size_t getProcessedCount() const
+    {
+        size_t total = 0;
+        for (const auto &shard : shards)
+            total += shard->processed.load(memory_order_acquire);
+        return total;
+    }
+
+    // stop() 이후에 호출
+    vector<Transaction> collectFills() const
+    {
+        vector<Transaction> all;
+        for (const auto &shard : shards)
+            all.insert(all.end(), shard->fills.begin(), shard->fills.end());
+        return all;
+    }
+
+    // stop() 이후에 호출, 체결이 없었으면 종목 현재가
+    int getLastPrice(int symbolId) const
+    {
+        const Shard &shard = *shards[symbolId % shards.size()];
+        auto it = shard.books.find(symbolId);
+        if (it != shard.books.end())
+            return it->second.getLastPrice();
+        const Stock *stock = market.getStockById(symbolId);
+        return stock ? stock->getCurrentPrice() : 0;
+    }
+
+    size_t getShardCount() const { return shards.size(); }
+};
+
+// == 거래 저널 ==
+
+// JournalRecord 구조체 (저널 파일의 고정 길이 64바이트 레코드)
+struct JournalRecord
+{
+    int64_t timestamp;
+    int64_t totalAmount; // 원
+    int64_t fee;         // 원
+    int32_t transactionId;
+    int32_t orderId;
+    int32_t symbolId;
+    int32_t quantity;
+    int32_t price;
+    uint8_t side; // 0: 매수, 1: 매도
+    uint8_t reserved[3];
+    char stockCode[16]; // 15자까지, 남는 칸은 0
+
+    static JournalRecord from(const Transaction &tx, const string &stockCode)
+    {
+        JournalRecord r;
+        memset(&r, 0, sizeof(r));
+        r.timestamp = (int64_t)tx.getTimestamp();
+        r.totalAmount = tx.getTotalAmount().won;
+        r.fee = tx.getFee().won;
+        r.transactionId = tx.getTransactionId();
+        r.orderId = tx.getOrderId();
+        r.symbolId = tx.getSymbolId();
+        r.quantity = tx.getQuantity();
+        r.price = tx.getPrice();
+        r.side = tx.isBuy() ? 0 : 1;
+        strncpy(r.stockCode, stockCode.c_str(), sizeof(r.stockCode) - 1);
+        return r;
+    }
+
+    bool isBuy() const { return side == 0; }
+    Money getNetAmount() const { return isBuy() ? Money(totalAmount + fee) : Money(totalAmount - fee); }
+};
+
+static_assert(sizeof(JournalRecord) == 64, "JournalRecord는 64바이트 고정 길이");
+static_assert(is_trivially_copyable<JournalRecord>::value, "JournalRecord는 그대로 파일에 쓴다");
+
+// 저널 파일 헤더 (16바이트) 뒤에 JournalRecord가 이어진다
+struct JournalHeader
+{
+    char magic[4]; // "OOPJ"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+const uint32_t JOURNAL_VERSION = 1;
+
+enum JournalFsyncPolicy
+{
+    JOURNAL_FSYNC_NONE,     // OS에 맡긴다 (close 때만 flush)
+    JOURNAL_FSYNC_BATCH,    // 묶음을 쓸 때마다 fsync
+    JOURNAL_FSYNC_INTERVAL  // 마지막 fsync 후 일정 시간이 지나면 fsync
+};
+
+// TransactionJournal 클래스 (추가 전용 바이너리 저널)
+// 체결 스레드는 레코드를 큐에 넣기만 하고, 파일 쓰기와 fsync는 전용 스레드가 묶음으로 처리한다.
+// 그래서 디스크 지연이 체결 경로를 막지 않는다 (큐가 가득 찬 경우만 잠깐 양보하며 기다림).
+class TransactionJournal : public TransactionSink
+{
+private:
+    typedef chrono::steady_clock Clock;
+
+    MpscRingQueue<JournalRecord> queue;
+    FILE *fp;
+    JournalFsyncPolicy fsyncPolicy;
+    chrono::milliseconds fsyncInterval;
+    size_t batchSize;
+    atomic<bool> stopping;
+    atomic<uint64_t> appended;
+    atomic<uint64_t> written;    // 실제로 파일에 쓴 레코드 수
+    atomic<uint64_t> fullStalls; // 큐가 가득 차 기다린 횟수
+    atomic<bool> writeFailed;    // 한 번 실패하면 이후 레코드는 버린다
+    thread writer;
+
+    // fflush나 fsync가 실패하면 false
+    bool syncFile()
+    {
+        if (fflush(fp) != 0)
+            return false;
+#ifndef _WIN32
+        if (fsync(fileno(fp)) != 0)
+            return false;
+#endif
+        return true;
+    }
+
+    void markFailed()
+    {
+        writeFailed.store(true, memory_order_release);
+    }
+
+    void writerLoop()
+    {
+        vector<JournalRecord> batch(batchSize);
+        Clock::time_point lastSync = Clock::now();
+        bool unsynced = false; // 마지막 fsync 뒤에 쓴 레코드가 있는지
+
+        while (true)
+        {
+            // stop 요청을 먼저 읽어야 그 전에 들어온 레코드를 모두 비운 뒤 끝낼 수 있다
+            bool stopRequested = stopping.load(memory_order_acquire);
+
+            size_t n = 0;
+            while (n < batch.size() && queue.tryPop(batch[n]))
+                n++;
+
+            if (n > 0)
+            {
+                // 실패한 뒤에도 큐는 계속 비워야 append가 막히지 않는다
+                if (!writeFailed.load(memory_order_relaxed))
+                {
+                    size_t done = fwrite(batch.data(), sizeof(JournalRecord), n, fp);
+                    if (done != n)
+                        markFailed();
+                    if (done > 0)
+                    {
+                        written.fetch_add(done, memory_order_release);
+                        unsynced = true;
+                    }
+                }
+            }
+
+            // 한가할 때도 간격이 지났으면 남은 레코드를 fsync한다
+            if (unsynced && !writeFailed.load(memory_order_relaxed) &&
+                (fsyncPolicy == JOURNAL_FSYNC_BATCH ||
+                 (fsyncPolicy == JOURNAL_FSYNC_INTERVAL && Clock::now() - lastSync >= fsyncInterval)))
+            {
+                if (!syncFile())
+                    markFailed();
+                unsynced = false;
+                lastSync = Clock::now();
+            }
+
+            if (n > 0)
+                continue;
+            if (stopRequested)
+                break;
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+
+        if (writeFailed.load(memory_order_relaxed))
+            return;
+        bool ok = (fsyncPolicy == JOURNAL_FSYNC_NONE) ? fflush(fp) == 0 : syncFile();
+        if (!ok)
+            markFailed();
+    }
+
+    TransactionJournal(FILE *file, JournalFsyncPolicy policy, chrono::milliseconds interval,
+                       size_t capacity, size_t batch)
+        : queue(capacity), fp(file), fsyncPolicy(policy), fsyncInterval(interval),
+          batchSize(max<size_t>(1, batch)), stopping(false), appended(0), written(0),
+          fullStalls(0), writeFailed(false)
+    {
+        writer = thread(&TransactionJournal::writerLoop, this);
+    }
+
+public:
+    // 파일이 없으면 새로 만들고, 있으면 헤더를 확인한 뒤 끝에 이어 쓴다 (실패 시 nullptr)
+    static unique_ptr<TransactionJournal> open(const string &path,
+                                               JournalFsyncPolicy policy = JOURNAL_FSYNC_BATCH,
+                                               chrono::milliseconds interval = chrono::milliseconds(100),
+                                               size_t capacity = 1 << 16, size_t batch = 1024)
+    {
+        FILE *file = fopen(path.c_str(), "ab+");
+        if (!file)
+            return nullptr;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        if (size == 0)
+        {
+            JournalHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, "OOPJ", 4);
+            header.version = JOURNAL_VERSION;
+            header.recordSize = sizeof(JournalRecord);
+            if (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0)
+            {
+                fclose(file);
+                return nullptr;
+            }
+        }
+        else
+        {
+            JournalHeader header;
+            fseek(file, 0, SEEK_SET);
+            bool ok = size >= (long)sizeof(header) && fread(&header, sizeof(header), 1, file) == 1 &&
+                      memcmp(header.magic, "OOPJ", 4) == 0 && header.version == JOURNAL_VERSION &&
+                      header.recordSize == sizeof(JournalRecord);
+
+            // 쓰다 만 마지막 레코드는 잘라낸다
+            long torn = (size - (long)sizeof(header)) % (long)sizeof(JournalRecord);
+#ifndef _WIN32
+            if (ok && torn != 0)
+                ok = ftruncate(fileno(file), size - torn) == 0;
+#else
+            ok = ok && torn == 0;
+#endif
+            if (!ok)
+            {
+                fclose(file);
+                return nullptr;
+            }
+            fseek(file, 0, SEEK_END);
+        }
+
+        return unique_ptr<TransactionJournal>(
+            new TransactionJournal(file, policy, interval, capacity, batch));
+    }
+
+    ~TransactionJournal()
+    {
+        close();
+        fclose(fp);
+    }
+
+    TransactionJournal(const TransactionJournal &) = delete;
+    TransactionJournal &operator=(const TransactionJournal &) = delete;
+
+    // 여러 스레드에서 호출 가능
+    void append(const JournalRecord &record)
+    {
+        while (!queue.tryPush(record))
+        {
+            fullStalls.fetch_add(1, memory_order_relaxed);
+            this_thread::yield();
+        }
+        appended.fetch_add(1, memory_order_relaxed);
+    }
+
+    void onTransaction(const Transaction &tx, const Stock &stock) override
+    {
+        append(JournalRecord::from(tx, stock.getCode()));
+    }
+
+    // append가 모두 끝난 뒤 호출, 남은 레코드를 쓰고 writer 스레드 종료
+    // 쓰기나 fsync가 한 번이라도 실패했으면 false
+    bool close()
+    {
+        if (writer.joinable())
+        {
+            stopping.store(true, memory_order_release);
+            writer.join();
+        }
+        return !hasWriteError();
+    }
+
+    uint64_t getAppendedCount() const { return appended.load(memory_order_relaxed); }
+    uint64_t getWrittenCount() const { return written.load(memory_order_acquire); }
+    uint64_t getFullStallCount() const { return fullStalls.load(memory_order_relaxed); }
+    bool hasWriteError() const { return writeFailed.load(memory_order_acquire); } // 실행 중에도 확인 가능
+};
+
+// JournalReader 클래스 (저널 파일을 매핑해 레코드 배열로 읽기)
+class JournalReader
+{
+private:
+    MappedFile file;
+    const JournalRecord *records;
+    size_t count;
+
+    JournalReader() : records(nullptr), count(0) {}
+
+public:
+    // 헤더가 맞지 않으면 nullptr, 마지막에 잘린 레코드가 있으면 무시한다
+    static unique_ptr<JournalReader> open(const string &path)
+    {
+        unique_ptr<JournalReader> reader(new JournalReader());
+        if (!reader->file.open(path) || reader->file.getSize() < sizeof(JournalHeader))
+            return nullptr;
+
+        JournalHeader header;
+        memcpy(&header, reader->file.data(), sizeof(header));
+        if (memcmp(header.magic, "OOPJ", 4) != 0 || header.version != JOURNAL_VERSION ||
+            header.recordSize != sizeof(JournalRecord))
+            return nullptr;
+
+        // 헤더 16바이트 뒤라 8바이트 정렬이 유지된다
+        reader->records = reinterpret_cast<const JournalRecord *>(reader->file.data() + sizeof(JournalHeader));
+        reader->count = (reader->file.getSize() - sizeof(JournalHeader)) / sizeof(JournalRecord);
+        return reader;
+    }
+
+    size_t size() const { return count; }
+    const JournalRecord &operator[](size_t i) const { return records[i]; }
+    const JournalRecord *begin() const { return records; }
+    const JournalRecord *end() const { return records + count; }
+
+    // 시각 [from, to) 구간 레코드를 순서대로 fn(record)에 전달, 전달한 개수 반환
+    template <typename Fn>
+    size_t replay(time_t from, time_t to, Fn fn) const
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (records[i].timestamp >= (int64_t)from && records[i].timestamp < (int64_t)to)
+            {
+                fn(records[i]);
+                n++;
+            }
+        }
+        return n;
+    }
+};
+
+// == 과거 시세 일괄 적재 ==
+
+// CsvLoadOptions 구조체
+struct CsvLoadOptions
+{
+    unsigned int threads; // 0이면 하드웨어 코어 수
+    size_t minChunkBytes; // 스레드 하나가 맡는 최소 크기
+    string cacheDir;      // 비어 있지 않으면 종목별 .oopc로 변환해 두고 다음 실행부터 매핑해서 쓴다
+
+    CsvLoadOptions() : threads(0), minChunkBytes(1 << 20) {}
+};
+
+// CsvLoadResult 구조체
+struct CsvLoadResult
+{
+    bool ok;
+    bool fromCache; // 파싱 없이 .oopc 캐시에서 읽었는지
+    size_t rows;
+    size_t symbols;
+    size_t badLines; // 형식이 맞지 않아 건너뛴 줄
+
+    CsvLoadResult() : ok(false), fromCache(false), rows(0), symbols(0), badLines(0) {}
+};
+
+// CsvPriceLoader 클래스 (OHLCV CSV를 Market의 종목 가격 이력으로 일괄 적재)
+// 한 줄 형식: 종목코드,시각,시가,고가,저가,종가,거래량 (첫 줄이 헤더면 건너뜀)
+// 시각은 정수 또는 YYYY-MM-DD[ HH:MM:SS] (YYYYMMDD[hhmmss] 정수로 저장), 가격은 소수점 이하 반올림.
+// 파일을 매핑한 뒤 줄 경계로 나눈 구간을 스레드마다 직접 파싱한다 (iostream 미사용).
+// 같은 종목의 줄은 파일 순서대로 이어 붙이므로, 종목 안에서는 시간순으로 정렬돼 있어야 한다.
+// 종목 코드는 캐시 파일 이름으로도 쓰므로 영문/숫자/'.'/'_'/'-'만 허용하고 '.'으로 시작할 수 없다.
+class CsvPriceLoader
+{
+private:
+    // 구간 하나에서 본 종목 하나의 데이터 (변환할 때만 봉 전체를 보관)
+    struct ChunkSymbol
+    {
+        string code;
+        vector<int> closes;
+        vector<PriceBar> bars;
+    };
+
+    struct ChunkResult
+    {
+        vector<ChunkSymbol> symbols; // 구간 안에서 처음 나온 순서
+        size_t rows;
+        size_t badLines;
+
+        ChunkResult() : rows(0), badLines(0) {}
+    };
+
+    static bool isDigit(char c) { return (unsigned)(c - '0') < 10; }
+
+    static bool isCodeChar(char c)
+    {
+        return isDigit(c) || (unsigned)((c | 0x20) - 'a') < 26 || c == '.' || c == '_' || c == '-';
+    }
+
+    // 경로 구분자나 ".."이 들어가 cacheDir 밖을 가리킬 수 없는 코드인지
+    static bool isValidCode(const char *p, const char *end)
+    {
+        if (p == end || *p == '.')
+            return false;
+        for (; p < end; ++p)
+        {
+            if (!isCodeChar(*p))
+                return false;
+        }
+        return true;
+    }
+
+    static bool parseInt(const char *&p, const char *end, int64_t &out)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+        const char *start = p;
+        int64_t value = 0;
+        while (p < end && isDigit(*p) && p - start < 18)
+        {
+            value = value * 10 + (*p - '0');
+            ++p;
+        }
+        if (p == start || (p < end && isDigit(*p)))
+            return false; // 숫자가 없거나 18자리 초과
+        out = negative ? -value : value;
+        return true;
+    }
+
+    // 소수점 이하는 첫 자리로 반올림
+    static bool parsePrice(const char *&p, const char *end, int &out)
+    {
+        int64_t value;
+        if (!parseInt(p, end, value))
+            return false;
+        if (p < end && *p == '.')
+        {
+            ++p;
+            if (p < end && isDigit(*p) && *p >= '5')
+                value += (value < 0) ? -1 : 1;
+            while (p < end && isDigit(*p))
+                ++p;
+        }
+        if (value <= 0 || value > 2147483647)
+            return false;
+        out = (int)value;
+        return true;
+    }
+
+    // 정수 또는 YYYY-MM-DD[ HH:MM:SS]
+    static bool parseTimestamp(const char *&p, const char *end, long long &out)
+    {
+        int64_t value;
+        if (!parseInt(p, end, value))
+            return false;
+        if (p < end && *p == '-')
+        {
+            int64_t month, day;
+            ++p;
+            if (!parseInt(p, end, month) || p >= end || *p != '-')
+                return false;
+            ++p;
+            if (!parseInt(p, end, day))
+                return false;
+            value = value * 10000 + month * 100 + day;
+            if (p < end && (*p == ' ' || *p == 'T'))
+            {
+                int64_t hour, minute, second = 0;
+                ++p;
+                if (!parseInt(p, end, hour) || p >= end || *p != ':')
+                    return false;
+                ++p;
+                if (!parseInt(p, end, minute))
+                    return false;
+                if (p < end && *p == ':')
+                {
+                    ++p;
+                    if (!parseInt(p, end, second))
+                        return false;
+                }
+                value = value * 1000000 + hour * 10000 + minute * 100 + second;
+            }
+        }
+        out = (long long)value;
+        return true;
+    }
+
+    static bool expectComma(const char *&p, const char *end)
+    {
+        if (p >= end || *p != ',')
+            return false;
+        ++p;
+        return true;
+    }
+
+    // 한 줄 [p, end) 파싱 (끝의 \r 허용)
+    static bool parseLine(const char *p, const char *end, const char *&codeEnd, PriceBar &bar)
+    {
+        const char *code = p;
+        while (p < end && *p != ',')
+            ++p;
+        codeEnd = p;
+        if (!isValidCode(code, codeEnd) || !expectComma(p, end))
+            return false;
+
+        int64_t volume;
+        if (!parseTimestamp(p, end, bar.timestamp) || !expectComma(p, end) ||
+            !parsePrice(p, end, bar.open) || !expectComma(p, end) ||
+            !parsePrice(p, end, bar.high) || !expectComma(p, end) ||
+            !parsePrice(p, end, bar.low) || !expectComma(p, end) ||
+            !parsePrice(p, end, bar.close) || !expectComma(p, end) ||
+            !parseInt(p, end, volume))
+            return false;
+        bar.volume = volume;
+        if (p < end && *p == '.') // 소수 거래량은 정수 부분만
+        {
+            ++p;
+            while (p < end && isDigit(*p))
+                ++p;
+        }
+        while (p < end && (*p == '\r' || *p == ' '))
+            ++p;
+        return p == end;
+    }
+
+    static void parseChunk(const char *begin, const char *end, bool keepBars, bool skipHeader, ChunkResult &out)
+    {
+        unordered_map<string, size_t> index;
+        size_t last = (size_t)-1; // 직전 줄 종목 (같은 종목이 이어지면 해시 조회 생략)
+        string key;
+        const char *p = begin;
+        bool first = true;
+
+        while (p < end)
+        {
+            const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+            if (!lineEnd)
+                lineEnd = end;
+
+            PriceBar bar;
+            const char *codeEnd;
+            bool header = first && skipHeader && !(lineEnd > p && parseLine(p, lineEnd, codeEnd, bar));
+            first = false;
+            if (header || lineEnd == p || (lineEnd == p + 1 && *p == '\r'))
+            {
+                p = lineEnd + 1;
+                continue;
+            }
+            if (!parseLine(p, lineEnd, codeEnd, bar))
+            {
+                out.badLines++;
+                p = lineEnd + 1;
+                continue;
+            }
+
+            size_t codeLen = codeEnd - p;
+            if (last == (size_t)-1 || out.symbols[last].code.size() != codeLen ||
+                memcmp(out.symbols[last].code.data(), p, codeLen) != 0)
+            {
+                key.assign(p, codeLen);
+                auto it = index.find(key);
+                if (it == index.end())
+                {
+                    it = index.emplace(key, out.symbols.size()).first;
+                    out.symbols.push_back(ChunkSymbol());
+                    out.symbols.back().code = key;
+                }
+                last = it->second;
+            }
+
+            ChunkSymbol &sym = out.symbols[last];
+            sym.closes.push_back(bar.close);
+            if (keepBars)
+                sym.bars.push_back(bar);
+            out.rows++;
+            p = lineEnd + 1;
+        }
+    }
+
+    // 캐시가 원본과 같은 파일에서 만들어졌는지 확인하는 값 (크기, 수정 시각)
+    static string fileSignature(const string &path)
+    {
+#ifndef _WIN32
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return "";
+        return to_string((long long)st.st_size) + " " + to_string((long long)st.st_mtime);
+#else
+        FILE *fp = fopen(path.c_str(), "rb");
+        if (!fp)
+            return "";
+        fseek(fp, 0, SEEK_END);
+        long len = ftell(fp);
+        fclose(fp);
+        return to_string((long long)len);
+#endif
+    }
+
+    // code는 isValidCode를 통과한 것만 (CSV 줄과 manifest 양쪽에서 확인)
+    static string cachePath(const string &dir, const string &code)
+    {
+        return dir + "/" + code + ".oopc";
+    }
+
+    static string manifestPath(const string &dir)
+    {
+        return dir + "/manifest.txt";
+    }
+
+    static Stock *findOrCreate(Market &market, const string &code, int lastPrice)
+    {
+        Stock *stock = market.getStock(code);
+        if (!stock)
+            stock = market.emplaceStock(code, code, lastPrice);
+        return stock;
+    }
+
+    // manifest: 첫 줄은 원본 서명, 다음 줄부터 종목 코드
+    static bool loadFromCache(Market &market, const string &path, const string &dir, CsvLoadResult &result)
+    {
+        FILE *fp = fopen(manifestPath(dir).c_str(), "r");
+        if (!fp)
+            return false;
+
+        char line[256];
+        vector<string> codes;
+        bool valid = fgets(line, sizeof(line), fp) != nullptr &&
+                     string(line, strcspn(line, "\r\n")) == fileSignature(path);
+        while (valid && fgets(line, sizeof(line), fp))
+        {
+            size_t len = strcspn(line, "\r\n");
+            if (len == 0)
+                continue;
+            if (!isValidCode(line, line + len))
+                valid = false; // 손으로 고친 manifest면 CSV를 다시 읽는다
+            else
+                codes.push_back(string(line, len));
+        }
+        fclose(fp);
+        if (!valid)
+            return false;
+
+        vector<shared_ptr<PriceColumnStore>> stores;
+        for (const string &code : codes)
+        {
+            shared_ptr<PriceColumnStore> store = PriceColumnStore::open(cachePath(dir, code));
+            if (!store || store->getRowCount() == 0)
+                return false; // 하나라도 깨졌으면 CSV를 다시 읽는다
+            stores.push_back(store);
+        }
+
+        for (size_t i = 0; i < codes.size(); ++i)
+        {
+            const PriceColumnStore &store = *stores[i];
+            Stock *stock = findOrCreate(market, codes[i], store.getCloses()[store.getRowCount() - 1]);
+            stock->attachHistory(stores[i]);
+            stock->updatePrice(store.getCloses()[store.getRowCount() - 1]);
+            result.rows += store.getRowCount();
+        }
+        result.symbols = codes.size();
+        result.fromCache = true;
+        result.ok = true;
+        return true;
+    }
+
+    // 종목별 .oopc와 manifest 저장 후, 방금 적재한 종목도 매핑된 파일을 쓰도록 바꾼다
+    // (실패해도 적재 결과에는 영향 없음)
+    static bool writeCache(const string &path, const string &dir, const vector<string> &codes,
+                           const vector<vector<const ChunkSymbol *>> &parts,
+                           const vector<Stock *> &targets)
+    {
+#ifndef _WIN32
+        mkdir(dir.c_str(), 0755);
+#endif
+        vector<PriceBar> bars;
+        for (size_t i = 0; i < codes.size(); ++i)
+        {
+            bars.clear();
+            for (const ChunkSymbol *sym : parts[i])
+                bars.insert(bars.end(), sym->bars.begin(), sym->bars.end());
+            if (!PriceColumnStore::write(cachePath(dir, codes[i]), bars))
+                return false;
+        }
+
+        // manifest는 마지막에 써서, 중간에 실패하면 다음 실행이 CSV를 다시 읽게 한다
+        FILE *fp = fopen(manifestPath(dir).c_str(), "w");
+        if (!fp)
+            return false;
+        bool ok = fprintf(fp, "%s\n", fileSignature(path).c_str()) > 0;
+        for (const string &code : codes)
+            ok = ok && fprintf(fp, "%s\n", code.c_str()) > 0;
+        if (fclose(fp) != 0 || !ok)
+            return false;
+
+        for (size_t i = 0; i < codes.size(); ++i)
+        {
+            shared_ptr<PriceColumnStore> store = PriceColumnStore::open(cachePath(dir, codes[i]));
+            if (store)
+                targets[i]->attachHistory(store);
+        }
+        return true;
+    }
+
+public:
+    static CsvLoadResult load(Market &market, const string &path, const CsvLoadOptions &options = CsvLoadOptions())
+    {
+        CsvLoadResult result;
+        bool convert = !options.cacheDir.empty();
+        if (convert && loadFromCache(market, path, options.cacheDir, result))
+            return result;
+
+        MappedFile file;
+        if (!file.open(path))
+            return result;
+        const char *data = file.data();
+        size_t size = file.getSize();
+
+        // 줄 경계에 맞춰 구간 나누기
+        unsigned int workers = options.threads ? options.threads : thread::hardware_concurrency();
+        if (workers == 0)
+            workers = 1;
+        size_t maxWorkers = max<size_t>(1, size / max<size_t>(1, options.minChunkBytes));
+        if (workers > maxWorkers)
+            workers = (unsigned int)maxWorkers;
+
+        vector<size_t> bounds(1, 0);
+        for (unsigned int t = 1; t < workers; ++t)
+        {
+            size_t at = max(bounds.back(), size * t / workers);
+            const char *nl = (const char *)memchr(data + at, '\n', size - at);
+            size_t next = nl ? (size_t)(nl - data) + 1 : size;
+            if (next > bounds.back() && next < size)
+                bounds.push_back(next);
+        }
+        bounds.push_back(size);
+
+        vector<ChunkResult> chunks(bounds.size() - 1);
+        vector<thread> pool;
+        for (size_t c = 1; c < chunks.size(); ++c)
+            pool.emplace_back(&CsvPriceLoader::parseChunk, data + bounds[c], data + bounds[c + 1],
+                              convert, false, ref(chunks[c]));
+        parseChunk(data + bounds[0], data + bounds[1], convert, true, chunks[0]);
+        for (thread &th : pool)
+            th.join();
+
+        // 종목별로 구간 결과를 모아 정확한 크기로 한 번에 할당
+        vector<string> codes;
+        vector<vector<const ChunkSymbol *>> parts; // codes[i]의 구간별 조각 (파일 순서)
+        unordered_map<string, size_t> codeIndex;
+        for (const ChunkResult &chunk : chunks)
+        {
+            result.rows += chunk.rows;
+            result.badLines += chunk.badLines;
+            for (const ChunkSymbol &sym : chunk.symbols)
+            {
+                auto it = codeIndex.find(sym.code);
+                if (it == codeIndex.end())
+                {
+                    it = codeIndex.emplace(sym.code, codes.size()).first;
+                    codes.push_back(sym.code);
+                    parts.push_back(vector<const ChunkSymbol *>());
+                }
+                parts[it->second].push_back(&sym);
+            }
+        }
+
+        vector<Stock *> targets(codes.size());
+        vector<int *> outputs(codes.size());
+        for (size_t i = 0; i < codes.size(); ++i)
+        {
+            const vector<const ChunkSymbol *> &list = parts[i];
+            size_t total = 0;
+            for (const ChunkSymbol *sym : list)
+                total += sym->closes.size();
+            int lastPrice = list.back()->closes.back();
+            targets[i] = findOrCreate(market, codes[i], lastPrice);
+            targets[i]->updatePrice(lastPrice);
+            outputs[i] = targets[i]->prepareHistory(total);
+        }
+
+        // 종목마다 버퍼가 따로라 복사는 병렬로 해도 된다
+        atomic<size_t> next(0);
+        auto copyWorker = [&]()
+        {
+            for (size_t i = next.fetch_add(1); i < codes.size(); i = next.fetch_add(1))
+            {
+                int *out = outputs[i];
+                for (const ChunkSymbol *sym : parts[i])
+                {
+                    memcpy(out, sym->closes.data(), sym->closes.size() * sizeof(int));
+                    out += sym->closes.size();
+                }
+            }
+        };
+        pool.clear();
+        for (size_t t = 1; t < chunks.size() && t < codes.size(); ++t)
+            pool.emplace_back(copyWorker);
+        copyWorker();
+        for (thread &th : pool)
+            th.join();
+
+        result.symbols = codes.size();
+        result.ok = true;
+        if (convert)
+            writeCache(path, options.cacheDir, codes, parts, targets);
+        return result;
+    }
+};
+
+// == 5. 습관 교정 백테스터 클래스 ==
+
+// TradingStrategy 클래스 (추상)
+class TradingStrategy
+{
+protected:
+    const char *name; // strategyKindName 또는 StrategyNameRegistry의 이름 (리포트가 전략보다 오래 남아도 유효)
+    StrategyKind kind;
+    Money cash;
+    int shares;
+    int avgPrice;
+    EquityBuffer equityHistory;
+    bool keepHistory;  // false면 자산 곡선을 저장하지 않고 MDD만 추적
+    DrawdownTracker drawdown;
+    RiskTracker risk;
+    int buyCount;
+    int sellCount;
+
+    // 자산이 기록될 때마다 MDD와 위험 지표를 같은 루프에서 갱신
+    void trackEquity(long equity)
+    {
+        drawdown.track(equity);
+        risk.track(equity);
+    }
+
+    void buy(int price, int qty, const FeeSchedule &feeSchedule)
+    {
+        Money cost = Money::of(price, qty);
+        Money fee = feeSchedule.feeOn(cost);
+
+        if (cash >= cost + fee && qty > 0)
+        {
+            Money totalCost = Money::of(avgPrice, shares) + cost;
+            shares += qty;
+            avgPrice = (shares > 0) ? (int)(totalCost.won / shares) : 0;
+            cash -= (cost + fee);
+            buyCount++;
+        }
+    }
+
+    void sellAll(int price, const FeeSchedule &feeSchedule)
+    {
+        if (shares > 0)
+        {
+            Money revenue = Money::of(price, shares);
+            Money fee = feeSchedule.feeOn(revenue);
+            cash += (revenue - fee);
+            shares = 0;
+            avgPrice = 0;
+            sellCount++;
+        }
+    }
+
+    void recordEquity(int price)
+    {
+        long equity = getTotalValue(price);
+        trackEquity(equity);
+        if (keepHistory)
+            equityHistory.push_back(equity);
+    }
+
+    // 보유 상태가 변하지 않는 구간의 자산을 한 번에 기록
+    void fillEquity(const int *prices, size_t len)
+    {
+        if (len == 0)
+            return;
+        const long c = cash.won;
+        const long sh = shares;
+
+        if (keepHistory)
+        {
+            size_t base = equityHistory.size();
+            equityHistory.resize(base + len);
+
+            long *out = equityHistory.data() + base;
+            for (size_t i = 0; i < len; ++i)
+            {
+                out[i] = c + sh * prices[i];
+            }
+        }
+
+        for (size_t i = 0; i < len; ++i)
+        {
+            trackEquity(c + sh * prices[i]);
+        }
+    }
+
+    // 기본 전략용 - 이름은 strategyKindName의 정적 문자열을 그대로 쓴다
+    // (스윕/몬테카를로 워커가 설정마다 전략을 만들므로 생성 시 등록 잠금/문자열 할당을 하지 않는다)
+    TradingStrategy(long initCash, StrategyKind k)
+        : name(strategyKindName(k)), kind(k), cash(initCash), shares(0), avgPrice(0), keepHistory(true),
+          buyCount(0), sellCount(0)
+    {
+        risk.start(initCash);
+    }
+
+public:
+    // 사용자 전략용 - 임시 문자열이어도 되도록 이름을 등록해 둔다
+    TradingStrategy(const string &n, long initCash, StrategyKind k = STRATEGY_CUSTOM)
+        : TradingStrategy(initCash, k)
+    {
+        name = StrategyNameRegistry::intern(n);
+    }
+
+    virtual ~TradingStrategy() {}
+
+    virtual void onPrice(size_t idx, int price, double rate) = 0;
+
+    // 배치 처리 지원 여부 (상태가 단순한 전략만 true)
+    virtual bool supportsBatch() const { return false; }
+
+    // prices/rates[0..len)은 인덱스 startIdx부터 시작하는 구간
+    // 기본 구현은 onPrice를 순서대로 호출한다.
+    virtual void onPriceBatch(size_t startIdx, const int *prices, const double *rates, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            onPrice(startIdx + i, prices[i], rates[i]);
+        }
+    }
+
+    virtual void onFinish(int lastPrice)
+    {
+    }
+
+    // 실행 전에 엔진이 종목의 지표 캐시를 넘긴다 (onPrice의 idx + offset이 캐시 인덱스)
+    // 지표를 쓰지 않는 전략은 무시한다
+    virtual void attachIndicators(const IndicatorCache *cache, size_t offset)
+    {
+    }
+
+    // 같은 객체로 새 시나리오를 다시 돌릴 수 있도록 초기 상태로 되돌린다
+    // (자산 곡선 버퍼는 용량을 유지해 재할당을 피한다)
+    virtual void reset(long initCash)
+    {
+        cash = Money(initCash);
+        shares = 0;
+        avgPrice = 0;
+        equityHistory.clear();
+        drawdown = DrawdownTracker();
+        risk.start(initCash);
+        buyCount = 0;
+        sellCount = 0;
+    }
+
+    // 체크포인트용 진행 상태 (파라미터는 생성자 값을 그대로 쓰므로 담지 않는다)
+    // 자산 곡선을 저장 중이면 곡선 전체가 들어가므로 긴 실행은 keepEquityHistory = false가 좋다
+    virtual void saveState(SnapshotWriter &w) const
+    {
+        w.pod(kind);
+        w.pod(cash);
+        w.pod(shares);
+        w.pod(avgPrice);
+        w.pod(buyCount);
+        w.pod(sellCount);
+        w.pod(drawdown);
+        risk.save(w);
+        w.podVector(equityHistory);
+    }
+
+    // 종류가 다른 전략의 상태이거나 데이터가 잘렸으면 false
+    virtual bool restoreState(SnapshotReader &r)
+    {
+        StrategyKind stored;
+        if (!r.pod(stored) || stored != kind)
+            return false;
+        r.pod(cash);
+        r.pod(shares);
+        r.pod(avgPrice);
+        r.pod(buyCount);
+        r.pod(sellCount);
+        r.pod(drawdown);
+        if (!risk.restore(r))
+            return false;
+        r.podVector(equityHistory);
+        if (!keepHistory)
+            equityHistory.clear();
+        return r.ok();
+    }
+
+    const char *getName() const { return name; }
+    StrategyKind getKind() const { return kind; }
+
+    long getTotalValue(int price) const
+    {
+        return cash.won + (long)shares * price;
+    }
+
+    Money getCash() const { return cash; }
+
+    // 길이를 아는 경우 미리 버퍼를 잡아 재할당을 없앤다
+    void reserveHistory(size_t len)
+    {
+        if (keepHistory)
+            equityHistory.reserve(equityHistory.size() + len);
+    }
+
+    void setKeepHistory(bool keep)
+    {
+        keepHistory = keep;
+        if (!keep)
+        {
+            equityHistory.clear();
+            equityHistory.shrink_to_fit();
+        }
+    }
+
+    // 기록된 자산 기준 최대 낙폭 (%) - 자산 곡선을 저장하지 않아도 같은 값
+    double getMaxDrawdown() const
+    {
+        return drawdown.getMaxDrawdown();
+    }
+
+    // 이동 변동성 구간 길이 (기록 전에 호출)
+    void setRiskWindow(size_t windowSize)
+    {
+        if (windowSize != risk.window.size())
+            risk.setWindowSize(windowSize);
+    }
+
+    // 소르티노 기준 수익률 (기록 전에 리포트와 같은 값으로 호출)
+    void setRiskTarget(double periodsPerYear, double riskFreeRate)
+    {
+        risk.setDownsideTarget(periodsPerYear, riskFreeRate);
+    }
+
+    RiskMetrics getRiskMetrics(double periodsPerYear, double riskFreeRate) const
+    {
+        return risk.compute(periodsPerYear, riskFreeRate, drawdown.getMaxDrawdown());
+    }
+
+    // 이후 자산 곡선 버퍼를 arena에서 할당 (기록 전에 호출)
+    void useArena(Arena *arena)
+    {
+        equityHistory = EquityBuffer(ArenaAllocator<long>(arena));
+    }
+
+    const EquityBuffer &getEquityHistory() const { return equityHistory; }
+    bool isKeepingHistory() const { return keepHistory; }
+    int getBuyCount() const { return buyCount; }
+    int getSellCount() const { return sellCount; }
+    int getShares() const { return shares; }
+    int getAvgPrice() const { return avgPrice; }
+};
+
+// PanicSellStrategy 클래스 (쫄보)
+class PanicSellStrategy : public TradingStrategy
+{
+private:
+    double stopLossRate;
+    FeeSchedule feeSchedule;
+    bool hasBought;
+
+    bool isStopHit(int price) const
+    {
+        double profitRate = (double)(price - avgPrice) / avgPrice;
+        return profitRate <= stopLossRate;
+    }
+
+    void step(int price, const FeeSchedule &fee)
+    {
+        // 첫 시점에 전액 매수
+        if (!hasBought && cash.won >= price)
+        {
+            int qty = (int)(cash.won / fee.withFee(price));
+            if (qty > 0)
+            {
+                buy(price, qty, fee);
+                hasBought = true;
+            }
+        }
+        // 보유 중이면 손절 체크
+        else if (shares > 0 && avgPrice > 0)
+        {
+            if (isStopHit(price))
+            {
+                sellAll(price, fee);
+            }
+        }
+    }
+
+public:
+    PanicSellStrategy(long initCash, double threshold, double fee)
+        : TradingStrategy(initCash, STRATEGY_PANIC_SELL),
+          stopLossRate(threshold), feeSchedule(FeeSchedule::fromRate(fee)), hasBought(false) {}
+
+    // 가상 호출 없이 한 틱 처리 (StaticBacktestEngine에서 직접 호출)
+    void tick(size_t idx, int price, double changeRate, const FeeSchedule &fee)
+    {
+        step(price, fee);
+        // 매 시점 자산 기록
+        recordEquity(price);
+    }
+
+    // 매매 판단만 (자산은 기록하지 않음, LaneBacktestEngine이 자산 지표를 따로 계산)
+    void trade(size_t idx, int price, const FeeSchedule &fee)
+    {
+        step(price, fee);
+    }
+
+    void onPrice(size_t idx, int price, double changeRate) override
+    {
+        tick(idx, price, changeRate, feeSchedule);
+    }
+
+    const FeeSchedule &getFeeSchedule() const { return feeSchedule; }
+    double getStopLossRate() const { return stopLossRate; }
+    bool getHasBought() const { return hasBought; }
+
+    void reset(long initCash) override
+    {
+        TradingStrategy::reset(initCash);
+        hasBought = false;
+    }
+
+    void saveState(SnapshotWriter &w) const override
+    {
+        TradingStrategy::saveState(w);
+        w.pod(hasBought);
+    }
+
+    bool restoreState(SnapshotReader &r) override
+    {
+        return TradingStrategy::restoreState(r) && r.pod(hasBought);
+    }
+
+    bool supportsBatch() const override { return true; }
+
+    // 매수 전 -> 보유(손절 대기) -> 손절 후 세 구간으로 나눠 처리
+    void onPriceBatch(size_t startIdx, const int *prices, const double *rates, size_t len) override
+    {
+        size_t i = 0;
+        for (; i < len && !hasBought; ++i)
+        {
+            step(prices[i], feeSchedule);
+            recordEquity(prices[i]);
+        }
+
+        if (i < len && shares > 0 && avgPrice > 0)
+        {
+            size_t hit = i;
+            while (hit < len && !isStopHit(prices[hit]))
+                ++hit;
+            fillEquity(prices + i, hit - i);
+            i = hit;
+
+            if (i < len)
+            {
+                sellAll(prices[i], feeSchedule);
+                recordEquity(prices[i]);
+                ++i;
+            }
+        }
+        fillEquity(prices + i, len - i);
+    }
+};
+
+// DCAStrategy 클래스 (코치)
+class DCAStrategy : public TradingStrategy
+{
+private:
+    double dcaDropRate;
+    int dcaInterval;
+    double buyRatio;
+    FeeSchedule feeSchedule;
+    int lastBuyIndex;
+    int lastBuyPrice;
+
+public:
+    DCAStrategy(long initCash, double dropRate, int interval, double ratio, double fee)
+        : TradingStrategy(initCash, STRATEGY_DCA),
+          dcaDropRate(dropRate), dcaInterval(interval), buyRatio(ratio), feeSchedule(FeeSchedule::fromRate(fee)),
+          lastBuyIndex(-1), lastBuyPrice(0) {}
+
+    void reset(long initCash) override
+    {
+        TradingStrategy::reset(initCash);
+        lastBuyIndex = -1;
+        lastBuyPrice = 0;
+    }
+
+    void saveState(SnapshotWriter &w) const override
+    {
+        TradingStrategy::saveState(w);
+        w.pod(lastBuyIndex);
+        w.pod(lastBuyPrice);
+    }
+
+    bool restoreState(SnapshotReader &r) override
+    {
+        return TradingStrategy::restoreState(r) && r.pod(lastBuyIndex) && r.pod(lastBuyPrice);
+    }
+
+    // 매매 판단만 (자산은 기록하지 않음, LaneBacktestEngine이 자산 지표를 따로 계산)
+    void trade(size_t idx, int price, const FeeSchedule &fee)
+    {
+        bool shouldBuy = false;
+
+        if (lastBuyIndex < 0 && cash.won >= price)
+        {
+            shouldBuy = true; // 첫 매수
+        }
+        else if (cash.won >= price)
+        {
+            bool intervalMet = ((int)idx - lastBuyIndex) >= dcaInterval;
+            bool dropMet = (lastBuyPrice > 0) &&
+                           ((double)(price - lastBuyPrice) / lastBuyPrice <= dcaDropRate);
+
+            if (intervalMet || dropMet)
+                shouldBuy = true;
+        }
+
+        if (shouldBuy)
+        {
+            Money buyAmount = cash.scaled(buyRatio);
+            // 최소 1주 이상 살 수 있는지 체크
+            if (buyAmount.won < price)
+                buyAmount = cash;
+
+            int qty = (int)(buyAmount.won / fee.withFee(price));
+            if (qty > 0)
+            {
+                buy(price, qty, fee);
+                lastBuyIndex = (int)idx;
+                lastBuyPrice = price;
+            }
+        }
+    }
+
+    // 가상 호출 없이 한 틱 처리 (StaticBacktestEngine에서 직접 호출)
+    void tick(size_t idx, int price, double changeRate, const FeeSchedule &fee)
+    {
+        trade(idx, price, fee);
+        recordEquity(price);
+    }
+
+    void onPrice(size_t idx, int price, double changeRate) override
+    {
+        tick(idx, price, changeRate, feeSchedule);
+    }
+
+    const FeeSchedule &getFeeSchedule() const { return feeSchedule; }
+    double getDropRate() const { return dcaDropRate; }
+    int getInterval() const { return dcaInterval; }
+    int getLastBuyIndex() const { return lastBuyIndex; }
+    int getLastBuyPrice() const { return lastBuyPrice; }
+};
+
+// HoldStrategy 클래스 (존버)
+class HoldStrategy : public TradingStrategy
+{
+private:
+    double initialBuyRatio;
+    FeeSchedule feeSchedule;
+    bool hasBought;
+
+    void step(int price, const FeeSchedule &fee)
+    {
+        if (!hasBought && cash.won >= price)
+        {
+            Money buyAmount = cash.scaled(initialBuyRatio);
+
+            int qty = (int)(buyAmount.won / fee.withFee(price));
+            if (qty > 0)
+            {
+                buy(price, qty, fee);
+                hasBought = true;
+            }
+        }
+    }
+
+public:
+    HoldStrategy(long initCash, double ratio, double fee)
+        : TradingStrategy(initCash, STRATEGY_HOLD),
+          initialBuyRatio(ratio), feeSchedule(FeeSchedule::fromRate(fee)), hasBought(false) {}
+
+    // 가상 호출 없이 한 틱 처리 (StaticBacktestEngine에서 직접 호출)
+    void tick(size_t idx, int price, double changeRate, const FeeSchedule &fee)
+    {
+        step(price, fee);
+        recordEquity(price);
+    }
+
+    // 매매 판단만 (자산은 기록하지 않음, LaneBacktestEngine이 자산 지표를 따로 계산)
+    void trade(size_t idx, int price, const FeeSchedule &fee)
+    {
+        step(price, fee);
+    }
+
+    void onPrice(size_t idx, int price, double changeRate) override
+    {
+        tick(idx, price, changeRate, feeSchedule);
+    }
+
+    const FeeSchedule &getFeeSchedule() const { return feeSchedule; }
+    bool getHasBought() const { return hasBought; }
+
+    void reset(long initCash) override
+    {
+        TradingStrategy::reset(initCash);
+        hasBought = false;
+    }
+
+    void saveState(SnapshotWriter &w) const override
+    {
+        TradingStrategy::saveState(w);
+        w.pod(hasBought);
+    }
+
+    bool restoreState(SnapshotReader &r) override
+    {
+        return TradingStrategy::restoreState(r) && r.pod(hasBought);
+    }
+
+    bool supportsBatch() const override { return true; }
+
+    // 첫 매수 이후에는 보유량이 고정이므로 자산을 일괄 계산
+    void onPriceBatch(size_t startIdx, const int *prices, const double *rates, size_t len) override
+    {
+        size_t i = 0;
+        for (; i < len && !hasBought; ++i)
+        {
+            step(prices[i], feeSchedule);
+            recordEquity(prices[i]);
+        }
+        fillEquity(prices + i, len - i);
+    }
+};
+
+// MovingAverageCrossStrategy 클래스 (추세)
+// 단기 이동 평균이 장기 이동 평균 위로 올라가면 전액 매수, 아래로 내려가면 전량 매도.
+// 이동 평균은 종목의 IndicatorCache에서 읽으므로 같은 기간을 쓰는 전략/스윕 워커끼리 공유된다.
+class MovingAverageCrossStrategy : public TradingStrategy
+{
+private:
+    size_t shortPeriod;
+    size_t longPeriod;
+    FeeSchedule feeSchedule;
+    const double *shortAverage; // 캐시 인덱스 기준 (bind 전에는 nullptr)
+    const double *longAverage;
+    size_t indexOffset;
+
+public:
+    MovingAverageCrossStrategy(long initCash, size_t shortLen, size_t longLen, double fee)
+        : TradingStrategy(initCash, STRATEGY_MA_CROSS),
+          shortPeriod(shortLen), longPeriod(longLen), feeSchedule(FeeSchedule::fromRate(fee)),
+          shortAverage(nullptr), longAverage(nullptr), indexOffset(0) {}
+
+    void attachIndicators(const IndicatorCache *cache, size_t offset) override
+    {
+        shortAverage = cache ? cache->sma(shortPeriod) : nullptr;
+        longAverage = cache ? cache->sma(longPeriod) : nullptr;
+        indexOffset = offset;
+    }
+
+    void onPrice(size_t idx, int price, double changeRate) override
+    {
+        size_t at = idx + indexOffset;
+        // 지표가 없거나 장기 평균이 아직 채워지지 않았으면 관망
+        if (shortAverage && longAverage && at + 1 >= longPeriod)
+        {
+            if (shares == 0 && shortAverage[at] > longAverage[at])
+            {
+                int qty = (int)(cash.won / feeSchedule.withFee(price));
+                if (qty > 0)
+                    buy(price, qty, feeSchedule);
+            }
+            else if (shares > 0 && shortAverage[at] < longAverage[at])
+            {
+                sellAll(price, feeSchedule);
+            }
+        }
+        recordEquity(price);
+    }
+};
+
+// BacktestEngine 클래스
+class BacktestEngine
+{
+private:
+    const Stock *stock;
+    BacktestConfig config;
+    Arena *arena;              // 있으면 전략과 자산 곡선을 여기서 할당
+    vector<TradingStrategy *> strategies;
+    vector<char> arenaOwned;   // strategies[i]가 arena에 있는지
+    vector<StrategyReport> results;
+    vector<double> rateBuffer;               // runBattle 사이에 재사용
+    vector<TradingStrategy *> tickStrategies; // runBattle 사이에 재사용
+
+#if OOP_PROFILE
+    // 틱 전략마다 onPrice 한 번씩 사이클을 재고 runBattle 끝에 한 번만 Profiler로 넘긴다
+    void runTicksProfiled(const int *prices, const double *rates, size_t first, size_t len)
+    {
+        vector<StrategyProfile> profiles(tickStrategies.size());
+        for (size_t i = first; i < len; ++i)
+        {
+            for (size_t k = 0; k < tickStrategies.size(); ++k)
+            {
+                uint64_t allocs = profileThreadAllocs;
+                uint64_t start = readCycles();
+                tickStrategies[k]->onPrice(i, prices[i], rates[i]);
+                profiles[k].add(readCycles() - start, 1, profileThreadAllocs - allocs);
+            }
+        }
+        for (size_t k = 0; k < tickStrategies.size(); ++k)
+            Profiler::instance().recordStrategy(tickStrategies[k]->getName(), profiles[k]);
+    }
+#endif
+
+    // 등락률은 루프 밖에서 한 번만 계산 (rates[0] = 0)
+    const double *computeRates(const int *prices, size_t len)
+    {
+        rateBuffer.resize(len);
+        fillRates(prices, len, rateBuffer.data());
+        return rateBuffer.data();
+    }
+
+    void prepareRun(size_t len, size_t offset)
+    {
+        for (TradingStrategy *s : strategies)
+        {
+            s->attachIndicators(&stock->getIndicators(), offset);
+            s->setKeepHistory(config.keepEquityHistory);
+            s->setRiskWindow(config.rollingWindow);
+            s->setRiskTarget(config.periodsPerYear, config.riskFreeRate);
+            s->reserveHistory(len);
+        }
+    }
+
+    // 인덱스 [begin, end) 처리 (배치 지원 전략은 구간을 한 번에, 나머지는 틱 단위)
+    // 구간을 나눠 여러 번 불러도 한 번에 처리한 것과 결과가 같다
+    void runRange(const int *prices, const double *rates, size_t begin, size_t end)
+    {
+        tickStrategies.clear();
+        for (TradingStrategy *s : strategies)
+        {
+            if (s->supportsBatch())
+            {
+#if OOP_PROFILE
+                StrategyProfileScope timer(s->getName(), end - begin);
+#endif
+                s->onPriceBatch(begin, prices + begin, rates + begin, end - begin);
+            }
+            else
+            {
+                tickStrategies.push_back(s);
+            }
+        }
+
+        if (!tickStrategies.empty())
+        {
+#if OOP_PROFILE
+            runTicksProfiled(prices, rates, begin, end);
+#else
+            for (size_t i = begin; i < end; ++i)
+            {
+                for (TradingStrategy *s : tickStrategies)
+                {
+                    s->onPrice(i, prices[i], rates[i]);
+                }
+            }
+#endif
+        }
+    }
+
+    void finishRun(int lastPrice)
+    {
+        results.reserve(results.size() + strategies.size());
+        for (TradingStrategy *s : strategies)
+        {
+            s->onFinish(lastPrice);
+            results.push_back(buildReport(s, config.initialCash, lastPrice,
+                                          config.periodsPerYear, config.riskFreeRate));
+        }
+    }
+
+    // 스냅샷이 같은 가격 데이터에서 나왔는지 확인용 (FNV-1a)
+    static uint64_t fingerprint(const int *prices, size_t len)
+    {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (size_t i = 0; i < len; ++i)
+        {
+            h ^= (uint32_t)prices[i];
+            h *= 0x100000001B3ULL;
+        }
+        return h;
+    }
+
+    // 지문은 이력 길이에 비례하므로 실행 중에는 한 번만 계산해 넘긴다
+    void writeState(SnapshotWriter &w, size_t nextIndex, uint64_t print) const
+    {
+        w.header(SNAPSHOT_BACKTEST);
+        w.pod((uint64_t)stock->getHistoryLength());
+        w.pod(print);
+        w.pod((uint64_t)nextIndex);
+        w.pod((uint64_t)strategies.size());
+        for (const TradingStrategy *s : strategies)
+            s->saveState(w);
+    }
+
+public:
+    // arena를 넘기면 emplaceStrategy로 만든 전략이 채워진다
+    // (엔진이 먼저 소멸한 뒤에 arena를 reset해야 한다)
+    BacktestEngine(const Stock *s, const BacktestConfig &cfg, Arena *a = nullptr)
+        : stock(s), config(cfg), arena(a) {}
+
+    // 현재 전략 상태를 lastPrice 기준으로 평가한 리포트
+    static StrategyReport buildReport(const TradingStrategy *s, long initialCash, int lastPrice,
+                                      double periodsPerYear = DEFAULT_PERIODS_PER_YEAR,
+                                      double riskFreeRate = 0.0)
+    {
+        OOP_PROFILE_SCOPE(ZONE_BUILD_REPORT);
+        StrategyReport report;
+        report.kind = s->getKind();
+        report.strategyName = s->getName();
+        report.initialCash = initialCash;
+        report.finalEquity = s->getTotalValue(lastPrice);
+        report.totalReturn = (double)(report.finalEquity - report.initialCash) / report.initialCash * 100.0;
+        report.buyCount = s->getBuyCount();
+        report.sellCount = s->getSellCount();
+        report.finalShares = s->getShares();
+        report.avgPrice = s->getAvgPrice();
+        {
+            OOP_PROFILE_SCOPE(ZONE_FINALIZE_RISK);
+            report.maxDrawdown = s->getMaxDrawdown();
+            report.risk = s->getRiskMetrics(periodsPerYear, riskFreeRate);
+        }
+        return report;
+    }
+
+    ~BacktestEngine()
+    {
+        for (size_t i = 0; i < strategies.size(); ++i)
+        {
+            if (arenaOwned[i])
+                strategies[i]->~TradingStrategy(); // 메모리는 arena가 회수
+            else
+                delete strategies[i];
+        }
+    }
+
+    BacktestEngine(const BacktestEngine &) = delete;
+    BacktestEngine &operator=(const BacktestEngine &) = delete;
+
+    // new로 만든 전략을 넘기면 엔진이 delete한다
+    void addStrategy(TradingStrategy *s)
+    {
+        strategies.push_back(s);
+        arenaOwned.push_back(0);
+    }
+
+    // arena가 있으면 전략과 자산 곡선을 arena에 연속으로 배치
+    template <typename T, typename... Args>
+    T *emplaceStrategy(Args &&...args)
+    {
+        if (!arena)
+        {
+            T *s = new T(forward<Args>(args)...);
+            addStrategy(s);
+            return s;
+        }
+
+        T *s = arena->create<T>(forward<Args>(args)...);
+        s->useArena(arena);
+        strategies.push_back(s);
+        arenaOwned.push_back(1);
+        return s;
+    }
+
+    // config 값으로 기본 3개 전략(쫄보, 코치, 존버) 추가
+    void addDefaultStrategies()
+    {
+        emplaceStrategy<PanicSellStrategy>(
+            config.initialCash, config.panicThreshold, config.feeRate);
+        emplaceStrategy<DCAStrategy>(
+            config.initialCash, config.dcaDropRate,
+            config.dcaInterval, config.dcaBuyRatio, config.feeRate);
+        emplaceStrategy<HoldStrategy>(
+            config.initialCash, config.holdBuyRatio, config.feeRate);
+    }
+
+    // rates[i] = prices[i - 1] 대비 등락률 (%), rates[0] = 0 (runSeries에 넘길 등락률을 밖에서 만들 때)
+    static void fillRates(const int *prices, size_t len, double *rates)
+    {
+        if (len == 0)
+            return;
+        rates[0] = 0.0;
+        for (size_t i = 1; i < len; ++i)
+        {
+            rates[i] = (double)(prices[i] - prices[i - 1]) / prices[i - 1] * 100;
+        }
+    }
+
+    void runBattle()
+    {
+        size_t len = stock->getHistoryLength();
+        if (len == 0)
+            return;
+
+        const int *prices = stock->getHistoryData();
+        runSeries(prices, computeRates(prices, len), len);
+    }
+
+    // 미리 계산해 둔 가격/등락률 구간으로 실행 (긴 시계열의 일부 구간을 복사 없이 쓸 때)
+    // prices는 stock 이력의 offset 위치부터이고, rates[i]는 prices[i - 1] 대비 등락률(%)이다.
+    // 구간 첫 틱의 등락률은 rates[0]과 관계없이 0으로 본다.
+    // 결과는 구간만 잘라 만든 Stock으로 runBattle한 것과 같다 (지표는 전체 이력 기준이라 예열 구간이 이어진다).
+    void runSeries(const int *prices, const double *rates, size_t len, size_t offset = 0)
+    {
+        OOP_PROFILE_SCOPE(ZONE_RUN_BATTLE);
+        if (len == 0)
+            return;
+
+        prepareRun(len, offset);
+
+        // 잘라 온 구간이면 첫 틱만 등락률 0으로 따로 처리
+        size_t first = 0;
+        if (rates[0] != 0.0)
+        {
+            for (TradingStrategy *s : strategies)
+                s->onPrice(0, prices[0], 0.0);
+            first = 1;
+        }
+
+        runRange(prices, rates, first, len);
+        finishRun(prices[len - 1]);
+    }
+
+    // 전략 상태와 다음에 처리할 인덱스를 스냅샷으로 (종목 이력의 길이/지문도 함께 담는다)
+    void saveState(SnapshotWriter &w, size_t nextIndex) const
+    {
+        writeState(w, nextIndex, fingerprint(stock->getHistoryData(), stock->getHistoryLength()));
+    }
+
+    // 같은 종목 이력, 같은 순서의 전략으로 만든 엔진에서만 복원된다
+    bool restoreState(SnapshotReader &r, size_t &nextIndex)
+    {
+        size_t len = stock->getHistoryLength();
+        uint64_t storedLen = 0, storedPrint = 0, next = 0, count = 0;
+        if (!r.header(SNAPSHOT_BACKTEST) || !r.pod(storedLen) || !r.pod(storedPrint) ||
+            !r.pod(next) || !r.pod(count))
+            return false;
+        if (storedLen != len || storedPrint != fingerprint(stock->getHistoryData(), len) ||
+            next > len || count != strategies.size())
+            return false;
+        for (TradingStrategy *s : strategies)
+        {
+            if (!s->restoreState(r))
+                return false;
+        }
+        nextIndex = (size_t)next;
+        return r.ok() && r.atEnd();
+    }
+
+    // runBattle과 같은 결과를 내면서 interval 틱마다 상태를 writer로 넘긴다 (끝난 뒤에는 넘기지 않음)
+    // resume이 있으면 그 스냅샷의 다음 틱부터 이어서 실행하고, 이 엔진/종목과 맞지 않으면
+    // 아무것도 실행하지 않고 false (전략 상태는 reset 후 다시 쓸 수 있다)
+    bool runBattleCheckpointed(CheckpointWriter *writer, size_t interval,
+                               const vector<char> *resume = nullptr)
+    {
+        OOP_PROFILE_SCOPE(ZONE_RUN_BATTLE);
+        size_t len = stock->getHistoryLength();
+        if (len == 0)
+            return true;
+
+        const int *prices = stock->getHistoryData();
+        const double *rates = computeRates(prices, len);
+        prepareRun(len, 0);
+
+        size_t next = 0;
+        if (resume)
+        {
+            SnapshotReader reader(*resume);
+            if (!restoreState(reader, next))
+                return false;
+        }
+
+        SnapshotWriter snapshot;
+        uint64_t print = writer ? fingerprint(prices, len) : 0;
+        while (next < len)
+        {
+            size_t end = (interval == 0) ? len : min(len, next + interval);
+            runRange(prices, rates, next, end);
+            next = end;
+            if (writer && next < len)
+            {
+                snapshot.clear();
+                writeState(snapshot, next, print);
+                writer->submit(snapshot.data());
+            }
+        }
+
+        finishRun(prices[len - 1]);
+        return true;
+    }
+
+    // 전략과 버퍼는 그대로 두고 상태만 초기화 (같은 엔진으로 다음 시나리오 실행)
+    void reset()
+    {
+        results.clear();
+        for (TradingStrategy *s : strategies)
+            s->reset(config.initialCash);
+    }
+
+    const vector<StrategyReport> &getResults() const { return results; }
+    const vector<TradingStrategy *> &getStrategies() const { return strategies; }
+    const Stock *getStock() const { return stock; }
+};
+
+// 순위 기준 (MDD는 작을수록 앞 순위)
+enum RankKey
+{
+    RANK_TOTAL_RETURN,
+    RANK_MAX_DRAWDOWN,
+    RANK_SHARPE
+};
+
+// RankingOrder 구조체 (앞 기준이 같으면 다음 기준으로 비교, 최대 3개)
+struct RankingOrder
+{
+    RankKey keys[3];
+    int keyCount;
+
+    RankingOrder(RankKey first = RANK_TOTAL_RETURN) : keyCount(1)
+    {
+        keys[0] = keys[1] = keys[2] = first;
+    }
+
+    // 동률일 때 쓸 다음 기준 추가 (3개를 넘으면 무시)
+    RankingOrder then(RankKey next) const
+    {
+        RankingOrder o = *this;
+        if (o.keyCount < 3)
+            o.keys[o.keyCount++] = next;
+        return o;
+    }
+
+    // 클수록 앞 순위가 되도록 부호를 맞춘 값
+    static double value(const StrategyReport &r, RankKey key)
+    {
+        switch (key)
+        {
+        case RANK_MAX_DRAWDOWN:
+            return -r.maxDrawdown;
+        case RANK_SHARPE:
+            return r.risk.sharpeRatio;
+        default:
+            return r.totalReturn;
+        }
+    }
+
+    // a가 b보다 앞 순위인지 (모든 기준이 같으면 false)
+    bool better(const StrategyReport &a, const StrategyReport &b) const
+    {
+        for (int i = 0; i < keyCount; ++i)
+        {
+            double va = value(a, keys[i]);
+            double vb = value(b, keys[i]);
+            if (va != vb)
+                return va > vb;
+        }
+        return false;
+    }
+};
+
+// RankedReport 구조체 (순위에 든 결과와 출처)
+struct RankedReport
+{
+    StrategyReport report;
+    size_t configIndex; // 스윕 설정 번호 (단일 실행이면 0)
+    size_t sequence;    // 결과가 나온 순번 (기준이 모두 같으면 먼저 나온 쪽이 앞 순위)
+};
+
+// TopKRanker 클래스
+// 결과를 하나씩 받으면서 상위 k개만 힙으로 유지한다 (전체를 모으거나 정렬하지 않음).
+// 스레드마다 하나씩 두고 마지막에 merge로 합친다.
+class TopKRanker
+{
+private:
+    RankingOrder order;
+    size_t capacity;
+    vector<RankedReport> heap; // 맨 앞이 현재 k개 중 최하위
+
+    bool ahead(const RankedReport &a, const RankedReport &b) const
+    {
+        if (order.better(a.report, b.report))
+            return true;
+        if (order.better(b.report, a.report))
+            return false;
+        return a.sequence < b.sequence;
+    }
+
+    void push(const RankedReport &entry)
+    {
+        auto cmp = [this](const RankedReport &a, const RankedReport &b)
+        { return ahead(a, b); };
+        if (heap.size() < capacity)
+        {
+            heap.push_back(entry);
+            push_heap(heap.begin(), heap.end(), cmp);
+        }
+        else if (ahead(entry, heap.front())) // 대부분은 여기서 바로 탈락
+        {
+            pop_heap(heap.begin(), heap.end(), cmp);
+            heap.back() = entry;
+            push_heap(heap.begin(), heap.end(), cmp);
+        }
+    }
+
+public:
+    TopKRanker(size_t k, const RankingOrder &o = RankingOrder())
+        : order(o), capacity(k)
+    {
+        heap.reserve(k);
+    }
+
+    void offer(const StrategyReport &report, size_t configIndex, size_t sequence)
+    {
+        if (capacity == 0)
+            return;
+        RankedReport entry;
+        entry.report = report;
+        entry.configIndex = configIndex;
+        entry.sequence = sequence;
+        push(entry);
+    }
+
+    // 다른 스레드의 상위 k개를 합친다 (순번이 겹치지 않아야 순위가 결정적)
+    void merge(const TopKRanker &other)
+    {
+        for (const RankedReport &entry : other.heap)
+            push(entry);
+    }
+
+    size_t size() const { return heap.size(); }
+
+    // 1위부터 정렬된 사본
+    vector<RankedReport> sorted() const
+    {
+        vector<RankedReport> out = heap;
+        sort(out.begin(), out.end(), [this](const RankedReport &a, const RankedReport &b)
+             { return ahead(a, b); });
+        return out;
+    }
+};
+
+// BacktestReport 클래스
+class BacktestReport
+{
+private:
+    vector<StrategyReport> results;
+    string stockName;
+
+public:
+    BacktestReport(const BacktestEngine &engine)
+    {
+        results = engine.getResults();
+        stockName = engine.getStock()->getName();
+    }
+
+    void printSummary() const
+    {
+        cout << "\n=== 습관 교정 백테스터 결과 리포트 ===" << endl;
+        cout << "종목: " << stockName << endl;
+        if (results.empty())
+            return;
+
+        cout << "초기 자본: " << results[0].initialCash << "원" << endl
+             << endl;
+
+        for (const auto &res : results)
+        {
+            cout << "[" << res.strategyName << "]" << endl;
+            cout << "최종 자산: " << res.finalEquity << "원 | 수익률: "
+                 << fixed << setprecision(2) << res.totalReturn << "%" << endl;
+            cout << "MDD: " << res.maxDrawdown << "% | 매수: " << res.buyCount
+                 << "회 | 매도: " << res.sellCount << "회" << endl;
+            cout << "변동성(연): " << res.risk.annualVolatility << "% | 샤프: " << res.risk.sharpeRatio
+                 << " | 소르티노: " << res.risk.sortinoRatio << " | 칼마: " << res.risk.calmarRatio
+                 << " | 최장 낙폭 기간: " << res.risk.maxDrawdownDuration << "일" << endl
+                 << endl;
+        }
+    }
+
+    // 수익률 순위 출력 (같은 수익률이면 먼저 실행된 전략이 앞)
+    void printRanking() const
+    {
+        if (results.empty())
+            return;
+
+        TopKRanker ranker(results.size(), RankingOrder(RANK_TOTAL_RETURN));
+        for (size_t i = 0; i < results.size(); ++i)
+            ranker.offer(results[i], 0, i);
+        vector<RankedReport> ranked = ranker.sorted();
+
+        cout << "순위: ";
+        for (size_t i = 0; i < ranked.size(); ++i)
+        {
+            const StrategyReport &r = ranked[i].report;
+            cout << (i + 1) << ". " << r.strategyName
+                 << "(" << (r.totalReturn > 0 ? "+" : "")
+                 << fixed << setprecision(0) << r.totalReturn << "%) ";
+        }
+        cout << endl;
+
+        cout << "승자: " << ranked[0].report.strategyName << endl;
+    }
+
+    string getSummaryComment() const
+    {
+        if (results.size() < 2)
+            return "결과 부족";
+
+        // 전략 종류로 인덱스 찾기
+        int panicIdx = -1;
+        int dcaIdx = -1;
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            if (results[i].kind == STRATEGY_PANIC_SELL)
+                panicIdx = i;
+            if (results[i].kind == STRATEGY_DCA)
+                dcaIdx = i;
+        }
+
+        if (panicIdx == -1 || dcaIdx == -1)
+            return "비교 대상 전략이 없습니다.";
+
+        double panicReturn = results[panicIdx].totalReturn;
+        double dcaReturn = results[dcaIdx].totalReturn;
+        double diff = dcaReturn - panicReturn;
+
+        stringstream ss;
+        ss << fixed << setprecision(2);
+
+        if (diff > 0)
+        {
+            ss << "물타기 전략이 감정적 손절 전략보다 " << diff << "%p 높은 수익을 기록했습니다.\n"
+               << "뇌동매매를 줄이고 원칙을 지키는 습관을 길러보세요.";
+        }
+        else
+        {
+            ss << "이번 시나리오에서는 손절 전략이 유리했습니다.\n"
+               << "하지만 장기적으로는 원칙 투자가 더 안정적입니다.";
+        }
+        return ss.str();
+    }
+};
+
+// == 5-1. 병렬 파라미터 스윕 ==
+
+// SweepResult 구조체 (설정 하나에 대한 전략별 결과)
+struct SweepResult
+{
+    BacktestConfig config;
+    vector<StrategyReport> reports;
+};
+
+// ParameterSweepEngine 클래스
+// 하나의 Stock 가격 데이터를 읽기 전용으로 공유하고,
+// 여러 BacktestConfig를 워커 스레드들이 나눠서 실행한다.
+class ParameterSweepEngine
+{
+private:
+    const Stock *stock;
+    vector<BacktestConfig> configs;
+    unsigned int threadCount;
+
+    static const size_t JOB_CHUNK = 8; // 워커가 한 번에 가져가는 설정 수
+
+    // run(): 설정 순서대로 전체 결과 저장
+    struct CollectSink
+    {
+        const vector<BacktestConfig> *configs;
+        vector<SweepResult> *out;
+
+        void operator()(size_t i, const vector<StrategyReport> &reports)
+        {
+            (*out)[i].config = (*configs)[i];
+            (*out)[i].reports = reports;
+        }
+    };
+
+    // runTopK(): 워커별 상위 k개만 유지
+    struct RankSink
+    {
+        TopKRanker ranker;
+
+        RankSink(size_t k, const RankingOrder &order) : ranker(k, order) {}
+
+        void operator()(size_t i, const vector<StrategyReport> &reports)
+        {
+            for (size_t j = 0; j < reports.size(); ++j)
+                ranker.offer(reports[j], i, i * reports.size() + j);
+        }
+    };
+
+    unsigned int workerCount(size_t jobCount) const
+    {
+        unsigned int workers = threadCount;
+        if (workers == 0)
+            workers = thread::hardware_concurrency();
+        if (workers == 0)
+            workers = 1;
+        size_t maxWorkers = (jobCount + JOB_CHUNK - 1) / JOB_CHUNK;
+        if (workers > maxWorkers)
+            workers = (unsigned int)maxWorkers;
+        return workers;
+    }
+
+    // 등락률은 설정과 관계없으므로 실행 전에 한 번 만들어 모든 워커가 같이 읽는다
+    vector<double> computeRates() const
+    {
+        vector<double> rates(stock->getHistoryLength());
+        BacktestEngine::fillRates(stock->getHistoryData(), rates.size(), rates.data());
+        return rates;
+    }
+
+    // sink(설정 번호, 전략별 결과)는 워커 스레드 안에서만 불린다
+    template <typename Sink>
+    void runWorker(atomic<size_t> &nextJob, size_t last, const double *rates, Sink &sink) const
+    {
+        const int *prices = stock->getHistoryData();
+        size_t len = stock->getHistoryLength();
+        Arena arena; // 설정마다 엔진 하나를 만들고, 끝나면 통째로 되돌린다
+        while (true)
+        {
+            size_t begin = nextJob.fetch_add(JOB_CHUNK);
+            if (begin >= last)
+                break;
+            size_t end = min(begin + JOB_CHUNK, last);
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                // 스윕은 리포트만 필요하므로 자산 곡선은 저장하지 않는다
+                BacktestConfig cfg = configs[i];
+                cfg.keepEquityHistory = false;
+
+                {
+                    BacktestEngine engine(stock, cfg, &arena);
+                    engine.addDefaultStrategies();
+                    engine.runSeries(prices, rates, len);
+                    sink(i, engine.getResults());
+                }
+                arena.reset();
+            }
+        }
+    }
+
+    // 설정 [begin, end)를 실행, sinks 하나당 워커 하나 (sinks[0]은 호출 스레드)
+    // rates는 computeRates 결과
+    template <typename Sink>
+    void runPool(vector<Sink> &sinks, size_t begin, size_t end, const double *rates) const
+    {
+        atomic<size_t> nextJob(begin);
+        vector<thread> pool;
+        for (size_t t = 1; t < sinks.size(); ++t)
+        {
+            pool.emplace_back([this, &nextJob, end, rates, &sinks, t]
+                              { runWorker(nextJob, end, rates, sinks[t]); });
+        }
+        runWorker(nextJob, end, rates, sinks[0]); // 호출 스레드도 작업에 참여
+
+        for (thread &th : pool)
+            th.join();
+    }
+
+    // 스냅샷이 같은 설정 목록과 가격 데이터에서 나왔는지 확인용 (FNV-1a, 구조체 패딩은 보지 않는다)
+    uint64_t fingerprint() const
+    {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        auto mix = [&h](const void *data, size_t size)
+        {
+            const unsigned char *p = (const unsigned char *)data;
+            for (size_t i = 0; i < size; ++i)
+            {
+                h ^= p[i];
+                h *= 0x100000001B3ULL;
+            }
+        };
+        for (const BacktestConfig &cfg : configs)
+        {
+            mix(&cfg.initialCash, sizeof(cfg.initialCash));
+            mix(&cfg.feeRate, sizeof(cfg.feeRate));
+            mix(&cfg.panicThreshold, sizeof(cfg.panicThreshold));
+            mix(&cfg.dcaDropRate, sizeof(cfg.dcaDropRate));
+            mix(&cfg.dcaInterval, sizeof(cfg.dcaInterval));
+            mix(&cfg.dcaBuyRatio, sizeof(cfg.dcaBuyRatio));
+            mix(&cfg.holdBuyRatio, sizeof(cfg.holdBuyRatio));
+            mix(&cfg.periodsPerYear, sizeof(cfg.periodsPerYear));
+            mix(&cfg.riskFreeRate, sizeof(cfg.riskFreeRate));
+            mix(&cfg.rollingWindow, sizeof(cfg.rollingWindow));
+        }
+        mix(stock->getHistoryData(), stock->getHistoryLength() * sizeof(int));
+        return h;
+    }
+
+    // 끝난 설정 표시와 그 설정들의 결과 (이름 포인터는 담지 않고 복원할 때 kind로 채운다)
+    void saveState(SnapshotWriter &w, uint64_t print, const vector<char> &done,
+                   const vector<SweepResult> &out) const
+    {
+        w.header(SNAPSHOT_SWEEP);
+        w.pod((uint64_t)configs.size());
+        w.pod((uint64_t)stock->getHistoryLength());
+        w.pod(print);
+        w.podVector(done);
+
+        vector<StrategyReport> reports;
+        for (size_t i = 0; i < configs.size(); ++i)
+        {
+            if (!done[i])
+                continue;
+            reports = out[i].reports;
+            for (StrategyReport &rep : reports)
+                rep.strategyName = nullptr;
+            w.podVector(reports);
+        }
+    }
+
+    bool restoreState(SnapshotReader &r, vector<char> &done, vector<SweepResult> &out) const
+    {
+        uint64_t count = 0, len = 0, print = 0;
+        if (!r.header(SNAPSHOT_SWEEP) || !r.pod(count) || !r.pod(len) || !r.pod(print) || !r.podVector(done))
+            return false;
+        if (count != configs.size() || len != stock->getHistoryLength() || print != fingerprint() ||
+            done.size() != configs.size())
+            return false;
+
+        for (size_t i = 0; i < configs.size(); ++i)
+        {
+            if (!done[i])
+                continue;
+            if (!r.podVector(out[i].reports))
+                return false;
+            for (StrategyReport &rep : out[i].reports)
+                rep.strategyName = strategyKindName(rep.kind);
+            out[i].config = configs[i];
+        }
+        return r.atEnd();
+    }
+
+public:
+    // threads가 0이면 하드웨어 코어 수만큼 사용
+    ParameterSweepEngine(const Stock *s, unsigned int threads = 0)
+        : stock(s), threadCount(threads) {}
+
+    void addConfig(const BacktestConfig &cfg)
+    {
+        configs.push_back(cfg);
+    }
+
+    void setConfigs(const vector<BacktestConfig> &cfgs)
+    {
+        configs = cfgs;
+    }
+
+    size_t getConfigCount() const { return configs.size(); }
+
+    // 각 파라미터 후보 목록의 조합(그리드) 생성
+    // 비어 있는 목록은 base의 값을 그대로 사용
+    static vector<BacktestConfig> makeGrid(const BacktestConfig &base,
+                                           const vector<double> &panicThresholds,
+                                           const vector<double> &dcaDropRates,
+                                           const vector<int> &dcaIntervals,
+                                           const vector<double> &dcaBuyRatios,
+                                           const vector<double> &holdBuyRatios)
+    {
+        vector<double> panics = panicThresholds.empty() ? vector<double>(1, base.panicThreshold) : panicThresholds;
+        vector<double> drops = dcaDropRates.empty() ? vector<double>(1, base.dcaDropRate) : dcaDropRates;
+        vector<int> intervals = dcaIntervals.empty() ? vector<int>(1, base.dcaInterval) : dcaIntervals;
+        vector<double> dcaRatios = dcaBuyRatios.empty() ? vector<double>(1, base.dcaBuyRatio) : dcaBuyRatios;
+        vector<double> holdRatios = holdBuyRatios.empty() ? vector<double>(1, base.holdBuyRatio) : holdBuyRatios;
+
+        vector<BacktestConfig> grid;
+        grid.reserve(panics.size() * drops.size() * intervals.size() * dcaRatios.size() * holdRatios.size());
+
+        for (double panic : panics)
+            for (double drop : drops)
+                for (int interval : intervals)
+                    for (double dcaRatio : dcaRatios)
+                        for (double holdRatio : holdRatios)
+                        {
+                            BacktestConfig cfg = base;
+                            cfg.panicThreshold = panic;
+                            cfg.dcaDropRate = drop;
+                            cfg.dcaInterval = interval;
+                            cfg.dcaBuyRatio = dcaRatio;
+                            cfg.holdBuyRatio = holdRatio;
+                            grid.push_back(cfg);
+                        }
+        return grid;
+    }
+
+    // 결과는 configs와 같은 순서로 반환
+    vector<SweepResult> run() const
+    {
+        vector<SweepResult> out(configs.size());
+        if (configs.empty() || !stock || stock->getHistoryLength() == 0)
+            return out;
+
+        CollectSink sink;
+        sink.configs = &configs;
+        sink.out = &out;
+        vector<double> rates = computeRates();
+        vector<CollectSink> sinks(workerCount(configs.size()), sink);
+        runPool(sinks, 0, configs.size(), rates.data());
+        return out;
+    }
+
+    // run()과 같은 결과를 내면서 interval개 설정이 끝날 때마다 끝난 설정 표시와
+    // 그때까지의 결과를 writer로 넘긴다 (모두 끝난 뒤에는 넘기지 않음).
+    // resume이 있으면 끝난 설정은 건너뛰고, 설정 목록이나 종목 이력이 맞지 않으면
+    // ok = false와 빈 결과를 돌려준다.
+    vector<SweepResult> run(CheckpointWriter *writer, size_t interval,
+                            const vector<char> *resume = nullptr, bool *ok = nullptr) const
+    {
+        vector<SweepResult> out(configs.size());
+        if (ok)
+            *ok = true;
+        if (configs.empty() || !stock || stock->getHistoryLength() == 0)
+            return out;
+
+        vector<char> done(configs.size(), 0);
+        if (resume)
+        {
+            SnapshotReader reader(*resume);
+            if (!restoreState(reader, done, out))
+            {
+                if (ok)
+                    *ok = false;
+                return vector<SweepResult>();
+            }
+        }
+
+        size_t remaining = (size_t)count(done.begin(), done.end(), 0);
+        uint64_t print = writer ? fingerprint() : 0;
+        CollectSink sink;
+        sink.configs = &configs;
+        sink.out = &out;
+        SnapshotWriter snapshot;
+        vector<double> rates = computeRates();
+
+        size_t begin = 0;
+        while (remaining > 0)
+        {
+            // 끝나지 않은 설정이 이어진 구간을 interval개씩 실행
+            while (done[begin])
+                begin++;
+            size_t end = begin;
+            while (end < configs.size() && !done[end] && (interval == 0 || end - begin < interval))
+                end++;
+
+            vector<CollectSink> sinks(workerCount(end - begin), sink);
+            runPool(sinks, begin, end, rates.data());
+            fill(done.begin() + begin, done.begin() + end, 1);
+            remaining -= end - begin;
+            begin = end;
+
+            if (writer && remaining > 0)
+            {
+                snapshot.clear();
+                saveState(snapshot, print, done, out);
+                writer->submit(snapshot.data());
+            }
+        }
+        return out;
+    }
+
+    // 큰 스윕용: 전체 결과를 모으지 않고 상위 k개만 1위부터 반환
+    // (configIndex로 setConfigs/makeGrid의 설정을 찾는다)
+    vector<RankedReport> runTopK(size_t k, const RankingOrder &order = RankingOrder()) const
+    {
+        if (configs.empty() || !stock || stock->getHistoryLength() == 0 || k == 0)
+            return vector<RankedReport>();
+
+        vector<double> rates = computeRates();
+        vector<RankSink> sinks(workerCount(configs.size()), RankSink(k, order));
+        runPool(sinks, 0, configs.size(), rates.data());
+        for (size_t t = 1; t < sinks.size(); ++t)
+            sinks[0].ranker.merge(sinks[t].ranker);
+        return sinks[0].ranker.sorted();
+    }
+};
+
+// == 5-2. 멀티 종목 포트폴리오 백테스트 ==
+
+enum PriceLayout
+{
+    TIME_MAJOR,  // [시점][종목] - 매 시점 전 종목을 보는 전략에 유리
+    SYMBOL_MAJOR // [종목][시점] - 종목별로 독립 실행하는 전략에 유리
+};
+
+// PriceMatrix 클래스 (Market의 종목들을 하나의 타임라인으로 정렬한 가격표)
+class PriceMatrix
+{
+private:
+    PriceLayout layout;
+    size_t symbolCount;
+    size_t timeLength;
+    vector<int> data;
+
+    static int priceOf(const Stock *stock, size_t t)
+    {
+        size_t len = stock->getHistoryLength();
+        if (len == 0)
+            return stock->getCurrentPrice();
+        return stock->getHistoryData()[t < len ? t : len - 1];
+    }
+
+public:
+    PriceMatrix() : layout(TIME_MAJOR), symbolCount(0), timeLength(0) {}
+
+    // 타임라인 길이는 가장 긴 이력 기준
+    // 이력이 짧은 종목은 마지막 가격을 유지하고, 이력이 없으면 현재가를 사용
+    void load(const vector<Stock *> &stocks, PriceLayout lay, unsigned int threads = 0)
+    {
+        layout = lay;
+        symbolCount = stocks.size();
+        timeLength = 0;
+        for (const Stock *st : stocks)
+            timeLength = max(timeLength, st->getHistoryLength());
+
+        data.assign(symbolCount * timeLength, 0);
+
+        // 쓰는 메모리가 겹치지 않도록 레이아웃의 바깥 축으로 분할
+        if (layout == TIME_MAJOR)
+        {
+            parallelForRanges(timeLength, threads, [&](size_t begin, size_t end)
+                              {
+                for (size_t t = begin; t < end; ++t)
+                {
+                    int *row = &data[t * symbolCount];
+                    for (size_t sym = 0; sym < symbolCount; ++sym)
+                        row[sym] = priceOf(stocks[sym], t);
+                } });
+        }
+        else
+        {
+            parallelForRanges(symbolCount, threads, [&](size_t begin, size_t end)
+                              {
+                for (size_t sym = begin; sym < end; ++sym)
+                {
+                    int *series = &data[sym * timeLength];
+                    for (size_t t = 0; t < timeLength; ++t)
+                        series[t] = priceOf(stocks[sym], t);
+                } });
+        }
+    }
+
+    int at(size_t t, size_t sym) const
+    {
+        if (layout == TIME_MAJOR)
+            return data[t * symbolCount + sym];
+        return data[sym * timeLength + t];
+    }
+
+    // TIME_MAJOR 전용: 시점 t의 전 종목 가격
+    const int *getRow(size_t t) const { return &data[t * symbolCount]; }
+
+    // SYMBOL_MAJOR 전용: 종목 sym의 전체 시계열
+    const int *getSeries(size_t sym) const { return &data[sym * timeLength]; }
+
+    // 레이아웃과 관계없이 종목 시계열을 얻는다 (SYMBOL_MAJOR면 복사 없음)
+    const int *copySeries(size_t sym, vector<int> &buf) const
+    {
+        if (layout == SYMBOL_MAJOR)
+            return getSeries(sym);
+        buf.resize(timeLength);
+        for (size_t t = 0; t < timeLength; ++t)
+            buf[t] = data[t * symbolCount + sym];
+        return buf.data();
+    }
+
+    PriceLayout getLayout() const { return layout; }
+    size_t getSymbolCount() const { return symbolCount; }
+    size_t getTimeLength() const { return timeLength; }
+};
+
+// PortfolioStrategy 클래스 (추상) - 여러 종목에 자금을 배분하는 전략
+class PortfolioStrategy
+{
+protected:
+    const char *name; // 정적 문자열이거나 StrategyNameRegistry에 보관된 이름
+    Money cash;
+    FeeSchedule feeSchedule;
+    vector<int> shares;
+    vector<int> avgPrices;
+    vector<long> equityHistory;
+    bool keepHistory;
+    DrawdownTracker drawdown;
+    RiskTracker risk;
+    long lastEquity;
+    int buyCount;
+    int sellCount;
+
+    void buy(size_t sym, int price, int qty)
+    {
+        Money cost = Money::of(price, qty);
+        Money fee = feeSchedule.feeOn(cost);
+
+        if (cash >= cost + fee && qty > 0)
+        {
+            Money totalCost = Money::of(avgPrices[sym], shares[sym]) + cost;
+            shares[sym] += qty;
+            avgPrices[sym] = (int)(totalCost.won / shares[sym]);
+            cash -= (cost + fee);
+            buyCount++;
+        }
+    }
+
+    void sell(size_t sym, int price, int qty)
+    {
+        if (qty > shares[sym])
+            qty = shares[sym];
+        if (qty <= 0)
+            return;
+
+        Money revenue = Money::of(price, qty);
+        Money fee = feeSchedule.feeOn(revenue);
+        cash += (revenue - fee);
+        shares[sym] -= qty;
+        if (shares[sym] == 0)
+            avgPrices[sym] = 0;
+        sellCount++;
+    }
+
+    // 기본 전략용 - staticName은 리터럴처럼 프로그램이 끝날 때까지 유효해야 한다 (등록하지 않는다)
+    PortfolioStrategy(long initCash, double fee, const char *staticName)
+        : name(staticName), cash(initCash), feeSchedule(FeeSchedule::fromRate(fee)), keepHistory(true),
+          lastEquity(initCash), buyCount(0), sellCount(0)
+    {
+        risk.start(initCash);
+    }
+
+public:
+    // 사용자 전략용 - 임시 문자열이어도 되도록 이름을 등록해 둔다
+    PortfolioStrategy(const string &n, long initCash, double fee)
+        : PortfolioStrategy(initCash, fee, StrategyNameRegistry::intern(n)) {}
+
+    virtual ~PortfolioStrategy() {}
+
+    virtual void onStart(size_t symbolCount)
+    {
+        shares.assign(symbolCount, 0);
+        avgPrices.assign(symbolCount, 0);
+    }
+
+    // 시점 t에 전 종목 가격을 보고 주문 결정 (엔진이 시간 순서대로 호출)
+    virtual void onBar(size_t t, const PriceMatrix &m) {}
+
+    // 종목끼리 서로 독립이면 true -> 엔진이 종목 구간별로 병렬 실행
+    virtual bool isSymbolSeparable() const { return false; }
+
+    // [symBegin, symEnd) 종목을 전체 타임라인에 대해 실행하고
+    // 시점별 자산을 equityOut[t]에 더한다 (isSymbolSeparable 전략 전용)
+    virtual void runSymbols(const PriceMatrix &m, size_t symBegin, size_t symEnd, long *equityOut) {}
+
+    virtual void onFinish(const PriceMatrix &m) {}
+
+    // 시점 t 종가 기준 평가 금액
+    long getTotalValue(size_t t, const PriceMatrix &m) const
+    {
+        long total = cash.won;
+        if (m.getLayout() == TIME_MAJOR)
+        {
+            const int *row = m.getRow(t);
+            for (size_t sym = 0; sym < shares.size(); ++sym)
+                total += (long)shares[sym] * row[sym];
+        }
+        else
+        {
+            for (size_t sym = 0; sym < shares.size(); ++sym)
+                total += (long)shares[sym] * m.at(t, sym);
+        }
+        return total;
+    }
+
+    void recordEquity(long equity)
+    {
+        drawdown.track(equity);
+        risk.track(equity);
+        lastEquity = equity;
+        if (keepHistory)
+            equityHistory.push_back(equity);
+    }
+
+    void reserveHistory(size_t len)
+    {
+        if (keepHistory)
+            equityHistory.reserve(equityHistory.size() + len);
+    }
+
+    void setKeepHistory(bool keep)
+    {
+        keepHistory = keep;
+        if (!keep)
+        {
+            equityHistory.clear();
+            equityHistory.shrink_to_fit();
+        }
+    }
+
+    void setRiskWindow(size_t windowSize)
+    {
+        if (windowSize != risk.window.size())
+            risk.setWindowSize(windowSize);
+    }
+
+    void setRiskTarget(double periodsPerYear, double riskFreeRate)
+    {
+        risk.setDownsideTarget(periodsPerYear, riskFreeRate);
+    }
+
+    int getTotalShares() const
+    {
+        int total = 0;
+        for (int q : shares)
+            total += q;
+        return total;
+    }
+
+    const char *getName() const { return name; }
+    Money getCash() const { return cash; }
+    long getLastEquity() const { return lastEquity; }
+    double getMaxDrawdown() const { return drawdown.getMaxDrawdown(); }
+    RiskMetrics getRiskMetrics(double periodsPerYear, double riskFreeRate) const
+    {
+        return risk.compute(periodsPerYear, riskFreeRate, drawdown.getMaxDrawdown());
+    }
+    const vector<long> &getEquityHistory() const { return equityHistory; }
+    int getBuyCount() const { return buyCount; }
+    int getSellCount() const { return sellCount; }
+    int getShares(size_t sym) const { return shares[sym]; }
+};
+
+// EqualWeightRebalanceStrategy 클래스 (동일 비중 리밸런싱)
+class EqualWeightRebalanceStrategy : public PortfolioStrategy
+{
+private:
+    int rebalanceInterval;
+
+public:
+    EqualWeightRebalanceStrategy(long initCash, int interval, double fee)
+        : PortfolioStrategy(initCash, fee, "분산 (Equal Weight)"),
+          rebalanceInterval(interval > 0 ? interval : 1) {}
+
+    void onBar(size_t t, const PriceMatrix &m) override
+    {
+        size_t n = shares.size();
+        if (n == 0 || t % rebalanceInterval != 0)
+            return;
+
+        long target = getTotalValue(t, m) / (long)n;
+
+        // 매도로 현금을 먼저 확보한 뒤 매수
+        for (size_t sym = 0; sym < n; ++sym)
+        {
+            int price = m.at(t, sym);
+            int targetQty = (int)(target / feeSchedule.withFee(price));
+            if (shares[sym] > targetQty)
+                sell(sym, price, shares[sym] - targetQty);
+        }
+        for (size_t sym = 0; sym < n; ++sym)
+        {
+            int price = m.at(t, sym);
+            int targetQty = (int)(target / feeSchedule.withFee(price));
+            if (shares[sym] < targetQty)
+                buy(sym, price, targetQty - shares[sym]);
+        }
+    }
+};
+
+enum SleeveKind
+{
+    SLEEVE_PANIC,
+    SLEEVE_DCA,
+    SLEEVE_HOLD
+};
+
+// SleevePortfolioStrategy 클래스
+// 자금을 종목 수로 균등 분할하고, 종목마다 단일 종목 전략을 독립적으로 돌린다.
+class SleevePortfolioStrategy : public PortfolioStrategy
+{
+private:
+    SleeveKind kind;
+    BacktestConfig config;
+    vector<TradingStrategy *> sleeves;
+
+    void clearSleeves()
+    {
+        for (TradingStrategy *s : sleeves)
+            delete s;
+        sleeves.clear();
+    }
+
+    TradingStrategy *makeSleeve(long sleeveCash) const
+    {
+        switch (kind)
+        {
+        case SLEEVE_PANIC:
+            return new PanicSellStrategy(sleeveCash, config.panicThreshold, config.feeRate);
+        case SLEEVE_DCA:
+            return new DCAStrategy(sleeveCash, config.dcaDropRate,
+                                   config.dcaInterval, config.dcaBuyRatio, config.feeRate);
+        default:
+            return new HoldStrategy(sleeveCash, config.holdBuyRatio, config.feeRate);
+        }
+    }
+
+    static const char *sleeveName(SleeveKind k)
+    {
+        switch (k)
+        {
+        case SLEEVE_PANIC:
+            return "분산 쫄보 (Panic Sleeves)";
+        case SLEEVE_DCA:
+            return "분산 코치 (DCA Sleeves)";
+        default:
+            return "분산 존버 (Hold Sleeves)";
+        }
+    }
+
+public:
+    SleevePortfolioStrategy(SleeveKind k, const BacktestConfig &cfg)
+        : PortfolioStrategy(cfg.initialCash, cfg.feeRate, sleeveName(k)),
+          kind(k), config(cfg) {}
+
+    ~SleevePortfolioStrategy()
+    {
+        clearSleeves();
+    }
+
+    void onStart(size_t symbolCount) override
+    {
+        PortfolioStrategy::onStart(symbolCount);
+        clearSleeves();
+        if (symbolCount == 0)
+            return;
+
+        // 나누어 떨어지지 않는 잔액은 현금으로 남긴다
+        long sleeveCash = config.initialCash / (long)symbolCount;
+        cash = Money(config.initialCash - sleeveCash * (long)symbolCount);
+        for (size_t sym = 0; sym < symbolCount; ++sym)
+            sleeves.push_back(makeSleeve(sleeveCash));
+    }
+
+    bool isSymbolSeparable() const override { return true; }
+
+    void runSymbols(const PriceMatrix &m, size_t symBegin, size_t symEnd, long *equityOut) override
+    {
+        size_t len = m.getTimeLength();
+        vector<int> buf;
+        vector<double> rates(len);
+
+        for (size_t sym = symBegin; sym < symEnd; ++sym)
+        {
+            const int *prices = m.copySeries(sym, buf);
+            rates[0] = 0.0;
+            for (size_t t = 1; t < len; ++t)
+                rates[t] = (double)(prices[t] - prices[t - 1]) / prices[t - 1] * 100;
+
+            TradingStrategy *sleeve = sleeves[sym];
+            sleeve->setKeepHistory(true);
+            sleeve->reserveHistory(len);
+            if (sleeve->supportsBatch())
+            {
+                sleeve->onPriceBatch(0, prices, rates.data(), len);
+            }
+            else
+            {
+                for (size_t t = 0; t < len; ++t)
+                    sleeve->onPrice(t, prices[t], rates[t]);
+            }
+            sleeve->onFinish(prices[len - 1]);
+
+            const long *eq = sleeve->getEquityHistory().data();
+            for (size_t t = 0; t < len; ++t)
+                equityOut[t] += eq[t];
+            sleeve->setKeepHistory(false); // 합산 후 곡선 메모리 해제
+        }
+    }
+
+    void onFinish(const PriceMatrix &m) override
+    {
+        buyCount = 0;
+        sellCount = 0;
+        for (size_t sym = 0; sym < sleeves.size(); ++sym)
+        {
+            buyCount += sleeves[sym]->getBuyCount();
+            sellCount += sleeves[sym]->getSellCount();
+            shares[sym] = sleeves[sym]->getShares();
+            avgPrices[sym] = sleeves[sym]->getAvgPrice();
+        }
+    }
+};
+
+// PortfolioBacktestEngine 클래스
+// Market의 모든 종목을 하나의 타임라인으로 한 번에 실행한다.
+class PortfolioBacktestEngine
+{
+private:
+    const Market *market;
+    BacktestConfig config;
+    PriceLayout layout;
+    unsigned int threadCount;
+    PriceMatrix matrix;
+    vector<PortfolioStrategy *> strategies;
+    vector<StrategyReport> results;
+
+    StrategyReport buildReport(PortfolioStrategy *s)
+    {
+        StrategyReport report;
+        report.kind = STRATEGY_PORTFOLIO;
+        report.strategyName = s->getName();
+        report.initialCash = config.initialCash;
+        report.finalEquity = s->getLastEquity();
+        report.totalReturn = (double)(report.finalEquity - report.initialCash) / report.initialCash * 100.0;
+        report.maxDrawdown = s->getMaxDrawdown();
+        report.buyCount = s->getBuyCount();
+        report.sellCount = s->getSellCount();
+        report.finalShares = s->getTotalShares();
+        report.avgPrice = 0; // 여러 종목이므로 의미 없음
+        report.risk = s->getRiskMetrics(config.periodsPerYear, config.riskFreeRate);
+        return report;
+    }
+
+    // 종목 구간별로 병렬 실행 후 스레드별 부분 자산을 합산
+    void runSeparable(PortfolioStrategy *s)
+    {
+        size_t len = matrix.getTimeLength();
+        size_t n = matrix.getSymbolCount();
+
+        unsigned int workers = threadCount ? threadCount : thread::hardware_concurrency();
+        if (workers == 0)
+            workers = 1;
+        if (workers > n)
+            workers = (unsigned int)max<size_t>(n, 1);
+
+        vector<vector<long>> partials(workers, vector<long>(len, 0));
+        size_t chunk = n ? (n + workers - 1) / workers : 0;
+        parallelForRanges(workers, workers, [&](size_t begin, size_t end)
+                          {
+            for (size_t w = begin; w < end; ++w)
+            {
+                size_t symBegin = min(n, w * chunk);
+                size_t symEnd = min(n, symBegin + chunk);
+                s->runSymbols(matrix, symBegin, symEnd, partials[w].data());
+            } });
+
+        for (size_t t = 0; t < len; ++t)
+        {
+            long total = s->getCash().won;
+            for (unsigned int w = 0; w < workers; ++w)
+                total += partials[w][t];
+            s->recordEquity(total);
+        }
+    }
+
+public:
+    // threads가 0이면 하드웨어 코어 수만큼 사용
+    PortfolioBacktestEngine(const Market &m, const BacktestConfig &cfg,
+                            PriceLayout lay = TIME_MAJOR, unsigned int threads = 0)
+        : market(&m), config(cfg), layout(lay), threadCount(threads) {}
+
+    ~PortfolioBacktestEngine()
+    {
+        for (auto s : strategies)
+        {
+            delete s;
+        }
+    }
+
+    void addStrategy(PortfolioStrategy *s)
+    {
+        strategies.push_back(s);
+    }
+
+    void runBattle()
+    {
+        matrix.load(market->getStocks(), layout, threadCount);
+        size_t len = matrix.getTimeLength();
+        size_t n = matrix.getSymbolCount();
+        if (len == 0 || n == 0)
+            return;
+
+        vector<PortfolioStrategy *> serial;
+        for (PortfolioStrategy *s : strategies)
+        {
+            s->setKeepHistory(config.keepEquityHistory);
+            s->setRiskWindow(config.rollingWindow);
+            s->setRiskTarget(config.periodsPerYear, config.riskFreeRate);
+            s->reserveHistory(len);
+            s->onStart(n);
+
+            if (s->isSymbolSeparable())
+                runSeparable(s);
+            else
+                serial.push_back(s);
+        }
+
+        // 종목 간 배분 전략은 공유 타임라인을 한 번만 훑는다
+        if (!serial.empty())
+        {
+            for (size_t t = 0; t < len; ++t)
+            {
+                for (PortfolioStrategy *s : serial)
+                {
+                    s->onBar(t, matrix);
+                    s->recordEquity(s->getTotalValue(t, matrix));
+                }
+            }
+        }
+
+        for (PortfolioStrategy *s : strategies)
+        {
+            s->onFinish(matrix);
+            results.push_back(buildReport(s));
+        }
+    }
+
+    const vector<StrategyReport> &getResults() const { return results; }
+    const PriceMatrix &getMatrix() const { return matrix; }
+};
+
+// == 5-3. 실시간 스트리밍 백테스트 ==
+
+// StreamingBacktestEngine 클래스
+// 가격이 들어올 때마다 전략을 한 틱씩 진행하고, 리포트는 언제든 현재 상태로 계산한다.
+// 오래 돌릴 때는 config.keepEquityHistory를 false로 두면 메모리가 늘지 않는다.
+class StreamingBacktestEngine
+{
+private:
+    BacktestConfig config;
+    vector<TradingStrategy *> strategies;
+    vector<double> rateBuffer;
+    size_t tickCount;
+    int lastPrice;
+
+public:
+    StreamingBacktestEngine(const BacktestConfig &cfg)
+        : config(cfg), tickCount(0), lastPrice(0) {}
+
+    ~StreamingBacktestEngine()
+    {
+        for (auto s : strategies)
+        {
+            delete s;
+        }
+    }
+
+    StreamingBacktestEngine(const StreamingBacktestEngine &) = delete;
+    StreamingBacktestEngine &operator=(const StreamingBacktestEngine &) = delete;
+
+    // 첫 틱이 들어오기 전에 추가해야 같은 타임라인을 공유한다
+    void addStrategy(TradingStrategy *s)
+    {
+        s->setKeepHistory(config.keepEquityHistory);
+        s->setRiskWindow(config.rollingWindow);
+        s->setRiskTarget(config.periodsPerYear, config.riskFreeRate);
+        strategies.push_back(s);
+    }
+
+    void addDefaultStrategies()
+    {
+        addStrategy(new PanicSellStrategy(
+            config.initialCash, config.panicThreshold, config.feeRate));
+        addStrategy(new DCAStrategy(
+            config.initialCash, config.dcaDropRate,
+            config.dcaInterval, config.dcaBuyRatio, config.feeRate));
+        addStrategy(new HoldStrategy(
+            config.initialCash, config.holdBuyRatio, config.feeRate));
+    }
+
+    void pushTick(int price)
+    {
+        double changeRate = (tickCount == 0) ? 0.0 : (double)(price - lastPrice) / lastPrice * 100;
+        for (TradingStrategy *s : strategies)
+        {
+            s->onPrice(tickCount, price, changeRate);
+        }
+        lastPrice = price;
+        tickCount++;
+    }
+
+    // 여러 틱을 한 번에 받으면 배치 지원 전략은 구간 단위로 처리
+    void pushTicks(const int *prices, size_t len)
+    {
+        if (len == 0)
+            return;
+
+        rateBuffer.resize(len);
+        rateBuffer[0] = (tickCount == 0) ? 0.0 : (double)(prices[0] - lastPrice) / lastPrice * 100;
+        for (size_t i = 1; i < len; ++i)
+        {
+            rateBuffer[i] = (double)(prices[i] - prices[i - 1]) / prices[i - 1] * 100;
+        }
+
+        for (TradingStrategy *s : strategies)
+        {
+            if (s->supportsBatch())
+            {
+                s->onPriceBatch(tickCount, prices, rateBuffer.data(), len);
+            }
+            else
+            {
+                for (size_t i = 0; i < len; ++i)
+                    s->onPrice(tickCount + i, prices[i], rateBuffer[i]);
+            }
+        }
+        lastPrice = prices[len - 1];
+        tickCount += len;
+    }
+
+    // 지금까지 들어온 틱 기준 리포트 (전략 상태는 바꾸지 않음)
+    vector<StrategyReport> getReports() const
+    {
+        vector<StrategyReport> reports;
+        if (tickCount == 0)
+            return reports;
+        reports.reserve(strategies.size());
+        for (const TradingStrategy *s : strategies)
+        {
+            reports.push_back(BacktestEngine::buildReport(s, config.initialCash, lastPrice,
+                                                          config.periodsPerYear, config.riskFreeRate));
+        }
+        return reports;
+    }
+
+    size_t getTickCount() const { return tickCount; }
+    int getLastPrice() const { return lastPrice; }
+};
+
+// TickFileFollower 클래스
+// 계속 뒤에 추가되는 텍스트 파일(한 줄에 가격 하나)을 따라가며 새 줄만 읽는다.
+class TickFileFollower
+{
+private:
+    string path;
+    long offset;    // 다음에 읽을 파일 위치
+    string partial; // 아직 줄바꿈이 오지 않은 마지막 줄
+    vector<int> ticks;
+
+    void parseLine(const string &line)
+    {
+        int value = 0;
+        bool hasDigit = false;
+        for (char ch : line)
+        {
+            if (ch >= '0' && ch <= '9')
+            {
+                value = value * 10 + (ch - '0');
+                hasDigit = true;
+            }
+            else if (ch != ' ' && ch != '\t' && ch != '\r')
+            {
+                return; // 숫자가 아닌 줄은 무시
+            }
+        }
+        if (hasDigit && value > 0)
+            ticks.push_back(value);
+    }
+
+public:
+    TickFileFollower(const string &p) : path(p), offset(0) {}
+
+    // 새로 추가된 틱을 엔진에 넣고 개수 반환 (파일이 없으면 0)
+    size_t poll(StreamingBacktestEngine &engine)
+    {
+        FILE *fp = fopen(path.c_str(), "rb");
+        if (!fp)
+            return 0;
+
+        fseek(fp, 0, SEEK_END);
+        long end = ftell(fp);
+        if (end < offset)
+        {
+            // 파일이 잘리면 처음부터 다시 읽는다
+            offset = 0;
+            partial.clear();
+        }
+
+        string chunk;
+        if (end > offset)
+        {
+            chunk.resize((size_t)(end - offset));
+            fseek(fp, offset, SEEK_SET);
+            size_t got = fread(&chunk[0], 1, chunk.size(), fp);
+            chunk.resize(got);
+            offset += (long)got;
+        }
+        fclose(fp);
+
+        ticks.clear();
+        size_t start = 0;
+        for (size_t i = 0; i < chunk.size(); ++i)
+        {
+            if (chunk[i] == '\n')
+            {
+                partial.append(chunk, start, i - start);
+                parseLine(partial);
+                partial.clear();
+                start = i + 1;
+            }
+        }
+        partial.append(chunk, start, string::npos);
+
+        engine.pushTicks(ticks.data(), ticks.size());
+        return ticks.size();
+    }
+};
+
+// == 5-4. 다중 레인 전략 엔진 (SoA) ==
+// 기본 3개 전략(쫄보, 코치, 존버)을 여러 레인(몬테카를로 경로나 파라미터 조합)에 대해 같은 시점 순서로 함께 돌린다.
+// 레인 LANE_WIDTH개를 한 블록으로 묶어 상태를 필드별 배열로 두고, 틱마다
+//   1) 블록 전체의 매매 조건을 분기 없이 계산해 체결이 필요한 레인만 골라
+//   2) 그 레인만 전략 객체의 trade로 처리하고 (스칼라 실행과 같은 코드)
+//   3) 자산/MDD/위험 지표 갱신을 고정 길이 블록 루프로 돌린다 (자동 벡터화).
+// 자산은 정수라 2^53 미만이면 double로 정확하므로, RiskTracker와 같은 순서의 연산으로 runBattle과 비트 단위로 같은 리포트가 나온다.
+// GCC x86 기본 빌드는 실행 중인 CPU에 맞춰 AVX2 / AVX-512로 컴파일한 루프를 고른다.
+// (FMA로 곱셈-덧셈을 합치면 반올림이 달라지므로 이 루프들은 축약을 끈다.
+//  -march=native 처럼 파일 전체를 FMA 대상으로 빌드할 때는 -ffp-contract=off를 같이 줘야 스칼라와 같아진다.
+//  -O2의 기본 비용 모델과 부동소수점 예외 가정은 조건 선택이 있는 루프의 벡터화를 막아서 이 구간만 완화한다.
+//  둘 다 계산 결과는 바꾸지 않는다)
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && !defined(__AVX2__)
+#define OOP_LANE_DISPATCH 1
+#define OOP_LANE_INLINE __attribute__((always_inline)) inline
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off", "vect-cost-model=cheap", "no-trapping-math")
+#else
+#define OOP_LANE_DISPATCH 0
+#define OOP_LANE_INLINE inline
+#endif
+
+const size_t LANE_WIDTH = 8;                          // 블록 하나의 레인 수 (AVX-512 double 벡터 한 개)
+const double LANE_EXACT_LIMIT = 9007199254740992.0;   // 2^53 (이보다 작은 정수는 double로 정확)
+
+// LaneBlock 구조체 (전략 하나 x 레인 LANE_WIDTH개의 상태, 정수 값도 double로 둬서 루프 폭을 맞춘다)
+struct LaneBlock
+{
+    // 매매 판단용 (체결이 일어나면 전략 객체에서 다시 읽는다)
+    double cash[LANE_WIDTH];
+    double shares[LANE_WIDTH];
+    double avgPrice[LANE_WIDTH];
+    double bought[LANE_WIDTH];       // 쫄보/존버 첫 매수 여부 (0/1)
+    double lastBuyIndex[LANE_WIDTH]; // 코치
+    double lastBuyPrice[LANE_WIDTH]; // 코치
+    double threshold[LANE_WIDTH];    // 쫄보 손절률 / 코치 추가 매수 하락률
+    double interval[LANE_WIDTH];     // 코치 매수 간격
+
+    // DrawdownTracker
+    double peak[LANE_WIDTH];
+    double trough[LANE_WIDTH];
+    double maxDD[LANE_WIDTH];
+    double minEquity[LANE_WIDTH]; // 0 이하가 되면 스칼라로 다시 계산 (수익률을 건너뛰는 경우)
+
+    // RiskTracker (블록/이동 구간 진행 단계는 레인끼리 같아 엔진이 하나만 가진다)
+    double lastEquity[LANE_WIDTH];
+    double mean[LANE_WIDTH];
+    double m2[LANE_WIDTH];
+    double blockShift[LANE_WIDTH];
+    double blockSum[LANE_WIDTH];
+    double blockSumSq[LANE_WIDTH];
+    double downsideSq[LANE_WIDTH];
+    double downsideTarget[LANE_WIDTH]; // RiskTracker::periodTarget
+    double riskPeak[LANE_WIDTH];
+    double underwater[LANE_WIDTH];
+    double maxUnderwater[LANE_WIDTH];
+    double windowShift[LANE_WIDTH];
+    double windowSum[LANE_WIDTH];
+    double windowSumSq[LANE_WIDTH];
+    double maxWindowM2[LANE_WIDTH];
+    double ret[LANE_WIDTH]; // 이번 틱 수익률
+};
+
+static_assert(is_trivially_copyable<LaneBlock>::value, "LaneBlock은 memset으로 초기화한다");
+
+// LaneBacktestEngine 클래스
+// 레인마다 BacktestConfig가 따로 있고 (rollingWindow만 공통), 가격은 [시점][레인] 배열이다.
+// 결과는 레인 순서대로 3개씩 (BacktestEngine::addDefaultStrategies 순서, keepEquityHistory는 무시).
+// 가격은 1 이상이어야 한다 (MarketSimulator 경로와 같은 조건).
+class LaneBacktestEngine
+{
+private:
+    // RiskTracker의 블록/이동 구간 진행 카운터 (모든 레인의 수익률 개수가 같아 시점만으로 정해진다)
+    struct PhaseCounter
+    {
+        uint64_t mergedCount; // 병합된 수익률 개수
+        size_t blockCount;
+        size_t windowPos;
+        size_t windowCount;
+        size_t sinceRebase;
+    };
+
+    // 한 틱 동안 모든 레인에 공통인 RiskTracker 진행 단계
+    struct Phase
+    {
+        bool firstReturn;  // 수익률 블록의 첫 값
+        bool windowOn;     // 이동 변동성 계산 여부
+        bool filling;      // 이동 구간이 아직 안 찼음
+        bool firstWindow;  // 이동 구간의 첫 값
+        bool full;         // 이번 값으로 이동 구간이 꽉 참
+        bool rebase;       // 이번 틱에 이동 구간 합을 다시 계산
+        size_t pos;        // 이동 구간 쓰기 위치
+    };
+
+    vector<BacktestConfig> configs; // 패딩 레인은 0번 레인 설정을 복사
+    size_t laneCount;
+    size_t stride;                  // 패딩 포함 레인 수 (LANE_WIDTH 배수)
+    size_t windowSize;              // 2 미만이면 이동 변동성을 계산하지 않음
+    double invWindow;
+
+    vector<PanicSellStrategy> panics; // 체결 판단과 정수 상태는 레인별 전략 객체가 가진다
+    vector<DCAStrategy> dcas;
+    vector<HoldStrategy> holds;
+
+    vector<LaneBlock> blocks;   // blocks[그룹 * 3 + 전략]
+    vector<double> windows;     // blocks[b]의 이동 구간은 windows[b * windowSize * LANE_WIDTH]부터 [칸][레인]
+    vector<int> priceBuffer;    // [그룹][시점][LANE_WIDTH] (그룹 하나의 가격이 연속이다)
+    size_t priceSteps;
+    vector<StrategyReport> results;
+    size_t fallbackLanes;
+    PhaseCounter finalPhase; // 실행이 끝난 뒤의 카운터 (리포트 계산용)
+
+    RiskTracker scratchRisk; // 블록 병합과 최종 지표 계산은 RiskTracker 코드를 그대로 쓴다
+
+    static void syncTrade(LaneBlock &b, size_t j, const TradingStrategy &s)
+    {
+        b.cash[j] = (double)s.getCash().won;
+        b.shares[j] = s.getShares();
+        b.avgPrice[j] = s.getAvgPrice();
+    }
+
+    void resetState()
+    {
+        for (size_t l = 0; l < stride; ++l)
+        {
+            long cash = configs[l].initialCash;
+            panics[l].reset(cash);
+            dcas[l].reset(cash);
+            holds[l].reset(cash);
+        }
+
+        memset(blocks.data(), 0, blocks.size() * sizeof(LaneBlock));
+        for (size_t g = 0; g < stride / LANE_WIDTH; ++g)
+        {
+            for (size_t s = 0; s < 3; ++s)
+            {
+                LaneBlock &b = blocks[g * 3 + s];
+                for (size_t j = 0; j < LANE_WIDTH; ++j)
+                {
+                    size_t l = g * LANE_WIDTH + j;
+                    b.cash[j] = (double)configs[l].initialCash;
+                    b.lastEquity[j] = (double)configs[l].initialCash;
+                    b.minEquity[j] = (double)configs[l].initialCash;
+                    b.lastBuyIndex[j] = -1.0;
+                    b.downsideTarget[j] = RiskTracker::periodTarget(configs[l].periodsPerYear, configs[l].riskFreeRate);
+                }
+                if (s == 0)
+                {
+                    for (size_t j = 0; j < LANE_WIDTH; ++j)
+                        b.threshold[j] = panics[g * LANE_WIDTH + j].getStopLossRate();
+                }
+                else if (s == 1)
+                {
+                    for (size_t j = 0; j < LANE_WIDTH; ++j)
+                    {
+                        b.threshold[j] = dcas[g * LANE_WIDTH + j].getDropRate();
+                        b.interval[j] = dcas[g * LANE_WIDTH + j].getInterval();
+                    }
+                }
+            }
+        }
+        fill(windows.begin(), windows.end(), 0.0);
+
+        finalPhase = PhaseCounter();
+        results.clear();
+        fallbackLanes = 0;
+    }
+
+    Phase nextPhase(const PhaseCounter &c) const
+    {
+        Phase ph;
+        ph.firstReturn = (c.blockCount == 0);
+        ph.windowOn = (windowSize >= 2);
+        ph.filling = ph.windowOn && c.windowCount < windowSize;
+        ph.firstWindow = ph.windowOn && c.windowCount == 0;
+        ph.full = ph.windowOn && (!ph.filling || c.windowCount + 1 == windowSize);
+        ph.rebase = ph.full && c.sinceRebase + 1 == RiskTracker::REBASE;
+        ph.pos = c.windowPos;
+        return ph;
+    }
+
+    // RiskTracker::addReturn / pushWindow의 틱 끝 단계 진행 (블록이 차면 그룹 g의 블록을 병합)
+    void advancePhase(PhaseCounter &c, const Phase &ph, size_t g)
+    {
+        if (++c.blockCount == RiskTracker::BLOCK)
+            flushGroup(c, g);
+        if (!ph.windowOn)
+            return;
+        if (ph.filling)
+            c.windowCount++;
+        c.windowPos = (c.windowPos + 1 == windowSize) ? 0 : c.windowPos + 1;
+        if (ph.full)
+            c.sinceRebase = ph.rebase ? 0 : c.sinceRebase + 1;
+    }
+
+    // 그룹 g의 수익률 블록을 (count, mean, m2)에 합친다 (64틱마다)
+    void flushGroup(PhaseCounter &c, size_t g)
+    {
+        uint64_t merged = c.mergedCount;
+        for (size_t s = 0; s < 3; ++s)
+        {
+            LaneBlock &b = blocks[g * 3 + s];
+            for (size_t j = 0; j < LANE_WIDTH; ++j)
+            {
+                scratchRisk.count = c.mergedCount;
+                scratchRisk.mean = b.mean[j];
+                scratchRisk.m2 = b.m2[j];
+                scratchRisk.blockCount = c.blockCount;
+                scratchRisk.blockShift = b.blockShift[j];
+                scratchRisk.blockSum = b.blockSum[j];
+                scratchRisk.blockSumSq = b.blockSumSq[j];
+                scratchRisk.flushBlock();
+                b.mean[j] = scratchRisk.mean;
+                b.m2[j] = scratchRisk.m2;
+                b.blockSum[j] = 0.0;
+                b.blockSumSq[j] = 0.0;
+                merged = scratchRisk.count;
+            }
+        }
+        c.mergedCount = merged;
+        c.blockCount = 0;
+    }
+
+    // 쫄보: 첫 매수 또는 손절 조건
+    static OOP_LANE_INLINE long long markPanic(const LaneBlock &b, const double *price, long long *hit)
+    {
+        long long any = 0;
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            // 벡터화를 위해 나눗셈은 항상 하고 조건은 비트 연산으로 합친다 (평단가 0이면 결과는 버려진다)
+            double change = (price[j] - b.avgPrice[j]) / b.avgPrice[j];
+            long long entry = (b.bought[j] == 0.0) & (b.cash[j] >= price[j]);
+            long long stop = (b.shares[j] > 0) & (b.avgPrice[j] > 0) & (change <= b.threshold[j]);
+            hit[j] = entry | stop;
+            any |= hit[j];
+        }
+        return any;
+    }
+
+    // 코치: 첫 매수, 간격 도달, 하락률 도달 중 하나 (현금이 1주 가격 이상일 때)
+    static OOP_LANE_INLINE long long markDca(const LaneBlock &b, const double *price, double idx, long long *hit)
+    {
+        long long any = 0;
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            double change = (price[j] - b.lastBuyPrice[j]) / b.lastBuyPrice[j];
+            long long first = b.lastBuyIndex[j] < 0;
+            long long intervalMet = idx - b.lastBuyIndex[j] >= b.interval[j];
+            long long dropMet = (b.lastBuyPrice[j] > 0) & (change <= b.threshold[j]);
+            hit[j] = (b.cash[j] >= price[j]) & (first | intervalMet | dropMet);
+            any |= hit[j];
+        }
+        return any;
+    }
+
+    // 존버: 첫 매수
+    static OOP_LANE_INLINE long long markHold(const LaneBlock &b, const double *price, long long *hit)
+    {
+        long long any = 0;
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            hit[j] = (b.bought[j] == 0.0) & (b.cash[j] >= price[j]);
+            any |= hit[j];
+        }
+        return any;
+    }
+
+    // DrawdownTracker::track + RiskTracker::track (직전 자산이 모두 양수인 경우)
+    OOP_LANE_INLINE void trackBlock(LaneBlock &b, const double *price, double *__restrict window, const Phase &ph) const
+    {
+        // 블록 첫 수익률이 기준값 (아래 루프와 같은 연산으로 미리 구해 루프 안의 스칼라 조건을 없앤다)
+        if (ph.firstReturn)
+        {
+            for (size_t j = 0; j < LANE_WIDTH; ++j)
+                b.blockShift[j] = (b.cash[j] + b.shares[j] * price[j] - b.lastEquity[j]) / b.lastEquity[j];
+        }
+
+        // 벡터화 조건: 선택지의 연산은 미리 해 두고, 저장은 조건 없이 한 번씩, std::min/max는 쓰지 않는다
+        // (대상 속성이 다른 함수는 인라인되지 않는다)
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            double equity = b.cash[j] + b.shares[j] * price[j];
+
+            double peak = b.peak[j];
+            double trough = b.trough[j];
+            bool up = equity > peak;
+            double dd = (peak - trough) / peak;
+            double drop = ((up & (peak > 0)) != 0) ? dd : 0.0;
+            b.maxDD[j] = (drop > b.maxDD[j]) ? drop : b.maxDD[j];
+            b.peak[j] = up ? equity : peak;
+            b.trough[j] = ((up | (equity < trough)) != 0) ? equity : trough;
+            b.minEquity[j] = (equity < b.minEquity[j]) ? equity : b.minEquity[j];
+
+            double last = b.lastEquity[j];
+            double r = (equity - last) / last;
+            b.lastEquity[j] = equity;
+            double d = r - b.blockShift[j];
+            b.blockSum[j] += d;
+            b.blockSumSq[j] += d * d;
+            double shortfall = r - b.downsideTarget[j];
+            double loss = (shortfall < 0) ? shortfall : 0.0;
+            b.downsideSq[j] += loss * loss;   // 기준 이상이면 0.0을 더하므로 그대로
+
+            bool atPeak = equity >= b.riskPeak[j];
+            double nextUnder = b.underwater[j] + 1.0;
+            double under = atPeak ? 0.0 : nextUnder;
+            b.riskPeak[j] = atPeak ? equity : b.riskPeak[j];
+            b.underwater[j] = under;
+            b.maxUnderwater[j] = (under > b.maxUnderwater[j]) ? under : b.maxUnderwater[j];
+            b.ret[j] = r;
+        }
+        if (!ph.windowOn)
+            return;
+
+        double *slot = window + ph.pos * LANE_WIDTH;
+        if (ph.filling)
+        {
+            if (ph.firstWindow)
+            {
+                for (size_t j = 0; j < LANE_WIDTH; ++j)
+                    b.windowShift[j] = b.ret[j];
+            }
+            for (size_t j = 0; j < LANE_WIDTH; ++j)
+            {
+                double dw = b.ret[j] - b.windowShift[j];
+                b.windowSum[j] += dw;
+                b.windowSumSq[j] += dw * dw;
+                slot[j] = b.ret[j];
+            }
+        }
+        else
+        {
+            for (size_t j = 0; j < LANE_WIDTH; ++j)
+            {
+                double dOld = slot[j] - b.windowShift[j];
+                double dNew = b.ret[j] - b.windowShift[j];
+                b.windowSum[j] += dNew - dOld;
+                b.windowSumSq[j] += dNew * dNew - dOld * dOld;
+                slot[j] = b.ret[j];
+            }
+        }
+        if (!ph.full)
+            return;
+
+        if (ph.rebase)
+        {
+            double sum[LANE_WIDTH] = {};
+            for (size_t k = 0; k < windowSize; ++k)
+            {
+                for (size_t j = 0; j < LANE_WIDTH; ++j)
+                    sum[j] += window[k * LANE_WIDTH + j];
+            }
+            for (size_t j = 0; j < LANE_WIDTH; ++j)
+            {
+                b.windowShift[j] = sum[j] / windowSize;
+                b.windowSum[j] = 0.0;
+                b.windowSumSq[j] = 0.0;
+            }
+            for (size_t k = 0; k < windowSize; ++k)
+            {
+                for (size_t j = 0; j < LANE_WIDTH; ++j)
+                {
+                    double x = window[k * LANE_WIDTH + j];
+                    b.windowSum[j] += x - b.windowShift[j];
+                    b.windowSumSq[j] += (x - b.windowShift[j]) * (x - b.windowShift[j]);
+                }
+            }
+        }
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            double wm2 = b.windowSumSq[j] - b.windowSum[j] * b.windowSum[j] * invWindow;
+            wm2 = (0.0 < wm2) ? wm2 : 0.0;   // max(0.0, wm2)
+            b.maxWindowM2[j] = (wm2 > b.maxWindowM2[j]) ? wm2 : b.maxWindowM2[j];
+        }
+    }
+
+    // 조건에 걸린 레인만 전략 객체로 체결 (가상 호출 없음)
+    void tradePanic(LaneBlock &b, size_t g, size_t t, const int *row, const long long *hit)
+    {
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            if (!hit[j])
+                continue;
+            PanicSellStrategy &s = panics[g * LANE_WIDTH + j];
+            s.trade(t, row[j], s.getFeeSchedule());
+            syncTrade(b, j, s);
+            b.bought[j] = s.getHasBought() ? 1.0 : 0.0;
+        }
+    }
+
+    void tradeDca(LaneBlock &b, size_t g, size_t t, const int *row, const long long *hit)
+    {
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            if (!hit[j])
+                continue;
+            DCAStrategy &s = dcas[g * LANE_WIDTH + j];
+            s.trade(t, row[j], s.getFeeSchedule());
+            syncTrade(b, j, s);
+            b.lastBuyIndex[j] = s.getLastBuyIndex();
+            b.lastBuyPrice[j] = s.getLastBuyPrice();
+        }
+    }
+
+    void tradeHold(LaneBlock &b, size_t g, size_t t, const int *row, const long long *hit)
+    {
+        for (size_t j = 0; j < LANE_WIDTH; ++j)
+        {
+            if (!hit[j])
+                continue;
+            HoldStrategy &s = holds[g * LANE_WIDTH + j];
+            s.trade(t, row[j], s.getFeeSchedule());
+            syncTrade(b, j, s);
+            b.bought[j] = s.getHasBought() ? 1.0 : 0.0;
+        }
+    }
+
+    // 시점 [0, steps) 실행. 레인끼리 독립이라 그룹 하나를 끝까지 돌린 뒤 다음 그룹으로 넘어간다
+    // (그룹 상태가 캐시에 머물고 가격도 순서대로 읽는다). 레인 가격은 prices[priceIndex], 공유 시계열이면 series[t]
+    OOP_LANE_INLINE void runTicks(const int *prices, const int *series, size_t steps)
+    {
+        const size_t groups = stride / LANE_WIDTH;
+        const size_t windowBlock = windowSize * LANE_WIDTH;
+        double price[LANE_WIDTH];
+        long long hit[LANE_WIDTH];
+        int sharedPrices[LANE_WIDTH];
+
+        for (size_t g = 0; g < groups; ++g)
+        {
+            LaneBlock *b = &blocks[g * 3];
+            double *window = windows.data() + g * 3 * windowBlock;
+            PhaseCounter counter = PhaseCounter();
+
+            for (size_t t = 0; t < steps; ++t)
+            {
+                const int *groupRow = prices + (g * steps + t) * LANE_WIDTH;
+                if (series)
+                {
+                    for (size_t j = 0; j < LANE_WIDTH; ++j)
+                        sharedPrices[j] = series[t];
+                    groupRow = sharedPrices;
+                }
+                for (size_t j = 0; j < LANE_WIDTH; ++j)
+                    price[j] = groupRow[j];
+                Phase ph = nextPhase(counter);
+
+                if (markPanic(b[0], price, hit))
+                    tradePanic(b[0], g, t, groupRow, hit);
+                if (markDca(b[1], price, (double)t, hit))
+                    tradeDca(b[1], g, t, groupRow, hit);
+                if (markHold(b[2], price, hit))
+                    tradeHold(b[2], g, t, groupRow, hit);
+
+                trackBlock(b[0], price, window, ph);
+                trackBlock(b[1], price, window + windowBlock, ph);
+                trackBlock(b[2], price, window + 2 * windowBlock, ph);
+                advancePhase(counter, ph, g);
+            }
+            finalPhase = counter;
+        }
+    }
+
+#if OOP_LANE_DISPATCH
+    __attribute__((target("avx2"))) void runTicksAvx2(const int *prices, const int *series, size_t steps)
+    {
+        runTicks(prices, series, steps);
+    }
+
+    __attribute__((target("avx512f,avx512dq"))) void runTicksAvx512(const int *prices, const int *series, size_t steps)
+    {
+        runTicks(prices, series, steps);
+    }
+#endif
+
+    void dispatchTicks(const int *prices, const int *series, size_t steps)
+    {
+#if OOP_LANE_DISPATCH
+        static const int level = __builtin_cpu_supports("avx512dq") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+        if (level == 2)
+            return runTicksAvx512(prices, series, steps);
+        if (level == 1)
+            return runTicksAvx2(prices, series, steps);
+#endif
+        runTicks(prices, series, steps);
+    }
+
+    // 레인 lane, 시점 t 가격의 priceBuffer 위치
+    static size_t priceOffset(size_t lane, size_t t, size_t steps)
+    {
+        return ((lane / LANE_WIDTH) * steps + t) * LANE_WIDTH + lane % LANE_WIDTH;
+    }
+
+    // 레인 l의 스칼라 실행 (자산이 2^53 이상이거나 0 이하가 된 레인)
+    void runLaneScalar(size_t l, const int *prices, const int *series, size_t steps,
+                       StrategyReport *out)
+    {
+        const BacktestConfig &cfg = configs[l];
+        PanicSellStrategy &panic = panics[l];
+        DCAStrategy &dca = dcas[l];
+        HoldStrategy &hold = holds[l];
+        panic.reset(cfg.initialCash);
+        dca.reset(cfg.initialCash);
+        hold.reset(cfg.initialCash);
+        for (size_t t = 0; t < steps; ++t)
+        {
+            int price = series ? series[t] : prices[priceOffset(l, t, steps)];
+            panic.tick(t, price, 0.0, panic.getFeeSchedule());
+            dca.tick(t, price, 0.0, dca.getFeeSchedule());
+            hold.tick(t, price, 0.0, hold.getFeeSchedule());
+        }
+        int lastPrice = series ? series[steps - 1] : prices[priceOffset(l, steps - 1, steps)];
+        out[0] = BacktestEngine::buildReport(&panic, cfg.initialCash, lastPrice, cfg.periodsPerYear, cfg.riskFreeRate);
+        out[1] = BacktestEngine::buildReport(&dca, cfg.initialCash, lastPrice, cfg.periodsPerYear, cfg.riskFreeRate);
+        out[2] = BacktestEngine::buildReport(&hold, cfg.initialCash, lastPrice, cfg.periodsPerYear, cfg.riskFreeRate);
+    }
+
+    // 레인 상태로 리포트 작성 (매매 결과는 전략 객체, MDD/위험 지표는 블록 값으로 채운다)
+    StrategyReport laneReport(const TradingStrategy &s, const LaneBlock &b, size_t j, const BacktestConfig &cfg,
+                              int lastPrice)
+    {
+        DrawdownTracker drawdown;
+        drawdown.peakEquity = (long)b.peak[j];
+        drawdown.troughEquity = (long)b.trough[j];
+        drawdown.maxDD = b.maxDD[j];
+
+        RiskTracker &risk = scratchRisk;
+        risk.startEquity = cfg.initialCash;
+        risk.lastEquity = (long)b.lastEquity[j];
+        risk.count = finalPhase.mergedCount;
+        risk.mean = b.mean[j];
+        risk.m2 = b.m2[j];
+        risk.blockCount = finalPhase.blockCount;
+        risk.blockShift = b.blockShift[j];
+        risk.blockSum = b.blockSum[j];
+        risk.blockSumSq = b.blockSumSq[j];
+        risk.downsideSq = b.downsideSq[j];
+        risk.downsideTarget = b.downsideTarget[j];
+        risk.maxUnderwater = (uint64_t)b.maxUnderwater[j];
+        risk.windowCount = finalPhase.windowCount;
+        risk.windowSum = b.windowSum[j];
+        risk.windowSumSq = b.windowSumSq[j];
+        risk.maxWindowM2 = b.maxWindowM2[j];
+
+        StrategyReport report = BacktestEngine::buildReport(&s, cfg.initialCash, lastPrice,
+                                                            cfg.periodsPerYear, cfg.riskFreeRate);
+        report.maxDrawdown = drawdown.getMaxDrawdown();
+        report.risk = risk.compute(cfg.periodsPerYear, cfg.riskFreeRate, report.maxDrawdown);
+        return report;
+    }
+
+    void finish(const int *prices, const int *series, size_t steps)
+    {
+        results.resize(laneCount * 3);
+        scratchRisk.setWindowSize(windowSize);
+        for (size_t l = 0; l < laneCount; ++l)
+        {
+            size_t g = l / LANE_WIDTH, j = l % LANE_WIDTH;
+            const LaneBlock *b = &blocks[g * 3];
+            bool exact = true;
+            for (size_t s = 0; s < 3; ++s)
+                exact = exact && b[s].minEquity[j] > 0 && b[s].peak[j] < LANE_EXACT_LIMIT;
+            if (!exact)
+            {
+                fallbackLanes++;
+                runLaneScalar(l, prices, series, steps, &results[l * 3]);
+                continue;
+            }
+
+            const BacktestConfig &cfg = configs[l];
+            int lastPrice = series ? series[steps - 1] : prices[priceOffset(l, steps - 1, steps)];
+            results[l * 3] = laneReport(panics[l], b[0], j, cfg, lastPrice);
+            results[l * 3 + 1] = laneReport(dcas[l], b[1], j, cfg, lastPrice);
+            results[l * 3 + 2] = laneReport(holds[l], b[2], j, cfg, lastPrice);
+        }
+    }
+
+    // 스칼라 재계산에 대비해 창 크기만 맞춰 둔다 (버퍼는 처음 한 번만 할당)
+    void prepareScalarWindows()
+    {
+        for (size_t l = 0; l < stride; ++l)
+        {
+            panics[l].setRiskWindow(configs[l].rollingWindow);
+            dcas[l].setRiskWindow(configs[l].rollingWindow);
+            holds[l].setRiskWindow(configs[l].rollingWindow);
+            panics[l].setRiskTarget(configs[l].periodsPerYear, configs[l].riskFreeRate);
+            dcas[l].setRiskTarget(configs[l].periodsPerYear, configs[l].riskFreeRate);
+            holds[l].setRiskTarget(configs[l].periodsPerYear, configs[l].riskFreeRate);
+        }
+    }
+
+    void runAll(const int *prices, const int *series, size_t steps)
+    {
+        OOP_PROFILE_SCOPE(ZONE_RUN_BATTLE);
+        resetState();
+        if (steps == 0)
+            return;
+        dispatchTicks(prices, series, steps);
+        finish(prices, series, steps);
+    }
+
+public:
+    LaneBacktestEngine() : laneCount(0), stride(0), windowSize(0), invWindow(0.0), priceSteps(0), fallbackLanes(0),
+                           finalPhase(), scratchRisk(0) {}
+
+    // 레인 설정 (레인 수 = configs.size()), rollingWindow가 서로 다르면 false
+    bool setLanes(const vector<BacktestConfig> &laneConfigs)
+    {
+        if (laneConfigs.empty())
+            return false;
+        for (const BacktestConfig &cfg : laneConfigs)
+        {
+            if (cfg.rollingWindow != laneConfigs[0].rollingWindow)
+                return false;
+        }
+
+        laneCount = laneConfigs.size();
+        stride = (laneCount + LANE_WIDTH - 1) / LANE_WIDTH * LANE_WIDTH;
+        configs = laneConfigs;
+        configs.resize(stride, laneConfigs[0]);
+        windowSize = laneConfigs[0].rollingWindow < 2 ? 0 : laneConfigs[0].rollingWindow;
+        invWindow = windowSize ? 1.0 / windowSize : 0.0;
+
+        panics.clear();
+        dcas.clear();
+        holds.clear();
+        panics.reserve(stride);
+        dcas.reserve(stride);
+        holds.reserve(stride);
+        for (const BacktestConfig &cfg : configs)
+        {
+            panics.emplace_back(cfg.initialCash, cfg.panicThreshold, cfg.feeRate);
+            dcas.emplace_back(cfg.initialCash, cfg.dcaDropRate, cfg.dcaInterval, cfg.dcaBuyRatio, cfg.feeRate);
+            holds.emplace_back(cfg.initialCash, cfg.holdBuyRatio, cfg.feeRate);
+        }
+        // 전략 객체는 체결만 하므로 자산 곡선과 이동 구간 버퍼가 필요 없다 (스칼라 재계산 때만 창을 쓴다)
+        for (size_t l = 0; l < stride; ++l)
+        {
+            panics[l].setKeepHistory(false);
+            dcas[l].setKeepHistory(false);
+            holds[l].setKeepHistory(false);
+        }
+
+        blocks.assign(stride / LANE_WIDTH * 3, LaneBlock());
+        windows.assign(blocks.size() * windowSize * LANE_WIDTH, 0.0);
+        results.clear();
+        return true;
+    }
+
+    // 레인별 가격 버퍼를 steps 길이로 준비 (setLanePath나 priceIndex 위치에 채운다)
+    int *preparePrices(size_t steps)
+    {
+        priceSteps = steps;
+        priceBuffer.resize(steps * stride);
+        return priceBuffer.data();
+    }
+
+    // preparePrices 버퍼에서 레인 lane, 시점 t 가격의 위치
+    size_t priceIndex(size_t lane, size_t t) const { return priceOffset(lane, t, priceSteps); }
+
+    // 레인 lane의 가격 path[0..steps)를 버퍼에 복사
+    void setLanePath(size_t lane, const int *path)
+    {
+        int *out = &priceBuffer[priceOffset(lane, 0, priceSteps)];
+        for (size_t t = 0; t < priceSteps; ++t)
+            out[t * LANE_WIDTH] = path[t];
+    }
+
+    // preparePrices로 채운 가격으로 실행 (패딩 레인은 0번 레인 가격을 쓴다)
+    void run()
+    {
+        if (laneCount == 0 || priceBuffer.size() < priceSteps * stride)
+            return;
+        for (size_t l = laneCount; l < stride; ++l)
+        {
+            int *out = &priceBuffer[priceOffset(l, 0, priceSteps)];
+            for (size_t t = 0; t < priceSteps; ++t)
+                out[t * LANE_WIDTH] = priceBuffer[priceOffset(0, t, priceSteps)];
+        }
+        prepareScalarWindows();
+        runAll(priceBuffer.data(), nullptr, priceSteps);
+    }
+
+    // 모든 레인이 같은 시계열 series[0..len)을 쓴다 (파라미터 조합 스윕)
+    void runShared(const int *series, size_t len)
+    {
+        if (laneCount == 0)
+            return;
+        prepareScalarWindows();
+        runAll(nullptr, series, len);
+    }
+
+    const vector<StrategyReport> &getResults() const { return results; }
+    size_t getLaneCount() const { return laneCount; }
+    size_t getLaneStride() const { return stride; }
+    size_t getFallbackCount() const { return fallbackLanes; }
+};
+
+#if OOP_LANE_DISPATCH
+#pragma GCC pop_options
+#endif
+
+// == 5-5. 성능 벤치마크 ==
+
+// BenchmarkSuite 클래스
+// 핵심 경로의 처리량/지연을 측정해 한 줄에 하나씩 JSON으로 출력한다.
+class BenchmarkSuite
+{
+private:
+    typedef chrono::steady_clock Clock;
+
+    ostream &out;
+    size_t maxPoints;
+    uint64_t rngState;
+
+    uint64_t nextRandom()
+    {
+        // xorshift64 - 입력 데이터 생성용
+        rngState ^= rngState << 13;
+        rngState ^= rngState >> 7;
+        rngState ^= rngState << 17;
+        return rngState;
+    }
+
+    static double secondsSince(Clock::time_point start)
+    {
+        return chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // -3% ~ +3% 랜덤워크 가격
+    vector<int> makeHistory(size_t len)
+    {
+        vector<int> prices(len);
+        int price = 70000;
+        for (size_t i = 0; i < len; ++i)
+        {
+            double rate = ((int)(nextRandom() % 601) - 300) / 10000.0;
+            price = max(1, (int)(price * (1 + rate)));
+            prices[i] = price;
+        }
+        return prices;
+    }
+
+    void benchRunBattle(size_t len, bool keepHistory)
+    {
+        Stock stock("BENCH", "벤치마크", 70000);
+        stock.setPriceHistory(makeHistory(len));
+
+        BacktestConfig config;
+        config.keepEquityHistory = keepHistory;
+
+        // 짧은 이력은 여러 번 돌려 측정 오차를 줄인다
+        size_t iterations = max<size_t>(1, 10000000 / len);
+        size_t strategyCount = 0;
+        size_t bytesPerStrategy = 0;
+
+        Clock::time_point start = Clock::now();
+        for (size_t it = 0; it < iterations; ++it)
+        {
+            BacktestEngine engine(&stock, config);
+            engine.addDefaultStrategies();
+            engine.runBattle();
+
+            if (it == 0)
+            {
+                strategyCount = engine.getStrategies().size();
+                for (const TradingStrategy *s : engine.getStrategies())
+                    bytesPerStrategy += sizeof(*s) + s->getEquityHistory().capacity() * sizeof(long);
+                bytesPerStrategy /= max<size_t>(1, strategyCount);
+            }
+        }
+        double elapsed = secondsSince(start);
+        double work = (double)len * strategyCount * iterations;
+
+        out << "{\"bench\":\"run_battle\",\"points\":" << len
+            << ",\"strategies\":" << strategyCount
+            << ",\"keep_history\":" << (keepHistory ? "true" : "false")
+            << ",\"iterations\":" << iterations
+            << ",\"seconds\":" << elapsed
+            << ",\"ticks_x_strategies_per_sec\":" << (elapsed > 0 ? work / elapsed : 0.0)
+            << ",\"bytes_per_strategy\":" << bytesPerStrategy << "}" << endl;
+    }
+
+    static long long percentile(const vector<long long> &sorted, double q)
+    {
+        if (sorted.empty())
+            return 0;
+        size_t idx = (size_t)(q * (sorted.size() - 1));
+        return sorted[idx];
+    }
+
+    void benchExecuteOrder(size_t orderCount)
+    {
+        Market market;
+        Stock *stock = new Stock("005930", "삼성전자", 70000);
+        market.addStock(stock);
+        Account account("BENCH", 1000000000000L);
+
+        vector<int> orderIds;
+        orderIds.reserve(orderCount);
+        for (size_t i = 0; i < orderCount; ++i)
+        {
+            Order order(stock->getSymbolId(), (i % 2 == 0) ? BUY : SELL, MARKET, 0, 10);
+            account.placeOrder(order);
+            orderIds.push_back(order.getOrderId());
+        }
+
+        vector<long long> latencies(orderCount);
+        for (size_t i = 0; i < orderCount; ++i)
+        {
+            Clock::time_point start = Clock::now();
+            account.executeOrder(orderIds[i], market);
+            latencies[i] = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+        }
+        sort(latencies.begin(), latencies.end());
+
+        out << "{\"bench\":\"execute_order\",\"orders\":" << orderCount
+            << ",\"p50_ns\":" << percentile(latencies, 0.50)
+            << ",\"p90_ns\":" << percentile(latencies, 0.90)
+            << ",\"p99_ns\":" << percentile(latencies, 0.99)
+            << ",\"p999_ns\":" << percentile(latencies, 0.999)
+            << ",\"max_ns\":" << (latencies.empty() ? 0 : latencies.back()) << "}" << endl;
+    }
+
+    // 리밸런싱처럼 여러 종목 주문을 한 번에 넣는 경우: 건별 executeOrder vs executeOrders
+    void benchExecuteOrders(size_t symbolCount, size_t ordersPerBatch, size_t batches)
+    {
+        Market market;
+        for (size_t i = 0; i < symbolCount; ++i)
+            market.emplaceStock(to_string(100000 + i), "BENCH", 50000);
+
+        // 나중에 도는 쪽은 먼저 돈 계좌가 반납한 힙을 다시 쓰므로 건별-묶음-묶음-건별 순으로 두 번씩 잰다
+        double seconds[2] = {0.0, 0.0};
+        for (int round = 0; round < 4; ++round)
+        {
+            int batched = (round == 1 || round == 2) ? 1 : 0;
+            Account account("BENCH", 1000000000000L);
+            vector<int> orderIds(ordersPerBatch);
+            for (size_t b = 0; b < batches; ++b)
+            {
+                for (size_t i = 0; i < ordersPerBatch; ++i)
+                {
+                    // 짝수 batch는 매수, 홀수 batch는 같은 수량 매도
+                    // 새 Market이라 symbolId == 추가 순서
+                    Order order((int)(i % symbolCount), (b % 2 == 0) ? BUY : SELL, MARKET, 0, 10);
+                    account.placeOrder(order);
+                    orderIds[i] = order.getOrderId();
+                }
+
+                Clock::time_point start = Clock::now();
+                if (batched)
+                    account.executeOrders(orderIds, market);
+                else
+                    for (int id : orderIds)
+                        account.executeOrder(id, market);
+                seconds[batched] += secondsSince(start);
+            }
+        }
+
+        double orders = 2.0 * ordersPerBatch * batches;
+        out << "{\"bench\":\"execute_orders_batch\",\"symbols\":" << symbolCount
+            << ",\"orders_per_batch\":" << ordersPerBatch
+            << ",\"batches\":" << batches
+            << ",\"single_orders_per_sec\":" << (seconds[0] > 0 ? orders / seconds[0] : 0.0)
+            << ",\"batch_orders_per_sec\":" << (seconds[1] > 0 ? orders / seconds[1] : 0.0) << "}" << endl;
+    }
+
+    // 시세 변경 후 레지스트리 전 계좌 재평가 + 요약 (샤드 수별)
+    void benchAccountRegistry(size_t userCount, size_t symbolCount, size_t steps, size_t shardCount)
+    {
+        Market market;
+        for (size_t i = 0; i < symbolCount; ++i)
+            market.emplaceStock(to_string(100000 + i), "BENCH", 50000);
+
+        AccountRegistry registry(market, shardCount);
+        for (size_t u = 0; u < userCount; ++u)
+            registry.addUser("user" + to_string(u), "", "", Money(1000000000));
+        registry.forEachUser([&](User &user)
+                             {
+            Account *account = user.getAccount();
+            for (size_t i = 0; i < symbolCount; i += 3)
+            {
+                Order order((int)i, BUY, MARKET, 0, 1);
+                account->placeOrder(order);
+                account->executeOrder(order.getOrderId(), market);
+            } });
+
+        Clock::time_point start = Clock::now();
+        size_t rows = 0;
+        for (size_t step = 0; step < steps; ++step)
+        {
+            market.simulatePriceChange();
+            rows += registry.collectSummaries().size();
+        }
+        double elapsed = secondsSince(start);
+
+        out << "{\"bench\":\"account_registry\",\"users\":" << userCount
+            << ",\"symbols\":" << symbolCount
+            << ",\"shards\":" << registry.getShardCount()
+            << ",\"steps\":" << steps
+            << ",\"seconds\":" << elapsed
+            << ",\"account_marks_per_sec\":" << (elapsed > 0 ? rows / elapsed : 0.0) << "}" << endl;
+    }
+
+    // 같은 경로 묶음을 경로마다 runBattle로 돌린 경우와 LaneBacktestEngine으로 한 번에 돌린 경우 비교
+    // (몬테카를로 워커와 같은 준비 과정 포함, 두 결과가 같은지도 함께 출력)
+    void benchLaneEngine(size_t pathCount, size_t steps)
+    {
+        BacktestConfig config;
+        config.keepEquityHistory = false;
+        vector<vector<int>> paths(pathCount);
+        for (vector<int> &path : paths)
+            path = makeHistory(steps);
+        size_t iterations = max<size_t>(1, 10000000 / (pathCount * steps));
+
+        Stock stock("BENCH", "벤치마크", 70000);
+        Arena arena;
+        BacktestEngine engine(&stock, config, &arena);
+        engine.addDefaultStrategies();
+        vector<StrategyReport> scalarReports;
+
+        Clock::time_point start = Clock::now();
+        for (size_t it = 0; it < iterations; ++it)
+        {
+            for (const vector<int> &path : paths)
+            {
+                int *prices = stock.prepareHistory(steps);
+                memcpy(prices, path.data(), steps * sizeof(int));
+                engine.reset();
+                engine.runBattle();
+                if (it == 0)
+                    scalarReports.insert(scalarReports.end(), engine.getResults().begin(), engine.getResults().end());
+            }
+        }
+        double scalarSeconds = secondsSince(start);
+
+        LaneBacktestEngine lanes;
+        lanes.setLanes(vector<BacktestConfig>(pathCount, config));
+        start = Clock::now();
+        for (size_t it = 0; it < iterations; ++it)
+        {
+            lanes.preparePrices(steps);
+            for (size_t l = 0; l < pathCount; ++l)
+                lanes.setLanePath(l, paths[l].data());
+            lanes.run();
+        }
+        double laneSeconds = secondsSince(start);
+
+        const vector<StrategyReport> &laneReports = lanes.getResults();
+        bool identical = laneReports.size() == scalarReports.size();
+        for (size_t i = 0; identical && i < laneReports.size(); ++i)
+        {
+            identical = laneReports[i].finalEquity == scalarReports[i].finalEquity &&
+                        laneReports[i].totalReturn == scalarReports[i].totalReturn &&
+                        laneReports[i].maxDrawdown == scalarReports[i].maxDrawdown &&
+                        laneReports[i].risk.sharpeRatio == scalarReports[i].risk.sharpeRatio;
+        }
+
+        double work = (double)pathCount * steps * 3 * iterations;
+        out << "{\"bench\":\"lane_engine\",\"paths\":" << pathCount
+            << ",\"steps\":" << steps
+            << ",\"iterations\":" << iterations
+            << ",\"scalar_seconds\":" << scalarSeconds
+            << ",\"lane_seconds\":" << laneSeconds
+            << ",\"lane_ticks_x_strategies_per_sec\":" << (laneSeconds > 0 ? work / laneSeconds : 0.0)
+            << ",\"speedup\":" << (laneSeconds > 0 ? scalarSeconds / laneSeconds : 0.0)
+            << ",\"fallback_lanes\":" << lanes.getFallbackCount()
+            << ",\"identical\":" << (identical ? "true" : "false") << "}" << endl;
+    }
+
+    void benchSimulatePriceChange(size_t symbolCount, size_t steps)
+    {
+        Market market;
+        for (size_t i = 0; i < symbolCount; ++i)
+            market.addStock(new Stock(to_string(100000 + i), "BENCH", 50000));
+
+        Clock::time_point start = Clock::now();
+        for (size_t step = 0; step < steps; ++step)
+            market.simulatePriceChange();
+        double elapsed = secondsSince(start);
+        double updates = (double)symbolCount * steps;
+
+        out << "{\"bench\":\"simulate_price_change\",\"symbols\":" << symbolCount
+            << ",\"steps\":" << steps
+            << ",\"seconds\":" << elapsed
+            << ",\"symbol_updates_per_sec\":" << (elapsed > 0 ? updates / elapsed : 0.0) << "}" << endl;
+    }
+
+public:
+    BenchmarkSuite(ostream &o, size_t maxLen = 100000000)
+        : out(o), maxPoints(maxLen), rngState(0x9E3779B97F4A7C15ULL) {}
+
+    void runAll()
+    {
+        out << setprecision(6);
+        for (size_t len = 1000; len <= maxPoints; len *= 10)
+        {
+            benchRunBattle(len, false);
+            benchRunBattle(len, true);
+        }
+
+        benchExecuteOrder(100000);
+        benchExecuteOrders(500, 500, 200);
+        benchExecuteOrders(10, 500, 200);
+
+        benchAccountRegistry(10000, 300, 20, 1);
+        benchAccountRegistry(10000, 300, 20, 0);
+
+        benchSimulatePriceChange(100, 10000);
+        benchSimulatePriceChange(10000, 100);
+
+        benchLaneEngine(64, 250);
+        benchLaneEngine(1024, 250);
+    }
+};
+
+// == 5-6. 몬테카를로 스트레스 테스트 ==
+
+// Histogram 구조체 (고정 구간 히스토그램, 스레드별로 모은 뒤 합친다)
+struct Histogram
+{
+    double lower;
+    double upper;
+    double binWidth;
+    vector<uint64_t> bins;
+    uint64_t underflow;
+    uint64_t overflow;
+    uint64_t count;
+    double sum;
+    double minValue;
+    double maxValue;
+
+    Histogram(double lo = 0.0, double hi = 1.0, size_t binCount = 1)
+        : lower(lo), upper(hi), binWidth((hi - lo) / binCount), bins(binCount, 0),
+          underflow(0), overflow(0), count(0), sum(0.0), minValue(0.0), maxValue(0.0) {}
+
+    void add(double value)
+    {
+        if (count == 0 || value < minValue)
+            minValue = value;
+        if (count == 0 || value > maxValue)
+            maxValue = value;
+        count++;
+        sum += value;
+
+        if (value < lower)
+            underflow++;
+        else if (value >= upper)
+            overflow++;
+        else
+            bins[min(bins.size() - 1, (size_t)((value - lower) / binWidth))]++;
+    }
+
+    // 구간 설정이 같은 히스토그램끼리만 합칠 수 있다
+    void merge(const Histogram &other)
+    {
+        if (other.count == 0)
+            return;
+        if (count == 0 || other.minValue < minValue)
+            minValue = other.minValue;
+        if (count == 0 || other.maxValue > maxValue)
+            maxValue = other.maxValue;
+        count += other.count;
+        sum += other.sum;
+        underflow += other.underflow;
+        overflow += other.overflow;
+        for (size_t i = 0; i < bins.size(); ++i)
+            bins[i] += other.bins[i];
+    }
+
+    double mean() const { return count ? sum / count : 0.0; }
+
+    void save(SnapshotWriter &w) const
+    {
+        w.pod(lower);
+        w.pod(upper);
+        w.pod(binWidth);
+        w.podVector(bins);
+        w.pod(underflow);
+        w.pod(overflow);
+        w.pod(count);
+        w.pod(sum);
+        w.pod(minValue);
+        w.pod(maxValue);
+    }
+
+    bool restore(SnapshotReader &r)
+    {
+        r.pod(lower);
+        r.pod(upper);
+        r.pod(binWidth);
+        r.podVector(bins);
+        r.pod(underflow);
+        r.pod(overflow);
+        r.pod(count);
+        r.pod(sum);
+        r.pod(minValue);
+        r.pod(maxValue);
+        return r.ok() && !bins.empty();
+    }
+
+    // 구간 안에서는 선형 보간, 범위 밖 값은 관측 최소/최대로 근사
+    double quantile(double q) const
+    {
+        if (count == 0)
+            return 0.0;
+        double target = q * count;
+        double seen = (double)underflow;
+        if (target < seen)
+            return minValue;
+
+        for (size_t i = 0; i < bins.size(); ++i)
+        {
+            if (bins[i] > 0 && seen + bins[i] >= target)
+            {
+                double frac = (target - seen) / bins[i];
+                return lower + (i + frac) * binWidth;
+            }
+            seen += bins[i];
+        }
+        return maxValue;
+    }
+};
+
+// MonteCarloConfig 구조체
+struct MonteCarloConfig
+{
+    size_t pathCount;    // 시뮬레이션 경로 수
+    size_t steps;        // 경로당 가격 개수
+    int startPrice;      // 시작 가격
+    uint64_t seed;       // 같은 seed면 같은 경로
+    unsigned int threads; // 0이면 하드웨어 코어 수
+    bool laneEngine;      // 경로 묶음을 LaneBacktestEngine으로 (결과는 runBattle과 같다)
+
+    MonteCarloConfig()
+        : pathCount(10000), steps(250), startPrice(70000), seed(1), threads(0), laneEngine(true) {}
+};
+
+// MonteCarloSummary 구조체 (전략별 분포와 전략 간 승률)
+struct MonteCarloSummary
+{
+    vector<string> strategyNames;
+    vector<Histogram> returns;       // 총 수익률 (%)
+    vector<Histogram> drawdowns;     // MDD (%)
+    vector<vector<uint64_t>> wins;   // wins[i][j]: i의 수익률이 j보다 높았던 경로 수
+    uint64_t pathCount;
+
+    MonteCarloSummary() : pathCount(0) {}
+
+    void init(const vector<StrategyReport> &first)
+    {
+        size_t n = first.size();
+        strategyNames.clear();
+        for (const auto &r : first)
+            strategyNames.push_back(r.strategyName);
+        returns.assign(n, Histogram(-100.0, 400.0, 10000));
+        drawdowns.assign(n, Histogram(0.0, 100.0, 10000));
+        wins.assign(n, vector<uint64_t>(n, 0));
+        pathCount = 0;
+    }
+
+    void add(const vector<StrategyReport> &reports)
+    {
+        if (strategyNames.empty())
+            init(reports);
+        for (size_t i = 0; i < reports.size(); ++i)
+        {
+            returns[i].add(reports[i].totalReturn);
+            drawdowns[i].add(reports[i].maxDrawdown);
+            for (size_t j = 0; j < reports.size(); ++j)
+            {
+                if (reports[i].totalReturn > reports[j].totalReturn)
+                    wins[i][j]++;
+            }
+        }
+        pathCount++;
+    }
+
+    void merge(const MonteCarloSummary &other)
+    {
+        if (other.pathCount == 0)
+            return;
+        if (pathCount == 0)
+        {
+            *this = other;
+            return;
+        }
+        for (size_t i = 0; i < returns.size(); ++i)
+        {
+            returns[i].merge(other.returns[i]);
+            drawdowns[i].merge(other.drawdowns[i]);
+            for (size_t j = 0; j < wins[i].size(); ++j)
+                wins[i][j] += other.wins[i][j];
+        }
+        pathCount += other.pathCount;
+    }
+
+    double winRate(size_t i, size_t j) const
+    {
+        return pathCount ? (double)wins[i][j] / pathCount * 100.0 : 0.0;
+    }
+
+    void save(SnapshotWriter &w) const
+    {
+        w.pod(pathCount);
+        w.pod((uint64_t)strategyNames.size());
+        for (size_t i = 0; i < strategyNames.size(); ++i)
+        {
+            w.text(strategyNames[i]);
+            returns[i].save(w);
+            drawdowns[i].save(w);
+            w.podVector(wins[i]);
+        }
+    }
+
+    bool restore(SnapshotReader &r)
+    {
+        uint64_t n = 0;
+        if (!r.pod(pathCount) || !r.pod(n) || n > 1024)
+            return false;
+        strategyNames.assign((size_t)n, string());
+        returns.assign((size_t)n, Histogram());
+        drawdowns.assign((size_t)n, Histogram());
+        wins.assign((size_t)n, vector<uint64_t>());
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (!r.text(strategyNames[i]) || !returns[i].restore(r) || !drawdowns[i].restore(r) ||
+                !r.podVector(wins[i]) || wins[i].size() != n)
+                return false;
+        }
+        return r.ok();
+    }
+
+    void print() const
+    {
+        cout << "\n=== 몬테카를로 스트레스 테스트 결과 (" << pathCount << "개 경로) ===" << endl;
+        cout << fixed << setprecision(2);
+        for (size_t i = 0; i < strategyNames.size(); ++i)
+        {
+            cout << "[" << strategyNames[i] << "]" << endl;
+            cout << "수익률 평균: " << returns[i].mean() << "% | 5%: " << returns[i].quantile(0.05)
+                 << "% | 중앙값: " << returns[i].quantile(0.5) << "% | 95%: " << returns[i].quantile(0.95) << "%" << endl;
+            cout << "MDD 중앙값: " << drawdowns[i].quantile(0.5) << "% | 95%: " << drawdowns[i].quantile(0.95) << "%" << endl;
+        }
+        for (size_t i = 0; i < strategyNames.size(); ++i)
+        {
+            for (size_t j = i + 1; j < strategyNames.size(); ++j)
+            {
+                cout << strategyNames[i] << " vs " << strategyNames[j] << ": "
+                     << winRate(i, j) << "% 승 / " << winRate(j, i) << "% 패" << endl;
+            }
+        }
+    }
+};
+
+// MonteCarloStressTest 클래스
+// 경로마다 MarketSimulator로 가격을 만들고 기본 3개 전략을 돌려 분포만 집계한다.
+// 워커마다 Stock/엔진/전략을 한 번만 만들고 경로 사이에는 reset으로 재사용한다.
+// laneEngine이면 PATH_CHUNK개 경로를 레인으로 묶어 한 번에 돌린다 (경로 순서대로 집계).
+// 평균용 합계는 PATH_CHUNK 구간마다 따로 더한 뒤 구간 순서로 합치므로 스레드 수와 관계없이 같다.
+class MonteCarloStressTest
+{
+private:
+    BacktestConfig config;
+    MonteCarloConfig mcConfig;
+
+    static const size_t PATH_CHUNK = 64;
+    static const size_t STRATEGY_COUNT = 3; // addDefaultStrategies의 전략 수
+
+    // 구간 하나의 경로 순서 합계 (sums: 수익률 합 STRATEGY_COUNT개, MDD 합 STRATEGY_COUNT개)
+    static void addChunkSums(const StrategyReport *reports, double *sums)
+    {
+        for (size_t i = 0; i < STRATEGY_COUNT; ++i)
+        {
+            sums[i] += reports[i].totalReturn;
+            sums[STRATEGY_COUNT + i] += reports[i].maxDrawdown;
+        }
+    }
+
+    // 경로 [nextPath, endPath)를 워커들이 나눠 가진다 (firstPath부터 PATH_CHUNK 단위 구간)
+    void runWorker(atomic<size_t> &nextPath, size_t firstPath, size_t endPath,
+                   vector<double> &chunkSums, MonteCarloSummary &out) const
+    {
+        MarketSimulator sim(mcConfig.seed);
+        Stock stock("MC", "몬테카를로", mcConfig.startPrice);
+
+        BacktestConfig cfg = config;
+        cfg.keepEquityHistory = false;
+        Arena arena; // 전략 객체를 연속으로 배치 (engine보다 먼저 선언)
+        BacktestEngine engine(&stock, cfg, &arena);
+        engine.addDefaultStrategies();
+
+        LaneBacktestEngine lanes;
+        vector<int> lanePath(mcConfig.laneEngine ? mcConfig.steps : 0);
+        vector<StrategyReport> laneReports;
+
+        while (true)
+        {
+            size_t begin = nextPath.fetch_add(PATH_CHUNK);
+            if (begin >= endPath)
+                break;
+            size_t end = min(begin + PATH_CHUNK, endPath);
+            double *sums = &chunkSums[(begin - firstPath) / PATH_CHUNK * 2 * STRATEGY_COUNT];
+
+            if (mcConfig.laneEngine)
+            {
+                if (lanes.getLaneCount() != end - begin)
+                    lanes.setLanes(vector<BacktestConfig>(end - begin, cfg));
+                lanes.preparePrices(mcConfig.steps);
+                lanePath[0] = mcConfig.startPrice;
+                for (size_t path = begin; path < end; ++path)
+                {
+                    sim.generatePath(path, 0, mcConfig.startPrice, mcConfig.steps - 1, lanePath.data() + 1);
+                    lanes.setLanePath(path - begin, lanePath.data());
+                }
+                lanes.run();
+
+                const vector<StrategyReport> &results = lanes.getResults();
+                for (size_t l = 0; l < end - begin; ++l)
+                {
+                    laneReports.assign(results.begin() + l * STRATEGY_COUNT,
+                                       results.begin() + (l + 1) * STRATEGY_COUNT);
+                    out.add(laneReports);
+                    addChunkSums(laneReports.data(), sums);
+                }
+                continue;
+            }
+
+            for (size_t path = begin; path < end; ++path)
+            {
+                // 첫 가격은 시작가, 이후 steps - 1번 변동
+                int *prices = stock.prepareHistory(mcConfig.steps);
+                prices[0] = mcConfig.startPrice;
+                sim.generatePath(path, 0, mcConfig.startPrice, mcConfig.steps - 1, prices + 1);
+
+                engine.reset();
+                engine.runBattle();
+                out.add(engine.getResults());
+                addChunkSums(engine.getResults().data(), sums);
+            }
+        }
+    }
+
+    // 경로 [begin, end)를 돌려 summary에 합친다
+    void runPaths(size_t begin, size_t end, MonteCarloSummary &summary) const
+    {
+        unsigned int workers = mcConfig.threads;
+        if (workers == 0)
+            workers = thread::hardware_concurrency();
+        if (workers == 0)
+            workers = 1;
+        size_t maxWorkers = (end - begin + PATH_CHUNK - 1) / PATH_CHUNK;
+        if (workers > maxWorkers)
+            workers = (unsigned int)maxWorkers;
+
+        atomic<size_t> nextPath(begin);
+        vector<double> chunkSums(maxWorkers * 2 * STRATEGY_COUNT, 0.0);
+        vector<MonteCarloSummary> partials(workers);
+        vector<thread> pool;
+        for (unsigned int t = 1; t < workers; ++t)
+        {
+            pool.emplace_back(&MonteCarloStressTest::runWorker, this, ref(nextPath), begin, end,
+                              ref(chunkSums), ref(partials[t]));
+        }
+        runWorker(nextPath, begin, end, chunkSums, partials[0]);
+
+        for (thread &th : pool)
+            th.join();
+
+        // 합계는 워커가 어떤 구간을 가져갔는지에 따라 더하는 순서가 달라지므로 구간 순서로 다시 더한다
+        vector<double> totals(2 * STRATEGY_COUNT, 0.0);
+        for (size_t i = 0; i < STRATEGY_COUNT && summary.pathCount > 0; ++i)
+        {
+            totals[i] = summary.returns[i].sum;
+            totals[STRATEGY_COUNT + i] = summary.drawdowns[i].sum;
+        }
+        for (const auto &partial : partials)
+            summary.merge(partial);
+        if (summary.pathCount == 0)
+            return;
+        for (size_t c = 0; c < maxWorkers; ++c)
+        {
+            for (size_t k = 0; k < 2 * STRATEGY_COUNT; ++k)
+                totals[k] += chunkSums[c * 2 * STRATEGY_COUNT + k];
+        }
+        for (size_t i = 0; i < STRATEGY_COUNT; ++i)
+        {
+            summary.returns[i].sum = totals[i];
+            summary.drawdowns[i].sum = totals[STRATEGY_COUNT + i];
+        }
+    }
+
+    // 경로 설정이 같아야 이어서 돌릴 수 있다 (전략 설정은 호출하는 쪽이 같게 맞춘다)
+    void saveState(SnapshotWriter &w, const MonteCarloSummary &summary, size_t nextPath) const
+    {
+        w.header(SNAPSHOT_MONTE_CARLO);
+        w.pod((uint64_t)mcConfig.pathCount);
+        w.pod((uint64_t)mcConfig.steps);
+        w.pod(mcConfig.startPrice);
+        w.pod(mcConfig.seed);
+        w.pod((uint64_t)nextPath);
+        summary.save(w);
+    }
+
+    bool restoreState(SnapshotReader &r, MonteCarloSummary &summary, size_t &nextPath) const
+    {
+        uint64_t paths = 0, steps = 0, next = 0, seed = 0;
+        int startPrice = 0;
+        if (!r.header(SNAPSHOT_MONTE_CARLO) || !r.pod(paths) || !r.pod(steps) || !r.pod(startPrice) ||
+            !r.pod(seed) || !r.pod(next))
+            return false;
+        if (paths != mcConfig.pathCount || steps != mcConfig.steps || startPrice != mcConfig.startPrice ||
+            seed != mcConfig.seed || next > paths)
+            return false;
+        if (!summary.restore(r) || summary.pathCount != next || !r.atEnd())
+            return false;
+        nextPath = (size_t)next;
+        return true;
+    }
+
+public:
+    MonteCarloStressTest(const BacktestConfig &cfg, const MonteCarloConfig &mc)
+        : config(cfg), mcConfig(mc) {}
+
+    MonteCarloSummary run() const
+    {
+        MonteCarloSummary summary;
+        if (mcConfig.pathCount == 0 || mcConfig.steps == 0)
+            return summary;
+        runPaths(0, mcConfig.pathCount, summary);
+        return summary;
+    }
+
+    // interval개 경로마다 지금까지의 집계를 writer로 넘기며 실행 (경로는 난수 stream이 고정이라
+    // 어디서 끊어도 같은 경로가 이어진다). resume이 있으면 그 스냅샷 다음 경로부터 실행하고,
+    // 설정이 맞지 않으면 ok = false와 빈 결과를 돌려준다.
+    // interval이 PATH_CHUNK의 배수면 결과가 run()과 비트 단위로 같고, 아니면 구간 경계가 달라져
+    // 평균만 합산 순서 차이로 마지막 자리가 다를 수 있다 (분포/승률은 항상 같다).
+    MonteCarloSummary run(CheckpointWriter *writer, size_t interval,
+                          const vector<char> *resume = nullptr, bool *ok = nullptr) const
+    {
+        MonteCarloSummary summary;
+        size_t next = 0;
+        if (ok)
+            *ok = true;
+        if (resume)
+        {
+            SnapshotReader reader(*resume);
+            if (!restoreState(reader, summary, next))
+            {
+                if (ok)
+                    *ok = false;
+                return MonteCarloSummary();
+            }
+        }
+        if (mcConfig.steps == 0)
+            return summary;
+
+        SnapshotWriter snapshot;
+        while (next < mcConfig.pathCount)
+        {
+            size_t end = (interval == 0) ? mcConfig.pathCount : min(mcConfig.pathCount, next + interval);
+            runPaths(next, end, summary);
+            next = end;
+            if (writer && next < mcConfig.pathCount)
+            {
+                snapshot.clear();
+                saveState(snapshot, summary, next);
+                writer->submit(snapshot.data());
+            }
+        }
+        return summary;
+    }
+};
+
+// == 5-7. 정적 전략 조합 엔진 ==
+
+// 수수료 정책: 전략마다 생성 시 받은 수수료를 쓴다
+struct RuntimeFee
+{
+    template <typename S>
+    static const FeeSchedule &rateFor(const S &s) { return s.getFeeSchedule(); }
+};
+
+// 수수료 정책: 컴파일 타임 상수 Num / Den (전략이 가진 수수료 값은 무시)
+template <long long Num, long long Den>
+struct StaticFee
+{
+    template <typename S>
+    static constexpr FeeSchedule rateFor(const S &) { return FeeSchedule::ratio(Num, Den); }
+};
+
+typedef StaticFee<15, 100000> DefaultStaticFee; // 0.015%
+
+// StaticBacktestEngine 클래스
+// 전략 타입을 템플릿 인자로 고정해 가상 호출 없이 runBattle과 같은 결과를 낸다.
+// 모든 전략의 tick이 하나의 가격 루프 안에서 인라인된다.
+// 예: StaticBacktestEngine<RuntimeFee, PanicSellStrategy, DCAStrategy, HoldStrategy>
+template <typename FeePolicy, typename... Strategies>
+class StaticBacktestEngine
+{
+private:
+    const Stock *stock;
+    BacktestConfig config;
+    tuple<Strategies...> strategies;
+    vector<StrategyReport> results;
+
+    template <typename Fn, size_t... I>
+    void forEachImpl(Fn &fn, index_sequence<I...>)
+    {
+        int expand[] = {0, (fn(get<I>(strategies)), 0)...};
+        (void)expand;
+    }
+
+    template <typename Fn>
+    void forEach(Fn fn)
+    {
+        forEachImpl(fn, index_sequence_for<Strategies...>());
+    }
+
+public:
+    StaticBacktestEngine(const Stock *s, const BacktestConfig &cfg, Strategies... strats)
+        : stock(s), config(cfg), strategies(move(strats)...) {}
+
+    void runBattle()
+    {
+        size_t len = stock->getHistoryLength();
+        if (len == 0)
+            return;
+
+        const int *prices = stock->getHistoryData();
+        const BacktestConfig &cfg = config;
+        forEach([&](TradingStrategy &s)
+                {
+            s.setKeepHistory(cfg.keepEquityHistory);
+            s.setRiskWindow(cfg.rollingWindow);
+            s.setRiskTarget(cfg.periodsPerYear, cfg.riskFreeRate);
+            s.reserveHistory(len); });
+
+        // 등락률 계산과 전 전략의 틱 처리를 한 루프로 합친다
+        for (size_t i = 0; i < len; ++i)
+        {
+            int price = prices[i];
+            double changeRate = (i == 0) ? 0.0 : (double)(price - prices[i - 1]) / prices[i - 1] * 100;
+            forEach([&](auto &s)
+                    { s.tick(i, price, changeRate, FeePolicy::rateFor(s)); });
+        }
+
+        int lastPrice = prices[len - 1];
+        results.reserve(results.size() + sizeof...(Strategies));
+        forEach([&](TradingStrategy &s)
+                {
+            s.onFinish(lastPrice);
+            results.push_back(BacktestEngine::buildReport(&s, cfg.initialCash, lastPrice,
+                                                          cfg.periodsPerYear, cfg.riskFreeRate)); });
+    }
+
+    template <size_t I>
+    typename tuple_element<I, tuple<Strategies...>>::type &getStrategy() { return get<I>(strategies); }
+
+    const vector<StrategyReport> &getResults() const { return results; }
+    const Stock *getStock() const { return stock; }
+};
+
+typedef StaticBacktestEngine<RuntimeFee, PanicSellStrategy, DCAStrategy, HoldStrategy> DefaultStaticEngine;
+
+// config 값으로 기본 3개 전략을 가진 정적 엔진 생성
+template <typename FeePolicy = RuntimeFee>
+StaticBacktestEngine<FeePolicy, PanicSellStrategy, DCAStrategy, HoldStrategy>
+makeDefaultStaticEngine(const Stock *stock, const BacktestConfig &config)
+{
+    return StaticBacktestEngine<FeePolicy, PanicSellStrategy, DCAStrategy, HoldStrategy>(
+        stock, config,
+        PanicSellStrategy(config.initialCash, config.panicThreshold, config.feeRate),
+        DCAStrategy(config.initialCash, config.dcaDropRate,
+                    config.dcaInterval, config.dcaBuyRatio, config.feeRate),
+        HoldStrategy(config.initialCash, config.holdBuyRatio, config.feeRate));
+}
+
+// == 5-8. 워크포워드 최적화 ==
+
+// 학습 구간 선택 기준
+enum WalkForwardObjective
+{
+    OBJECTIVE_TOTAL_RETURN,
+    OBJECTIVE_SHARPE,
+    OBJECTIVE_SORTINO,
+    OBJECTIVE_CALMAR
+};
+
+// WalkForwardSelection 구조체 (한 구간에서 전략 하나에 대해 고른 설정과 결과)
+struct WalkForwardSelection
+{
+    BacktestConfig config;
+    double inSampleScore;
+    StrategyReport inSample;
+    StrategyReport outOfSample;
+};
+
+// WalkForwardWindow 구조체 (학습 구간 [trainBegin, testBegin), 검증 구간 [testBegin, testBegin + testLength))
+struct WalkForwardWindow
+{
+    size_t trainBegin;
+    size_t trainLength;
+    size_t testBegin;
+    size_t testLength;
+    double marketReturn;     // 검증 구간 주가 수익률 (%)
+    double marketVolatility; // 검증 구간 주가 연 변동성 (%)
+    vector<WalkForwardSelection> selections; // 기본 전략 순서 (쫄보, 코치, 존버)
+};
+
+// WalkForwardOptimizer 클래스
+// 가격 이력을 학습/검증 구간으로 굴려 가며 나누고, 학습 구간마다 설정 그리드를 스윕해
+// 전략별로 가장 좋은 설정을 골라 바로 다음 검증 구간에서 다시 실행한다.
+// 등락률과 누적합은 전체 이력에 대해 한 번만 계산하고, 모든 구간/설정이 포인터로 잘라 쓴다.
+// 각 전략의 성과는 자기 파라미터에만 의존하므로 전략마다 따로 고른다.
+class WalkForwardOptimizer
+{
+private:
+    const Stock *stock;
+    vector<BacktestConfig> grid;
+    size_t trainLength;
+    size_t testLength;
+    size_t stepLength;
+    WalkForwardObjective objective;
+    unsigned int threadCount;
+
+    vector<double> rates;       // rates[i]: i - 1 대비 등락률 (%)
+    vector<double> prefixSum;   // prefixSum[i]: 수익률 r[0..i) 합 (r = rates / 100)
+    vector<double> prefixSumSq; // prefixSumSq[i]: r[0..i) 제곱합
+
+    static const size_t JOB_CHUNK = 8;
+
+    void precompute()
+    {
+        size_t len = stock->getHistoryLength();
+        const int *prices = stock->getHistoryData();
+        rates.assign(len, 0.0);
+        prefixSum.assign(len + 1, 0.0);
+        prefixSumSq.assign(len + 1, 0.0);
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (i > 0)
+                rates[i] = (double)(prices[i] - prices[i - 1]) / prices[i - 1] * 100;
+            double r = rates[i] / 100.0;
+            prefixSum[i + 1] = prefixSum[i] + r;
+            prefixSumSq[i + 1] = prefixSumSq[i] + r * r;
+        }
+    }
+
+    // 구간 [begin, begin + len)의 수익률 r[begin + 1..begin + len) 연 변동성 (%)
+    double windowVolatility(size_t begin, size_t len, double periodsPerYear) const
+    {
+        if (len < 3)
+            return 0.0;
+        double n = (double)(len - 1);
+        double sum = prefixSum[begin + len] - prefixSum[begin + 1];
+        double sumSq = prefixSumSq[begin + len] - prefixSumSq[begin + 1];
+        double var = max(0.0, (sumSq - sum * sum / n) / (n - 1));
+        return sqrt(var * periodsPerYear) * 100.0;
+    }
+
+    // 구간 하나를 설정 하나로 실행 (리포트만 필요하므로 자산 곡선은 저장하지 않음)
+    vector<StrategyReport> runWindow(const BacktestConfig &config, size_t begin, size_t len, Arena &arena) const
+    {
+        BacktestConfig cfg = config;
+        cfg.keepEquityHistory = false;
+        vector<StrategyReport> reports;
+        {
+            BacktestEngine engine(stock, cfg, &arena);
+            engine.addDefaultStrategies();
+            engine.runSeries(stock->getHistoryData() + begin, rates.data() + begin, len, begin);
+            reports = engine.getResults();
+        }
+        arena.reset();
+        return reports;
+    }
+
+    // job(index, arena)을 [0, jobCount)에 대해 워커 스레드로 나눠 실행
+    template <typename Job>
+    void runParallel(size_t jobCount, const Job &job) const
+    {
+        unsigned int workers = threadCount;
+        if (workers == 0)
+            workers = thread::hardware_concurrency();
+        if (workers == 0)
+            workers = 1;
+        size_t maxWorkers = (jobCount + JOB_CHUNK - 1) / JOB_CHUNK;
+        if (workers > maxWorkers)
+            workers = (unsigned int)max<size_t>(1, maxWorkers);
+
+        atomic<size_t> nextJob(0);
+        auto worker = [&]()
+        {
+            Arena arena;
+            while (true)
+            {
+                size_t begin = nextJob.fetch_add(JOB_CHUNK);
+                if (begin >= jobCount)
+                    break;
+                size_t end = min(begin + JOB_CHUNK, jobCount);
+                for (size_t i = begin; i < end; ++i)
+                    job(i, arena);
+            }
+        };
+
+        vector<thread> pool;
+        for (unsigned int t = 1; t < workers; ++t)
+            pool.emplace_back(worker);
+        worker(); // 호출 스레드도 작업에 참여
+        for (thread &th : pool)
+            th.join();
+    }
+
+public:
+    // stepLength가 0이면 testLength만큼씩 이동 (검증 구간이 겹치지 않음)
+    // threads가 0이면 하드웨어 코어 수만큼 사용
+    WalkForwardOptimizer(const Stock *s, size_t train, size_t test, size_t step = 0, unsigned int threads = 0)
+        : stock(s), trainLength(train), testLength(test), stepLength(step ? step : test),
+          objective(OBJECTIVE_SHARPE), threadCount(threads) {}
+
+    void setGrid(const vector<BacktestConfig> &configs) { grid = configs; }
+    void setObjective(WalkForwardObjective o) { objective = o; }
+    size_t getConfigCount() const { return grid.size(); }
+
+    static double score(const StrategyReport &r, WalkForwardObjective o)
+    {
+        switch (o)
+        {
+        case OBJECTIVE_SHARPE: return r.risk.sharpeRatio;
+        case OBJECTIVE_SORTINO: return r.risk.sortinoRatio;
+        case OBJECTIVE_CALMAR: return r.risk.calmarRatio;
+        default: return r.totalReturn;
+        }
+    }
+
+    // 학습 + 검증 구간이 이력 안에 다 들어가는 구간만 만든다
+    vector<WalkForwardWindow> makeWindows() const
+    {
+        vector<WalkForwardWindow> windows;
+        size_t len = stock ? stock->getHistoryLength() : 0;
+        if (trainLength == 0 || testLength == 0)
+            return windows;
+        for (size_t begin = 0; begin + trainLength + testLength <= len; begin += stepLength)
+        {
+            WalkForwardWindow w;
+            w.trainBegin = begin;
+            w.trainLength = trainLength;
+            w.testBegin = begin + trainLength;
+            w.testLength = testLength;
+            w.marketReturn = 0.0;
+            w.marketVolatility = 0.0;
+            windows.push_back(w);
+        }
+        return windows;
+    }
+
+    // 구간 순서대로 결과 반환 (같은 점수면 그리드에서 앞선 설정을 고른다)
+    vector<WalkForwardWindow> run()
+    {
+        vector<WalkForwardWindow> windows = makeWindows();
+        if (windows.empty() || grid.empty())
+            return windows;
+
+        precompute();
+        const int *prices = stock->getHistoryData();
+        size_t configCount = grid.size();
+
+        // 1) 모든 (구간, 설정) 학습 실행을 한 작업 목록으로 병렬 처리
+        vector<vector<StrategyReport>> trainReports(windows.size() * configCount);
+        runParallel(trainReports.size(), [&](size_t job, Arena &arena)
+                    {
+            const WalkForwardWindow &w = windows[job / configCount];
+            trainReports[job] = runWindow(grid[job % configCount], w.trainBegin, w.trainLength, arena); });
+
+        // 2) 구간마다 전략별 최고 설정 선택
+        size_t strategyCount = trainReports[0].size();
+        for (size_t wi = 0; wi < windows.size(); ++wi)
+        {
+            WalkForwardWindow &w = windows[wi];
+            int first = prices[w.testBegin];
+            int last = prices[w.testBegin + w.testLength - 1];
+            w.marketReturn = (double)(last - first) / first * 100.0;
+            w.marketVolatility = windowVolatility(w.testBegin, w.testLength, grid[0].periodsPerYear);
+
+            w.selections.resize(strategyCount);
+            for (size_t k = 0; k < strategyCount; ++k)
+            {
+                size_t best = 0;
+                double bestScore = 0.0;
+                for (size_t c = 0; c < configCount; ++c)
+                {
+                    double sc = score(trainReports[wi * configCount + c][k], objective);
+                    if (c == 0 || sc > bestScore)
+                    {
+                        best = c;
+                        bestScore = sc;
+                    }
+                }
+                w.selections[k].config = grid[best];
+                w.selections[k].inSampleScore = bestScore;
+                w.selections[k].inSample = trainReports[wi * configCount + best][k];
+            }
+        }
+
+        // 3) 고른 설정으로 검증 구간 실행 (구간 x 전략)
+        runParallel(windows.size() * strategyCount, [&](size_t job, Arena &arena)
+                    {
+            WalkForwardWindow &w = windows[job / strategyCount];
+            WalkForwardSelection &sel = w.selections[job % strategyCount];
+            sel.outOfSample = runWindow(sel.config, w.testBegin, w.testLength, arena)[job % strategyCount]; });
+
+        return windows;
+    }
+
+    static void print(const vector<WalkForwardWindow> &windows)
+    {
+        for (const WalkForwardWindow &w : windows)
+        {
+            cout << "[학습 " << w.trainBegin << "~" << w.testBegin - 1 << " / 검증 " << w.testBegin << "~"
+                 << w.testBegin + w.testLength - 1 << "] 주가 " << fixed << setprecision(2)
+                 << w.marketReturn << "% (변동성 " << w.marketVolatility << "%)" << endl;
+            for (size_t k = 0; k < w.selections.size(); ++k)
+            {
+                // 전략마다 자기 파라미터만 표시
+                const WalkForwardSelection &sel = w.selections[k];
+                cout << "  " << sel.outOfSample.strategyName << ": " << setprecision(0);
+                if (k == 0)
+                    cout << "손절 " << sel.config.panicThreshold * 100 << "%";
+                else if (k == 1)
+                    cout << "물타기 " << sel.config.dcaDropRate * 100 << "% / " << sel.config.dcaInterval << "일";
+                else
+                    cout << "매수 비율 " << sel.config.holdBuyRatio * 100 << "%";
+                cout << " -> 학습 " << setprecision(2) << sel.inSample.totalReturn << "%, 검증 "
+                     << sel.outOfSample.totalReturn << "% (MDD " << sel.outOfSample.maxDrawdown << "%)" << endl;
+            }
+        }
+    }
+};
+
+// == 5-9. 이벤트 기반 시뮬레이션 커널 ==
+
+// 커널 이벤트 종류
+enum SimEventType
+{
+    SIM_PRICE_TICK,   // 가격 피드의 다음 틱
+    SIM_ORDER_SUBMIT, // 에이전트 주문이 계좌에 도착
+    SIM_ORDER_FILL,   // 체결 결과 통보
+    SIM_TIMER         // 에이전트 타이머
+};
+
+// SimEvent 구조체 (힙 할당 없는 고정 크기 이벤트)
+struct SimEvent
+{
+    int64_t time;
+    uint64_t seq; // 같은 시각이면 먼저 예약한 이벤트부터
+    int type;
+    int agent;    // 대상 에이전트 (-1: 없음)
+    int symbolId;
+    int side;     // OrderType
+    int quantity;
+    int price;    // 체결가 (체결 실패면 0)
+    uint64_t data; // 피드 번호 / 타이머 태그 / 주문 번호
+};
+
+// SimFill 구조체 (에이전트에게 전달되는 체결 결과)
+struct SimFill
+{
+    int orderId;
+    int symbolId;
+    OrderType side;
+    int quantity;
+    int price;
+    bool filled; // false면 잔고/수량 부족으로 거부
+};
+
+class SimulationKernel;
+
+// SimulationAgent 클래스 (커널에서 시세/체결/타이머를 받아 주문을 내는 참여자)
+class SimulationAgent
+{
+public:
+    virtual ~SimulationAgent() {}
+    virtual void onStart(SimulationKernel &kernel) {}
+    virtual void onPriceTick(SimulationKernel &kernel, int symbolId, int price) {}
+    virtual void onFill(SimulationKernel &kernel, const SimFill &fill) {}
+    virtual void onTimer(SimulationKernel &kernel, uint64_t tag) {}
+    virtual void onFinish(SimulationKernel &kernel) {}
+};
+
+// SimulationKernel 클래스 (하나의 시계로 시세, 주문, 체결, 타이머를 시간 순서대로 처리)
+// 이벤트는 미리 확보한 배열 위의 이진 힙에 들어가고, 가격 피드는 다음 틱 하나만 예약해 두므로
+// 힙 크기는 (피드 수 + 진행 중 주문/타이머 수)로 유지된다.
+// 주문은 에이전트에 연결된 Account로 실제 Order를 만들어 체결한다 (현재는 시장가만).
+class SimulationKernel
+{
+private:
+    struct PriceFeed
+    {
+        int symbolId;
+        const int *prices;
+        size_t length;
+        size_t next; // 다음에 보낼 위치
+        int64_t step;
+    };
+
+    struct AgentSlot
+    {
+        SimulationAgent *agent;
+        Account *account;
+    };
+
+    // 시각이 늦거나 같은 시각에 나중 예약이면 우선순위가 낮다 (최소 힙)
+    struct Later
+    {
+        bool operator()(const SimEvent &a, const SimEvent &b) const
+        {
+            if (a.time != b.time)
+                return a.time > b.time;
+            return a.seq > b.seq;
         }
-        return false;
+    };
+
+    Market &market;
+    vector<SimEvent> queue; // 이진 힙
+    vector<PriceFeed> feeds;
+    vector<AgentSlot> agents;
+    vector<vector<int>> tickListeners; // 종목별 시세를 받는 에이전트
+    uint64_t nextSeq;
+    int64_t currentTime;
+    uint64_t processedEvents;
+    bool stopped;
+
+    // 커널을 만든 뒤 Market에 추가된 종목도 받을 수 있도록
+    void growListeners()
+    {
+        if (tickListeners.size() < market.getStockCount())
+            tickListeners.resize(market.getStockCount());
     }
 
-    bool placeOrder(Order order)
+    void push(SimEvent e)
     {
-        // 간단한 유효성 검사
-        orders.push_back(order);
-        return true;
+        e.seq = nextSeq++;
+        queue.push_back(e);
+        push_heap(queue.begin(), queue.end(), Later());
     }
 
-    bool executeOrder(int orderId, Market &m)
+    static SimEvent makeEvent(int64_t time, int type, int agent)
     {
-        for (auto &order : orders)
-        {
-            if (order.getOrderId() == orderId && order.isPending())
-            {
-                Stock *stock = m.getStock(order.getStockCode());
-                if (!stock)
-                    return false;
+        SimEvent e;
+        memset(&e, 0, sizeof(e));
+        e.time = time;
+        e.type = type;
+        e.agent = agent;
+        return e;
+    }
 
-                int currentPrice = stock->getCurrentPrice();
-                long totalCost = (long)currentPrice * order.getQuantity();
-                int fee = (int)(totalCost * DEFAULT_FEE_RATE);
+    void scheduleFeedTick(size_t feedIndex, int64_t time)
+    {
+        SimEvent e = makeEvent(time, SIM_PRICE_TICK, -1);
+        e.symbolId = feeds[feedIndex].symbolId;
+        e.data = feedIndex;
+        push(e);
+    }
 
-                if (order.getOrderType() == BUY)
-                {
-                    if (balance >= totalCost + fee)
-                    {
-                        balance -= (totalCost + fee);
-                        portfolio.addPosition(stock, order.getQuantity(), currentPrice);
-                        order.execute();
-                        transactions.push_back(Transaction(order, stock, currentPrice));
-                        return true;
-                    }
-                }
-                else if (order.getOrderType() == SELL)
-                {
-                    if (portfolio.hasPosition(stock->getCode()))
-                    {
-                        Position *pos = portfolio.getPosition(stock->getCode());
-                        if (pos && pos->getQuantity() >= order.getQuantity())
-                        {
-                            portfolio.reducePosition(stock->getCode(), order.getQuantity());
-                            long netRevenue = totalCost - fee;
-                            balance += netRevenue;
-                            order.execute();
-                            transactions.push_back(Transaction(order, stock, currentPrice));
-                            return true;
-                        }
-                    }
-                }
-            }
+    void handlePriceTick(const SimEvent &e)
+    {
+        PriceFeed &feed = feeds[e.data];
+        int price = feed.prices[feed.next++];
+        market.setPrice(feed.symbolId, price); // 계좌 포트폴리오 평가도 여기서 갱신
+        for (int agent : tickListeners[feed.symbolId])
+            agents[agent].agent->onPriceTick(*this, feed.symbolId, price);
+        if (feed.next < feed.length)
+            scheduleFeedTick(e.data, e.time + feed.step);
+    }
+
+    void handleOrder(const SimEvent &e)
+    {
+        SimEvent result = makeEvent(e.time, SIM_ORDER_FILL, e.agent);
+        result.symbolId = e.symbolId;
+        result.side = e.side;
+        result.quantity = e.quantity;
+
+        Stock *stock = market.getStockById(e.symbolId);
+        Account *account = agents[e.agent].account;
+        if (stock && account)
+        {
+            Order order(e.symbolId, (OrderType)e.side, MARKET, 0, e.quantity);
+            result.data = (uint64_t)order.getOrderId();
+            if (account->executeImmediately(order, market))
+                result.price = stock->getCurrentPrice();
         }
-        return false;
+        push(result);
     }
 
-    long getBalance() const { return balance; }
+    void handleFill(const SimEvent &e)
+    {
+        SimFill fill;
+        fill.orderId = (int)e.data;
+        fill.symbolId = e.symbolId;
+        fill.side = (OrderType)e.side;
+        fill.quantity = e.quantity;
+        fill.price = e.price;
+        fill.filled = (e.price > 0);
+        agents[e.agent].agent->onFill(*this, fill);
+    }
 
-    long getTotalAssetValue() const
+public:
+    // capacity: 힙에 미리 확보할 이벤트 수
+    explicit SimulationKernel(Market &m, size_t capacity = 1024)
+        : market(m), tickListeners(m.getStockCount()), nextSeq(0), currentTime(0),
+          processedEvents(0), stopped(false)
     {
-        return balance + portfolio.getTotalValue();
+        queue.reserve(capacity);
     }
 
-    Portfolio &getPortfolio() { return portfolio; }
+    SimulationKernel(const SimulationKernel &) = delete;
+    SimulationKernel &operator=(const SimulationKernel &) = delete;
 
-    void printAccountSummary() const
+    // account가 nullptr이면 주문을 낼 수 없는 관찰자 (반환값: 에이전트 번호)
+    int addAgent(SimulationAgent *agent, Account *account)
     {
-        cout << "계좌번호: " << accountNumber << " | 예수금: " << balance
-             << " | 총 자산: " << getTotalAssetValue() << endl;
+        agents.push_back({agent, account});
+        return (int)agents.size() - 1;
     }
-};
 
-// User 클래스
-class User
-{
-private:
-    string userId;
-    string password;
-    string name;
-    Account *account;
+    bool subscribe(int agent, int symbolId)
+    {
+        if (agent < 0 || agent >= (int)agents.size() || !market.getStockById(symbolId))
+            return false;
+        growListeners();
+        tickListeners[symbolId].push_back(agent);
+        return true;
+    }
 
-public:
-    User(string id, string pw, string n) : userId(id), password(pw), name(n)
+    // prices[0..len)을 start부터 step 간격으로 보낸다 (배열은 실행이 끝날 때까지 유효해야 함)
+    bool addPriceFeed(int symbolId, const int *prices, size_t len, int64_t start = 0, int64_t step = 1)
     {
-        // 계좌 자동 생성 (임의 번호)
-        account = new Account(id, 0);
+        if (!market.getStockById(symbolId) || len == 0 || step <= 0)
+            return false;
+        growListeners();
+        feeds.push_back({symbolId, prices, len, 0, step});
+        scheduleFeedTick(feeds.size() - 1, start);
+        return true;
     }
 
-    ~User()
+    // 종목의 가격 이력 전체를 피드로 등록
+    bool addHistoryFeed(int symbolId, int64_t start = 0, int64_t step = 1)
     {
-        delete account;
+        const Stock *stock = market.getStockById(symbolId);
+        return stock && addPriceFeed(symbolId, stock->getHistoryData(), stock->getHistoryLength(), start, step);
     }
 
-    bool login(string id, string pw) const
+    // latency 뒤에 계좌에 도착하는 시장가 주문
+    void submitOrder(int agent, int symbolId, OrderType side, int quantity, int64_t latency = 0)
     {
-        return (userId == id && password == pw);
+        SimEvent e = makeEvent(currentTime + latency, SIM_ORDER_SUBMIT, agent);
+        e.symbolId = symbolId;
+        e.side = side;
+        e.quantity = quantity;
+        push(e);
     }
 
-    Account *getAccount()
+    void scheduleTimer(int agent, int64_t at, uint64_t tag)
     {
-        return account;
+        SimEvent e = makeEvent(max(at, currentTime), SIM_TIMER, agent);
+        e.data = tag;
+        push(e);
     }
-};
 
-// == 5. 습관 교정 백테스터 클래스 ==
+    void stop() { stopped = true; }
 
-// TradingStrategy 클래스 (추상)
-class TradingStrategy
+    // until 이전 시각의 이벤트를 모두 처리 (처리한 이벤트 수 반환)
+    uint64_t run(int64_t until = INT64_MAX)
+    {
+        stopped = false;
+        uint64_t before = processedEvents;
+        if (processedEvents == 0)
+        {
+            for (size_t i = 0; i < agents.size(); ++i)
+                agents[i].agent->onStart(*this);
+        }
+
+        while (!queue.empty() && !stopped)
+        {
+            if (queue.front().time >= until)
+                break;
+            pop_heap(queue.begin(), queue.end(), Later());
+            SimEvent e = queue.back();
+            queue.pop_back();
+            currentTime = e.time;
+            processedEvents++;
+
+            switch (e.type)
+            {
+            case SIM_PRICE_TICK:
+                handlePriceTick(e);
+                break;
+            case SIM_ORDER_SUBMIT:
+                handleOrder(e);
+                break;
+            case SIM_ORDER_FILL:
+                handleFill(e);
+                break;
+            case SIM_TIMER:
+                agents[e.agent].agent->onTimer(*this, e.data);
+                break;
+            }
+        }
+
+        if (queue.empty())
+        {
+            for (size_t i = 0; i < agents.size(); ++i)
+                agents[i].agent->onFinish(*this);
+        }
+        return processedEvents - before;
+    }
+
+    int64_t now() const { return currentTime; }
+    size_t getPendingEvents() const { return queue.size(); }
+    uint64_t getProcessedEvents() const { return processedEvents; }
+    Market &getMarket() { return market; }
+    Account *getAccount(int agent) const { return agents[agent].account; }
+};
+
+// StrategyAccountAgent 클래스 (TradingStrategy를 커널 에이전트로 실행)
+// 전략은 평소처럼 onPrice로 판단하고, 보유 수량이 바뀌면 그 차이만큼 실제 주문을 계좌에 낸다.
+// 계좌 수량은 체결 통보로만 반영하므로, 거부된 주문은 다음 틱에 남은 차이만큼 다시 낸다.
+// 지연이 0이면 같은 가격에 체결되므로 계좌 자산이 전략 자체 계산과 같다.
+class StrategyAccountAgent : public SimulationAgent
 {
-protected:
-    string name;
-    long cash;
-    int shares;
-    int avgPrice;
-    vector<long> equityHistory;
-    int buyCount;
-    int sellCount;
+private:
+    TradingStrategy *strategy; // 소유하지 않음
+    int symbolId;
+    int agentId;
+    int64_t latency;
+    size_t tickIndex;
+    int lastPrice;
+    int mirroredShares; // 체결이 확인된 계좌 보유 수량
+    int pendingBuy;     // 체결 통보를 기다리는 매수 수량
+    int pendingSell;    // 체결 통보를 기다리는 매도 수량
 
-    void buy(int price, int qty, double feeRate)
+public:
+    StrategyAccountAgent(TradingStrategy *s, int symbol, int64_t orderLatency = 0)
+        : strategy(s), symbolId(symbol), agentId(-1), latency(orderLatency),
+          tickIndex(0), lastPrice(0), mirroredShares(0), pendingBuy(0), pendingSell(0) {}
+
+    // 커널에 등록하고 종목 시세를 구독
+    int attach(SimulationKernel &kernel, Account *account)
     {
-        long cost = (long)price * qty;
-        long fee = (long)(cost * feeRate);
+        agentId = kernel.addAgent(this, account);
+        kernel.subscribe(agentId, symbolId);
+        return agentId;
+    }
 
-        if (cash >= cost + fee && qty > 0)
+    void onPriceTick(SimulationKernel &kernel, int symbol, int price) override
+    {
+        double rate = (lastPrice > 0) ? (double)(price - lastPrice) / lastPrice * 100 : 0.0;
+        strategy->onPrice(tickIndex++, price, rate);
+        lastPrice = price;
+
+        // 진행 중인 주문이 모두 체결된다고 보고 남은 차이만 낸다
+        int target = strategy->getShares();
+        int expected = mirroredShares + pendingBuy - pendingSell;
+        if (target > expected)
         {
-            long totalCost = (long)avgPrice * shares + cost;
-            shares += qty;
-            avgPrice = (shares > 0) ? (int)(totalCost / shares) : 0;
-            cash -= (cost + fee);
-            buyCount++;
+            kernel.submitOrder(agentId, symbolId, BUY, target - expected, latency);
+            pendingBuy += target - expected;
+        }
+        else if (target < expected)
+        {
+            kernel.submitOrder(agentId, symbolId, SELL, expected - target, latency);
+            pendingSell += expected - target;
         }
     }
 
-    void sellAll(int price, double feeRate)
+    // 거부된 수량은 pending에서만 빠지므로 다음 틱에 다시 맞춘다
+    void onFill(SimulationKernel &kernel, const SimFill &fill) override
     {
-        if (shares > 0)
+        if (fill.symbolId != symbolId)
+            return;
+        if (fill.side == BUY)
         {
-            long revenue = (long)price * shares;
-            long fee = (long)(revenue * feeRate);
-            cash += (revenue - fee);
-            shares = 0;
-            avgPrice = 0;
-            sellCount++;
+            pendingBuy -= fill.quantity;
+            if (fill.filled)
+                mirroredShares += fill.quantity;
+        }
+        else
+        {
+            pendingSell -= fill.quantity;
+            if (fill.filled)
+                mirroredShares -= fill.quantity;
         }
     }
 
-    void recordEquity(int price)
+    void onFinish(SimulationKernel &kernel) override
     {
-        equityHistory.push_back(getTotalValue(price));
+        if (lastPrice > 0)
+            strategy->onFinish(lastPrice);
     }
 
-public:
-    TradingStrategy(string n, long initCash)
-        : name(n), cash(initCash), shares(0), avgPrice(0), buyCount(0), sellCount(0) {}
+    int getAgentId() const { return agentId; }
+    int getMirroredShares() const { return mirroredShares; }
+    const TradingStrategy *getStrategy() const { return strategy; }
+};
 
-    virtual ~TradingStrategy() {}
+// == 5-10. 분산 실행 (코디네이터 / 워커) ==
+// 코디네이터가 (종목 x 설정 구간) 작업을 TCP로 워커 노드들에게 나눠 주고 결과를 모은다.
+// 워커는 공유 저장소의 종목 파일(.oopc)을 처음 필요할 때 mmap으로 열고 ParameterSweepEngine으로 돌린다.
+// 워커가 작업을 끝낼 때마다 다음 작업을 받아 가므로 빠른 노드가 더 많이 처리하고,
+// 남은 작업이 없으면 나간 지 오래된 미완료 작업을 할 일이 없는 노드에 한 번 더 맡긴다 (먼저 온 결과 사용).
+// 종목 파일을 열 수 없는 작업은 정해진 횟수만 다시 맡기고 실패 목록으로 돌려준다.
+// 메시지는 스냅샷처럼 값을 메모리 표현 그대로 보내므로, HELLO에 전송 구조체의 크기와 필드 위치
+// (ClusterLayout)를 담아 코디네이터와 다른 빌드/레이아웃의 워커는 받지 않는다.
 
-    virtual void onPrice(size_t idx, int price, double rate) = 0;
+#ifndef _WIN32
 
-    virtual void onFinish(int lastPrice)
-    {
-    }
+const uint32_t CLUSTER_PROTOCOL_VERSION = 2;
+const uint32_t CLUSTER_MAX_FRAME = 1u << 30; // 한 메시지 최대 크기
+
+enum ClusterMessageType
+{
+    CLUSTER_HELLO = 1, // 워커 -> 코디네이터: 프로토콜 버전, ClusterLayout, 스레드 수
+    CLUSTER_SETUP,     // 코디네이터 -> 워커: 설정 그리드, 종목 파일 목록
+    CLUSTER_JOB,       // 코디네이터 -> 워커: ClusterJob
+    CLUSTER_RESULT,    // 워커 -> 코디네이터: 작업 번호, ClusterReport 묶음
+    CLUSTER_FAILED,    // 워커 -> 코디네이터: 종목 파일을 열 수 없는 작업 번호 (연결은 유지)
+    CLUSTER_SHUTDOWN   // 코디네이터 -> 워커: 종료
+};
+
+// ClusterJob 구조체 (종목 하나의 설정 [configBegin, configEnd) 구간)
+struct ClusterJob
+{
+    uint32_t jobId;
+    uint32_t symbolIndex;
+    uint32_t configBegin;
+    uint32_t configEnd;
+};
 
-    string getName() const { return name; }
+// ClusterReport 구조체 (전송 단위, strategyName은 받은 쪽에서 kind로 다시 채운다)
+struct ClusterReport
+{
+    uint32_t symbolIndex;
+    uint32_t configIndex;
+    StrategyReport report;
+};
 
-    long getTotalValue(int price) const
+// ClusterLayout 구조체 (메모리 표현 그대로 보내는 구조체들의 크기/필드 위치, 양쪽이 같아야 접속)
+struct ClusterLayout
+{
+    uint32_t byteOrder;         // 0x01020304 (바이트 순서)
+    uint32_t configSize;        // sizeof(BacktestConfig)
+    uint32_t reportSize;        // sizeof(StrategyReport)
+    uint32_t clusterReportSize; // sizeof(ClusterReport)
+    uint32_t jobSize;           // sizeof(ClusterJob)
+    uint32_t reserved;
+    uint64_t fingerprint;       // 모든 필드 위치와 크기의 FNV-1a
+
+    static ClusterLayout current()
     {
-        return cash + (long)shares * price;
+        const uint64_t fields[] = {
+            sizeof(BacktestConfig), offsetof(BacktestConfig, initialCash), offsetof(BacktestConfig, feeRate),
+            offsetof(BacktestConfig, panicThreshold), offsetof(BacktestConfig, dcaDropRate),
+            offsetof(BacktestConfig, dcaInterval), offsetof(BacktestConfig, dcaBuyRatio),
+            offsetof(BacktestConfig, holdBuyRatio), offsetof(BacktestConfig, keepEquityHistory),
+            offsetof(BacktestConfig, periodsPerYear), offsetof(BacktestConfig, riskFreeRate),
+            offsetof(BacktestConfig, rollingWindow),
+            sizeof(RiskMetrics), offsetof(RiskMetrics, annualReturn), offsetof(RiskMetrics, annualVolatility),
+            offsetof(RiskMetrics, sharpeRatio), offsetof(RiskMetrics, sortinoRatio),
+            offsetof(RiskMetrics, calmarRatio), offsetof(RiskMetrics, maxDrawdownDuration),
+            offsetof(RiskMetrics, rollingVolatility), offsetof(RiskMetrics, maxRollingVolatility),
+            sizeof(StrategyReport), sizeof(StrategyKind), offsetof(StrategyReport, kind),
+            offsetof(StrategyReport, strategyName), offsetof(StrategyReport, initialCash),
+            offsetof(StrategyReport, finalEquity), offsetof(StrategyReport, totalReturn),
+            offsetof(StrategyReport, maxDrawdown), offsetof(StrategyReport, buyCount),
+            offsetof(StrategyReport, sellCount), offsetof(StrategyReport, finalShares),
+            offsetof(StrategyReport, avgPrice), offsetof(StrategyReport, risk),
+            sizeof(ClusterReport), offsetof(ClusterReport, symbolIndex), offsetof(ClusterReport, configIndex),
+            offsetof(ClusterReport, report),
+            sizeof(ClusterJob), offsetof(ClusterJob, jobId), offsetof(ClusterJob, symbolIndex),
+            offsetof(ClusterJob, configBegin), offsetof(ClusterJob, configEnd)};
+
+        ClusterLayout layout;
+        layout.byteOrder = 0x01020304;
+        layout.configSize = sizeof(BacktestConfig);
+        layout.reportSize = sizeof(StrategyReport);
+        layout.clusterReportSize = sizeof(ClusterReport);
+        layout.jobSize = sizeof(ClusterJob);
+        layout.reserved = 0;
+        layout.fingerprint = 0xCBF29CE484222325ULL;
+        for (uint64_t v : fields)
+        {
+            layout.fingerprint ^= v;
+            layout.fingerprint *= 0x100000001B3ULL;
+        }
+        return layout;
     }
 
-    const vector<long> &getEquityHistory() const { return equityHistory; }
-    int getBuyCount() const { return buyCount; }
-    int getSellCount() const { return sellCount; }
-    int getShares() const { return shares; }
-    int getAvgPrice() const { return avgPrice; }
+    bool matches(const ClusterLayout &other) const
+    {
+        return byteOrder == other.byteOrder && configSize == other.configSize &&
+               reportSize == other.reportSize && clusterReportSize == other.clusterReportSize &&
+               jobSize == other.jobSize && fingerprint == other.fingerprint;
+    }
 };
 
-// PanicSellStrategy 클래스 (쫄보)
-class PanicSellStrategy : public TradingStrategy
+// ClusterConnection 클래스 (길이를 앞에 붙인 메시지 단위 TCP 연결)
+class ClusterConnection
 {
 private:
-    double stopLossRate;
-    double feeRate;
-    bool hasBought;
+    struct FrameHeader
+    {
+        uint32_t type;
+        uint32_t length;
+    };
+
+    int fd;
+    vector<char> inbox; // 아직 처리하지 않은 수신 데이터
+    size_t inboxStart;
 
 public:
-    PanicSellStrategy(long initCash, double threshold, double fee)
-        : TradingStrategy("쫄보 (Panic Seller)", initCash),
-          stopLossRate(threshold), feeRate(fee), hasBought(false) {}
+    explicit ClusterConnection(int socketFd) : fd(socketFd), inboxStart(0)
+    {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    }
 
-    void onPrice(size_t idx, int price, double changeRate) override
+    ~ClusterConnection()
     {
-        // 첫 시점에 전액 매수
-        if (!hasBought && cash >= price)
+        if (fd >= 0)
+            close(fd);
+    }
+
+    ClusterConnection(const ClusterConnection &) = delete;
+    ClusterConnection &operator=(const ClusterConnection &) = delete;
+
+    // 실패하면 nullptr
+    static unique_ptr<ClusterConnection> connectTo(const string &host, uint16_t port)
+    {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *list = nullptr;
+        if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &list) != 0)
+            return nullptr;
+
+        int sock = -1;
+        for (addrinfo *ai = list; ai && sock < 0; ai = ai->ai_next)
         {
-            int qty = cash / (price + (int)(price * feeRate));
-            if (qty > 0)
+            sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (sock >= 0 && connect(sock, ai->ai_addr, ai->ai_addrlen) != 0)
             {
-                buy(price, qty, feeRate);
-                hasBought = true;
+                close(sock);
+                sock = -1;
             }
         }
-        // 보유 중이면 손절 체크
-        else if (shares > 0 && avgPrice > 0)
+        freeaddrinfo(list);
+        if (sock < 0)
+            return nullptr;
+        return unique_ptr<ClusterConnection>(new ClusterConnection(sock));
+    }
+
+    // 다 보낼 때까지 블로킹 (상대가 끊었으면 false)
+    bool send(uint32_t type, const char *payload, size_t size)
+    {
+        if (fd < 0 || size > CLUSTER_MAX_FRAME)
+            return false;
+        FrameHeader header = {type, (uint32_t)size};
+        return sendAll((const char *)&header, sizeof(header)) && sendAll(payload, size);
+    }
+
+    bool send(uint32_t type, const vector<char> &payload)
+    {
+        return send(type, payload.data(), payload.size());
+    }
+
+    bool sendAll(const char *data, size_t size)
+    {
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        while (size > 0)
         {
-            double profitRate = (double)(price - avgPrice) / avgPrice;
-            if (profitRate <= stopLossRate)
-            {
-                sellAll(price, feeRate);
-            }
+            ssize_t n = ::send(fd, data, size, flags);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            data += n;
+            size -= (size_t)n;
         }
-        // 매 시점 자산 기록
-        recordEquity(price);
+        return true;
+    }
+
+    // recv 한 번으로 받을 수 있는 만큼 inbox에 쌓는다 (끊겼거나 오류면 false)
+    // poll로 읽기 가능을 확인한 뒤 부르면 블로킹되지 않는다
+    bool readAvailable()
+    {
+        if (inboxStart > 0 && inboxStart == inbox.size())
+        {
+            inbox.clear();
+            inboxStart = 0;
+        }
+        size_t base = inbox.size();
+        inbox.resize(base + 65536);
+        ssize_t n;
+        do
+        {
+            n = recv(fd, inbox.data() + base, 65536, 0);
+        } while (n < 0 && errno == EINTR);
+        inbox.resize(base + (n > 0 ? (size_t)n : 0));
+        return n > 0;
+    }
+
+    // 완성된 메시지가 있으면 하나 꺼낸다 (크기 제한을 넘는 메시지면 broken)
+    bool nextFrame(uint32_t &type, vector<char> &payload, bool &broken)
+    {
+        broken = false;
+        size_t available = inbox.size() - inboxStart;
+        if (available < sizeof(FrameHeader))
+            return false;
+        FrameHeader header;
+        memcpy(&header, inbox.data() + inboxStart, sizeof(header));
+        if (header.length > CLUSTER_MAX_FRAME)
+        {
+            broken = true;
+            return false;
+        }
+        if (available < sizeof(header) + header.length)
+            return false;
+
+        const char *body = inbox.data() + inboxStart + sizeof(header);
+        type = header.type;
+        payload.assign(body, body + header.length);
+        inboxStart += sizeof(header) + header.length;
+        if (inboxStart == inbox.size())
+        {
+            inbox.clear();
+            inboxStart = 0;
+        }
+        return true;
+    }
+
+    // 메시지 하나를 받을 때까지 블로킹 (워커용)
+    bool receive(uint32_t &type, vector<char> &payload)
+    {
+        bool broken = false;
+        while (!nextFrame(type, payload, broken))
+        {
+            if (broken || !readAvailable())
+                return false;
+        }
+        return true;
     }
+
+    int getFd() const { return fd; }
 };
 
-// DCAStrategy 클래스 (코치)
-class DCAStrategy : public TradingStrategy
+// ClusterOptions 구조체
+struct ClusterOptions
+{
+    size_t configsPerJob;  // 작업 하나의 설정 수 (작을수록 재분배가 촘촘)
+    size_t jobsInFlight;   // 워커마다 미리 보내 두는 작업 수 (왕복 지연을 가린다)
+    int idleTimeoutMs;     // 연결된 워커 없이 이만큼 지나면 포기 (0이면 계속 대기)
+    size_t maxJobFailures; // 작업 하나가 이만큼 실패하면 실패로 확정 (다른 노드에 다시 맡기는 횟수 제한)
+    int reissueAfterMs;    // 나간 지 이만큼 지난 작업만 한가한 노드에 한 번 더 맡긴다
+
+    ClusterOptions()
+        : configsPerJob(64), jobsInFlight(2), idleTimeoutMs(0), maxJobFailures(2), reissueAfterMs(1000) {}
+};
+
+// ClusterStats 구조체 (코디네이터 실행 기록)
+struct ClusterStats
+{
+    size_t jobs;           // 전체 작업 수
+    size_t workers;        // 접속했던 워커 수
+    size_t lostWorkers;    // 작업 도중 끊긴 워커 수
+    size_t reissued;       // 끝난 노드에 한 번 더 맡긴 작업 수
+    size_t requeued;       // 끊긴 워커에게서 회수해 다시 나눈 작업 수
+    size_t failed;         // maxJobFailures번 실패해 결과 없이 끝난 작업 수
+    size_t rejected;       // 버전/레이아웃이 달라 받지 않은 워커 수
+    vector<size_t> jobsPerWorker; // 접속 순서별 처리한 작업 수 (먼저 도착한 결과만)
+
+    ClusterStats() : jobs(0), workers(0), lostWorkers(0), reissued(0), requeued(0), failed(0), rejected(0) {}
+};
+
+// ClusterCoordinator 클래스
+class ClusterCoordinator
 {
 private:
-    double dcaDropRate;
-    int dcaInterval;
-    double buyRatio;
-    double feeRate;
-    int lastBuyIndex;
-    int lastBuyPrice;
+    typedef chrono::steady_clock Clock;
 
-public:
-    DCAStrategy(long initCash, double dropRate, int interval, double ratio, double fee)
-        : TradingStrategy("코치 (DCA)", initCash),
-          dcaDropRate(dropRate), dcaInterval(interval), buyRatio(ratio), feeRate(fee),
-          lastBuyIndex(-1), lastBuyPrice(0) {}
+    struct WorkerSlot
+    {
+        unique_ptr<ClusterConnection> conn;
+        bool ready;              // HELLO를 받고 SETUP을 보냈는지
+        vector<uint32_t> inFlight;
+        size_t index;            // 접속 순서 (stats.jobsPerWorker 위치)
+    };
 
-    void onPrice(size_t idx, int price, double changeRate) override
+    vector<string> symbolPaths;
+    vector<BacktestConfig> grid;
+    ClusterOptions options;
+    int listenFd;
+    uint16_t port;
+
+    vector<ClusterJob> jobs;
+    vector<char> jobDone;
+    vector<int> holders; // 작업을 들고 있는 워커 수
+    vector<size_t> failures; // 작업별 CLUSTER_FAILED 횟수
+    vector<Clock::time_point> issuedAt; // 작업을 마지막으로 워커에게 보낸 시각
+    deque<uint32_t> queue;
+    size_t remaining;
+    vector<ClusterReport> *results;
+    vector<ClusterJob> failedJobs;
+    ClusterStats stats;
+
+    void makeJobs()
     {
-        bool shouldBuy = false;
+        jobs.clear();
+        size_t per = max<size_t>(1, options.configsPerJob);
+        for (size_t sym = 0; sym < symbolPaths.size(); ++sym)
+        {
+            for (size_t begin = 0; begin < grid.size(); begin += per)
+            {
+                ClusterJob job;
+                job.jobId = (uint32_t)jobs.size();
+                job.symbolIndex = (uint32_t)sym;
+                job.configBegin = (uint32_t)begin;
+                job.configEnd = (uint32_t)min(grid.size(), begin + per);
+                jobs.push_back(job);
+            }
+        }
+        jobDone.assign(jobs.size(), 0);
+        holders.assign(jobs.size(), 0);
+        failures.assign(jobs.size(), 0);
+        issuedAt.assign(jobs.size(), Clock::time_point());
+        failedJobs.clear();
+        queue.clear();
+        for (const ClusterJob &job : jobs)
+            queue.push_back(job.jobId);
+        remaining = jobs.size();
+        stats.jobs = jobs.size();
+    }
 
-        if (lastBuyIndex < 0 && cash >= price)
+    // 대기 작업이 없으면, 할 일이 없는 워커에게만 다른 워커 한 곳이 reissueAfterMs 넘게 들고 있는
+    // 미완료 작업 중 가장 앞 번호를 고른다 (꼬리 작업이 모두 두 번 돌지 않게)
+    bool pickJob(const WorkerSlot &worker, uint32_t &jobId, bool &speculative)
+    {
+        while (!queue.empty())
         {
-            shouldBuy = true; // 첫 매수
+            jobId = queue.front();
+            queue.pop_front();
+            if (!jobDone[jobId])
+            {
+                speculative = false;
+                return true;
+            }
         }
-        else if (cash >= price)
+        if (!worker.inFlight.empty())
+            return false;
+        Clock::time_point cutoff = Clock::now() - chrono::milliseconds(max(0, options.reissueAfterMs));
+        for (size_t i = 0; i < jobs.size(); ++i)
         {
-            bool intervalMet = ((int)idx - lastBuyIndex) >= dcaInterval;
-            bool dropMet = (lastBuyPrice > 0) &&
-                           ((double)(price - lastBuyPrice) / lastBuyPrice <= dcaDropRate);
-
-            if (intervalMet || dropMet)
-                shouldBuy = true;
+            if (jobDone[i] || holders[i] != 1 || issuedAt[i] > cutoff)
+                continue;
+            jobId = (uint32_t)i;
+            speculative = true;
+            return true;
         }
+        return false;
+    }
 
-        if (shouldBuy)
+    bool fillWorker(WorkerSlot &worker)
+    {
+        SnapshotWriter w;
+        while (worker.ready && worker.inFlight.size() < options.jobsInFlight)
         {
-            long buyAmount = (long)(cash * buyRatio);
-            // 최소 1주 이상 살 수 있는지 체크
-            if (buyAmount < price)
-                buyAmount = cash;
-
-            int qty = buyAmount / (price + (int)(price * feeRate));
-            if (qty > 0)
+            uint32_t jobId;
+            bool speculative;
+            if (!pickJob(worker, jobId, speculative))
+                break;
+            w.clear();
+            w.pod(jobs[jobId]);
+            if (!worker.conn->send(CLUSTER_JOB, w.data()))
             {
-                buy(price, qty, feeRate);
-                lastBuyIndex = (int)idx;
-                lastBuyPrice = price;
+                if (!speculative)
+                    queue.push_front(jobId);
+                return false;
             }
+            holders[jobId]++;
+            worker.inFlight.push_back(jobId);
+            issuedAt[jobId] = Clock::now();
+            if (speculative)
+                stats.reissued++;
         }
-        recordEquity(price);
+        return true;
     }
-};
-
-// HoldStrategy 클래스 (존버)
-class HoldStrategy : public TradingStrategy
-{
-private:
-    double initialBuyRatio;
-    double feeRate;
-    bool hasBought;
 
-public:
-    HoldStrategy(long initCash, double ratio, double fee)
-        : TradingStrategy("존버 (Holder)", initCash),
-          initialBuyRatio(ratio), feeRate(fee), hasBought(false) {}
+    void releaseJob(WorkerSlot &worker, uint32_t jobId)
+    {
+        auto it = find(worker.inFlight.begin(), worker.inFlight.end(), jobId);
+        if (it == worker.inFlight.end())
+            return;
+        worker.inFlight.erase(it);
+        holders[jobId]--;
+    }
 
-    void onPrice(size_t idx, int price, double changeRate) override
+    // 끊긴 워커의 미완료 작업은 아무도 들고 있지 않으면 맨 앞에 다시 넣는다
+    void dropWorker(WorkerSlot &worker)
     {
-        if (!hasBought && cash >= price)
+        bool hadWork = false;
+        for (uint32_t jobId : worker.inFlight)
         {
-            long buyAmount = (long)(cash * initialBuyRatio);
-
-            int qty = buyAmount / (price + (int)(price * feeRate));
-            if (qty > 0)
+            holders[jobId]--;
+            if (!jobDone[jobId])
             {
-                buy(price, qty, feeRate);
-                hasBought = true;
+                hadWork = true;
+                if (holders[jobId] == 0)
+                {
+                    queue.push_front(jobId);
+                    stats.requeued++;
+                }
             }
         }
-        recordEquity(price);
+        if (hadWork)
+            stats.lostWorkers++;
+        worker.inFlight.clear();
+        worker.conn.reset();
     }
-};
-
-// BacktestEngine 클래스
-class BacktestEngine
-{
-private:
-    Stock *stock;
-    BacktestConfig config;
-    vector<TradingStrategy *> strategies;
-    vector<StrategyReport> results;
 
-    StrategyReport buildReport(TradingStrategy *s, int lastPrice)
+    bool sendSetup(WorkerSlot &worker)
     {
-        StrategyReport report;
-        report.strategyName = s->getName();
-        report.initialCash = config.initialCash;
-        report.finalEquity = s->getTotalValue(lastPrice);
-        report.totalReturn = (double)(report.finalEquity - report.initialCash) / report.initialCash * 100.0;
-        report.maxDrawdown = calculateMDD(s->getEquityHistory());
-        report.buyCount = s->getBuyCount();
-        report.sellCount = s->getSellCount();
-        report.finalShares = s->getShares();
-        report.avgPrice = s->getAvgPrice();
-        return report;
+        SnapshotWriter w;
+        w.podVector(grid);
+        w.pod((uint64_t)symbolPaths.size());
+        for (const string &path : symbolPaths)
+            w.text(path);
+        return worker.conn->send(CLUSTER_SETUP, w.data());
     }
 
-public:
-    BacktestEngine(Stock *s, const BacktestConfig &cfg) : stock(s), config(cfg) {}
-
-    ~BacktestEngine()
+    // 메시지 하나 처리 (연결을 끊어야 하면 false)
+    bool handleMessage(WorkerSlot &worker, uint32_t type, const vector<char> &payload)
     {
-        for (auto s : strategies)
+        SnapshotReader r(payload);
+        if (type == CLUSTER_HELLO)
         {
-            delete s;
+            // 버전이나 전송 구조체 레이아웃이 다르면 값을 해석할 수 없으므로 받지 않는다
+            uint32_t version = 0, threads = 0;
+            ClusterLayout layout;
+            if (worker.ready || !r.pod(version) || version != CLUSTER_PROTOCOL_VERSION || !r.pod(layout) ||
+                !layout.matches(ClusterLayout::current()) || !r.pod(threads))
+            {
+                stats.rejected++;
+                return false;
+            }
+            if (!sendSetup(worker))
+                return false;
+            worker.ready = true;
+            return fillWorker(worker);
+        }
+        if (!worker.ready)
+            return false;
+
+        if (type == CLUSTER_RESULT)
+        {
+            uint32_t jobId = 0;
+            vector<ClusterReport> reports;
+            if (!r.pod(jobId) || jobId >= jobs.size() || !r.podVector(reports))
+                return false;
+            releaseJob(worker, jobId);
+            if (!jobDone[jobId])
+            {
+                jobDone[jobId] = 1;
+                remaining--;
+                stats.jobsPerWorker[worker.index]++;
+                for (ClusterReport &rep : reports)
+                {
+                    rep.report.strategyName = strategyKindName(rep.report.kind);
+                    results->push_back(rep);
+                }
+            }
+            return fillWorker(worker);
+        }
+        if (type == CLUSTER_FAILED)
+        {
+            // 이 노드에서 종목 파일을 열 수 없던 작업: 다른 복사본이 돌고 있지 않으면 뒤에 다시 넣고,
+            // maxJobFailures번 실패하면 결과 없이 끝낸다 (워커는 다음 작업을 계속 받는다)
+            uint32_t jobId = 0;
+            if (!r.pod(jobId) || jobId >= jobs.size())
+                return false;
+            if (find(worker.inFlight.begin(), worker.inFlight.end(), jobId) == worker.inFlight.end())
+                return fillWorker(worker);
+            releaseJob(worker, jobId);
+            failures[jobId]++;
+            if (!jobDone[jobId] && holders[jobId] == 0)
+            {
+                if (failures[jobId] >= max<size_t>(1, options.maxJobFailures))
+                {
+                    jobDone[jobId] = 1;
+                    remaining--;
+                    stats.failed++;
+                    failedJobs.push_back(jobs[jobId]);
+                }
+                else
+                {
+                    queue.push_back(jobId);
+                }
+            }
+            return fillWorker(worker);
         }
+        return false;
     }
 
-    void addStrategy(TradingStrategy *s)
+public:
+    // symbolPaths: 모든 노드에서 같은 경로로 보이는 종목 파일 (.oopc), 코드는 파일 이름
+    ClusterCoordinator(const vector<string> &paths, const vector<BacktestConfig> &configs,
+                       const ClusterOptions &opts = ClusterOptions())
+        : symbolPaths(paths), grid(configs), options(opts), listenFd(-1), port(0),
+          remaining(0), results(nullptr) {}
+
+    ~ClusterCoordinator()
     {
-        strategies.push_back(s);
+        if (listenFd >= 0)
+            close(listenFd);
     }
 
-    double calculateMDD(const vector<long> &history)
-    {
-        if (history.empty())
-            return 0.0;
-        long peak = 0;
-        double maxDD = 0.0;
+    ClusterCoordinator(const ClusterCoordinator &) = delete;
+    ClusterCoordinator &operator=(const ClusterCoordinator &) = delete;
 
-        for (long equity : history)
+    // port가 0이면 비어 있는 포트를 받는다 (getPort로 확인)
+    bool listenOn(uint16_t listenPort)
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0)
+            return false;
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(listenPort);
+        socklen_t len = sizeof(addr);
+        if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, 64) != 0 ||
+            getsockname(listenFd, (sockaddr *)&addr, &len) != 0)
         {
-            if (equity > peak)
-                peak = equity;
-            if (peak > 0)
-            {
-                double dd = (double)(peak - equity) / peak;
-                if (dd > maxDD)
-                    maxDD = dd;
-            }
+            close(listenFd);
+            listenFd = -1;
+            return false;
         }
-        return maxDD * 100.0;
+        port = ntohs(addr.sin_port);
+        return true;
     }
 
-    void runBattle()
+    uint16_t getPort() const { return port; }
+
+    // 모든 작업이 끝날 때까지 워커를 받으며 실행 (도중에 워커가 바뀌어도 된다)
+    // 결과는 (종목, 설정, 전략) 순, 연결된 워커 없이 idleTimeoutMs가 지나면 false
+    // 실패로 끝난 작업은 결과에 없고 failed에 작업 번호 순으로 담긴다
+    bool run(vector<ClusterReport> &out, vector<ClusterJob> *failed = nullptr)
     {
-        size_t len = stock->getHistoryLength();
-        if (len == 0)
-            return;
+        out.clear();
+        if (failed)
+            failed->clear();
+        stats = ClusterStats();
+        if (listenFd < 0)
+            return false;
+        results = &out;
+        makeJobs();
 
-        int prevPrice = stock->getPriceAt(0);
+        vector<unique_ptr<WorkerSlot>> workers;
+        vector<pollfd> fds;
+        vector<char> payload;
+        Clock::time_point idleSince = Clock::now();
 
-        for (size_t i = 0; i < len; ++i)
+        while (remaining > 0)
         {
-            int price = stock->getPriceAt(i);
-            double changeRate = (i == 0) ? 0.0 : (double)(price - prevPrice) / prevPrice * 100;
+            fds.clear();
+            fds.push_back({listenFd, POLLIN, 0});
+            for (const auto &worker : workers)
+                fds.push_back({worker->conn->getFd(), POLLIN, 0});
+
+            // 대기 작업이 없으면 중복 배정 시각을 놓치지 않게 주기적으로 깨어난다
+            int timeout = (options.idleTimeoutMs > 0 || queue.empty()) ? 100 : -1;
+            int ready = poll(fds.data(), fds.size(), timeout);
+            if (ready < 0 && errno != EINTR)
+                return false;
+
+            if (fds[0].revents & POLLIN)
+            {
+                int sock = accept(listenFd, nullptr, nullptr);
+                if (sock >= 0)
+                {
+                    unique_ptr<WorkerSlot> slot(new WorkerSlot());
+                    slot->conn.reset(new ClusterConnection(sock));
+                    slot->ready = false;
+                    slot->index = stats.workers++;
+                    stats.jobsPerWorker.push_back(0);
+                    workers.push_back(move(slot));
+                }
+            }
 
-            for (TradingStrategy *s : strategies)
+            for (size_t i = 1; i < fds.size(); ++i)
+            {
+                if (!fds[i].revents)
+                    continue;
+                WorkerSlot &worker = *workers[i - 1];
+                bool alive = worker.conn->readAvailable();
+                uint32_t type;
+                bool broken = false;
+                while (alive && worker.conn->nextFrame(type, payload, broken))
+                    alive = handleMessage(worker, type, payload);
+                if (!alive || broken)
+                    dropWorker(worker);
+            }
+
+            // 끊긴 워커 정리 후, 끊긴 쪽에서 돌아온 작업을 남은 워커에게 나눈다
+            workers.erase(remove_if(workers.begin(), workers.end(), [](const unique_ptr<WorkerSlot> &w)
+                                    { return !w->conn; }),
+                          workers.end());
+            for (auto &worker : workers)
             {
-                s->onPrice(i, price, changeRate);
+                if (!fillWorker(*worker))
+                    dropWorker(*worker);
             }
-            prevPrice = price;
+            workers.erase(remove_if(workers.begin(), workers.end(), [](const unique_ptr<WorkerSlot> &w)
+                                    { return !w->conn; }),
+                          workers.end());
+
+            if (!workers.empty())
+                idleSince = Clock::now();
+            else if (options.idleTimeoutMs > 0 &&
+                     Clock::now() - idleSince > chrono::milliseconds(options.idleTimeoutMs))
+                return false;
         }
 
-        int lastPrice = stock->getPriceAt(len - 1);
-        for (TradingStrategy *s : strategies)
+        for (auto &worker : workers)
+            worker->conn->send(CLUSTER_SHUTDOWN, nullptr, 0);
+
+        if (failed)
         {
-            s->onFinish(lastPrice);
-            results.push_back(buildReport(s, lastPrice));
+            *failed = failedJobs;
+            sort(failed->begin(), failed->end(), [](const ClusterJob &a, const ClusterJob &b)
+                 { return a.jobId < b.jobId; });
         }
+
+        stable_sort(out.begin(), out.end(), [](const ClusterReport &a, const ClusterReport &b)
+                    {
+            if (a.symbolIndex != b.symbolIndex)
+                return a.symbolIndex < b.symbolIndex;
+            return a.configIndex < b.configIndex; });
+        return true;
     }
 
-    const vector<StrategyReport> &getResults() const { return results; }
-    Stock *getStock() const { return stock; }
+    const ClusterStats &getStats() const { return stats; }
+    const vector<BacktestConfig> &getGrid() const { return grid; }
+    const vector<string> &getSymbolPaths() const { return symbolPaths; }
 };
 
-// BacktestReport 클래스
-class BacktestReport
+// ClusterWorker 클래스 (코디네이터의 작업을 받아 로컬 스레드로 처리)
+class ClusterWorker
 {
 private:
-    vector<StrategyReport> results;
-    string stockName;
-
-public:
-    BacktestReport(const BacktestEngine &engine)
+    unsigned int threadCount;
+    vector<BacktestConfig> grid;
+    vector<string> symbolPaths;
+    vector<unique_ptr<Stock>> stocks; // 처음 쓰일 때 mmap으로 연다
+    vector<BacktestConfig> jobConfigs;
+    vector<ClusterReport> reports;
+
+    static string codeFromPath(const string &path)
     {
-        results = engine.getResults();
-        stockName = engine.getStock()->getName();
+        size_t slash = path.find_last_of('/');
+        string file = (slash == string::npos) ? path : path.substr(slash + 1);
+        size_t dot = file.find_last_of('.');
+        return (dot == string::npos) ? file : file.substr(0, dot);
     }
 
-    void printSummary() const
+    const Stock *openStock(uint32_t index)
     {
-        cout << "\n=== 습관 교정 백테스터 결과 리포트 ===" << endl;
-        cout << "종목: " << stockName << endl;
-        if (results.empty())
-            return;
-
-        cout << "초기 자본: " << results[0].initialCash << "원" << endl
-             << endl;
-
-        for (const auto &res : results)
+        if (index >= symbolPaths.size())
+            return nullptr;
+        if (!stocks[index])
         {
-            cout << "[" << res.strategyName << "]" << endl;
-            cout << "최종 자산: " << res.finalEquity << "원 | 수익률: "
-                 << fixed << setprecision(2) << res.totalReturn << "%" << endl;
-            cout << "MDD: " << res.maxDrawdown << "% | 매수: " << res.buyCount
-                 << "회 | 매도: " << res.sellCount << "회" << endl
-                 << endl;
+            string code = codeFromPath(symbolPaths[index]);
+            stocks[index].reset(new Stock(code, code, 0));
+            if (!stocks[index]->loadHistory(symbolPaths[index]))
+            {
+                stocks[index].reset();
+                return nullptr;
+            }
         }
+        return stocks[index].get();
     }
 
-    void printRanking() const
+    bool runJob(const ClusterJob &job)
     {
-        // 간단한 수익률 순위 정렬 및 출력
-        vector<StrategyReport> ranked = results;
-        for (size_t i = 0; i < ranked.size(); ++i)
+        const Stock *stock = openStock(job.symbolIndex);
+        if (!stock || job.configBegin > job.configEnd || job.configEnd > grid.size())
+            return false;
+
+        jobConfigs.assign(grid.begin() + job.configBegin, grid.begin() + job.configEnd);
+        ParameterSweepEngine sweep(stock, threadCount);
+        sweep.setConfigs(jobConfigs);
+        vector<SweepResult> swept = sweep.run();
+
+        reports.clear();
+        for (size_t i = 0; i < swept.size(); ++i)
         {
-            for (size_t j = 0; j < ranked.size() - 1 - i; ++j)
+            for (const StrategyReport &rep : swept[i].reports)
             {
-                if (ranked[j].totalReturn < ranked[j + 1].totalReturn)
-                {
-                    swap(ranked[j], ranked[j + 1]);
-                }
+                ClusterReport wire;
+                wire.symbolIndex = job.symbolIndex;
+                wire.configIndex = job.configBegin + (uint32_t)i;
+                wire.report = rep;
+                wire.report.strategyName = nullptr; // 포인터는 다른 프로세스에서 의미가 없다
+                reports.push_back(wire);
             }
         }
+        return true;
+    }
 
-        cout << "순위: ";
-        for (size_t i = 0; i < ranked.size(); ++i)
+    // 중복 배정된 작업을 처리하는 사이 코디네이터가 끝내고 닫았을 수 있다
+    // (보내기 실패 후 이미 도착해 있는 메시지 중 SHUTDOWN이 있는지 확인)
+    static bool shutdownReceived(ClusterConnection &conn)
+    {
+        uint32_t type = 0;
+        vector<char> payload;
+        while (conn.receive(type, payload))
         {
-            cout << (i + 1) << ". " << ranked[i].strategyName
-                 << "(" << (ranked[i].totalReturn > 0 ? "+" : "")
-                 << fixed << setprecision(0) << ranked[i].totalReturn << "%) ";
+            if (type == CLUSTER_SHUTDOWN)
+                return true;
         }
-        cout << endl;
-
-        cout << "승자: " << ranked[0].strategyName << endl;
+        return false;
     }
 
-    string getSummaryComment() const
+public:
+    // threads가 0이면 하드웨어 코어 수만큼 사용
+    explicit ClusterWorker(unsigned int threads = 0) : threadCount(threads) {}
+
+    // 코디네이터에 붙어 SHUTDOWN을 받을 때까지 처리, 처리한 작업 수 반환 (연결/설정 실패면 -1)
+    // 종목 파일을 열 수 없는 작업은 CLUSTER_FAILED로 알리고 세지 않는다
+    long run(const string &host, uint16_t port)
     {
-        if (results.size() < 2)
-            return "결과 부족";
+        unique_ptr<ClusterConnection> conn = ClusterConnection::connectTo(host, port);
+        if (!conn)
+            return -1;
 
-        // 전략 순서가 코드 삽입 순서와 같다고 가정 (0: 쫄보, 1: 코치, 2: 존버)
+        SnapshotWriter w;
+        w.pod(CLUSTER_PROTOCOL_VERSION);
+        w.pod(ClusterLayout::current());
+        w.pod((uint32_t)threadCount);
+        if (!conn->send(CLUSTER_HELLO, w.data()))
+            return -1;
 
-        // 전략 이름으로 인덱스 찾기
-        int panicIdx = -1;
-        int dcaIdx = -1;
+        uint32_t type = 0;
+        vector<char> payload;
+        if (!conn->receive(type, payload))
+            return -1;
+        if (type == CLUSTER_SHUTDOWN)
+            return 0; // 늦게 붙어서 남은 작업이 없음
+        if (type != CLUSTER_SETUP)
+            return -1;
+        {
+            SnapshotReader r(payload);
+            uint64_t count = 0;
+            if (!r.podVector(grid) || !r.pod(count))
+                return -1;
+            symbolPaths.assign((size_t)min<uint64_t>(count, 1 << 24), string());
+            for (string &path : symbolPaths)
+            {
+                if (!r.text(path))
+                    return -1;
+            }
+            stocks.clear();
+            stocks.resize(symbolPaths.size());
+        }
 
-        for (size_t i = 0; i < results.size(); ++i)
+        long done = 0;
+        while (conn->receive(type, payload))
         {
-            if (results[i].strategyName.find("쫄보") != string::npos)
-                panicIdx = i;
-            if (results[i].strategyName.find("코치") != string::npos)
-                dcaIdx = i;
+            if (type == CLUSTER_SHUTDOWN)
+                return done;
+            ClusterJob job;
+            SnapshotReader r(payload);
+            if (type != CLUSTER_JOB || !r.pod(job))
+                return -1;
+
+            w.clear();
+            w.pod(job.jobId);
+            if (!runJob(job))
+            {
+                // 이 노드에서 열 수 없는 종목이면 알리고 다음 작업을 기다린다
+                if (!conn->send(CLUSTER_FAILED, w.data()))
+                    return shutdownReceived(*conn) ? done : -1;
+                continue;
+            }
+            w.podVector(reports);
+            if (!conn->send(CLUSTER_RESULT, w.data()))
+                return shutdownReceived(*conn) ? done : -1;
+            done++;
         }
+        return -1; // 코디네이터가 SHUTDOWN 없이 끊음
+    }
+};
 
-        if (panicIdx == -1 || dcaIdx == -1)
-            return "비교 대상 전략이 없습니다.";
+#endif
 
-        double panicReturn = results[panicIdx].totalReturn;
-        double dcaReturn = results[dcaIdx].totalReturn;
-        double diff = dcaReturn - panicReturn;
+// == 6. Main 함수 (실행 예시) ==
 
-        stringstream ss;
-        ss << fixed << setprecision(2);
+int main(int argc, char **argv)
+{
+    // --bench [최대 길이]: 벤치마크만 실행 (JSON lines 출력)
+    if (argc >= 2 && string(argv[1]) == "--bench")
+    {
+        size_t maxPoints = (argc >= 3) ? (size_t)strtoull(argv[2], nullptr, 10) : 100000000;
+        BenchmarkSuite bench(cout, maxPoints);
+        bench.runAll();
+#if OOP_PROFILE
+        Profiler::instance().writeFiles("oop_profile.json", "oop_trace.json");
+#endif
+        return 0;
+    }
 
-        if (diff > 0)
+    // --load <CSV> [캐시 폴더]: 시세 파일을 적재하고 종목별 기본 백테스트 결과 출력
+    if (argc >= 3 && string(argv[1]) == "--load")
+    {
+        Market loaded;
+        CsvLoadOptions options;
+        if (argc >= 4)
+            options.cacheDir = argv[3];
+        CsvLoadResult loadResult = CsvPriceLoader::load(loaded, argv[2], options);
+        if (!loadResult.ok)
         {
-            ss << "물타기 전략이 감정적 손절 전략보다 " << diff << "%p 높은 수익을 기록했습니다.\n"
-               << "뇌동매매를 줄이고 원칙을 지키는 습관을 길러보세요.";
+            cout << "시세 파일을 읽을 수 없습니다: " << argv[2] << endl;
+            return 1;
         }
-        else
+        cout << "적재 완료: " << loadResult.symbols << "개 종목, " << loadResult.rows << "행"
+             << (loadResult.fromCache ? " (캐시)" : "") << ", 건너뛴 줄 " << loadResult.badLines << endl;
+
+        BacktestConfig loadConfig;
+        for (Stock *stock : loaded.getStocks())
         {
-            ss << "이번 시나리오에서는 손절 전략이 유리했습니다.\n"
-               << "하지만 장기적으로는 원칙 투자가 더 안정적입니다.";
+            BacktestEngine engine(stock, loadConfig);
+            engine.addDefaultStrategies();
+            engine.runBattle();
+            cout << "[" << stock->getCode() << "] ";
+            for (const StrategyReport &rep : engine.getResults())
+                cout << rep.strategyName << " " << fixed << setprecision(2) << rep.totalReturn << "%  ";
+            cout << endl;
         }
-        return ss.str();
+        return 0;
     }
-};
 
-// == 6. Main 함수 (실행 예시) ==
+#ifndef _WIN32
+    // --coordinator <포트> <종목.oopc>...: 기본 그리드를 워커들에게 나눠 실행하고 상위 5개 출력
+    if (argc >= 4 && string(argv[1]) == "--coordinator")
+    {
+        vector<string> paths(argv + 3, argv + argc);
+        vector<BacktestConfig> clusterGrid = ParameterSweepEngine::makeGrid(
+            BacktestConfig(), {-0.05, -0.10, -0.15, -0.20}, {-0.03, -0.05, -0.08}, {1, 3, 5}, {0.1, 0.2}, {});
+        ClusterCoordinator coordinator(paths, clusterGrid);
+        if (!coordinator.listenOn((uint16_t)atoi(argv[2])))
+        {
+            cout << "포트를 열 수 없습니다: " << argv[2] << endl;
+            return 1;
+        }
+        cout << "코디네이터 대기 중 (포트 " << coordinator.getPort() << ", 작업 "
+             << paths.size() << "종목 x " << clusterGrid.size() << "설정)" << endl;
+
+        vector<ClusterReport> clusterResults;
+        vector<ClusterJob> failedJobs;
+        if (!coordinator.run(clusterResults, &failedJobs))
+            return 1;
+        const ClusterStats &stats = coordinator.getStats();
+        cout << "완료: 작업 " << stats.jobs << "개, 워커 " << stats.workers << "대, 재분배 "
+             << stats.requeued << "개, 중복 배정 " << stats.reissued << "개, 실패 " << stats.failed << "개" << endl;
+        for (const ClusterJob &job : failedJobs)
+        {
+            cout << "실패한 작업 " << job.jobId << ": " << paths[job.symbolIndex] << " 설정 "
+                 << job.configBegin << "~" << job.configEnd - 1 << endl;
+        }
 
-int main()
-{
-    srand((unsigned int)time(0));
+        TopKRanker ranker(5, RankingOrder(RANK_TOTAL_RETURN).then(RANK_MAX_DRAWDOWN).then(RANK_SHARPE));
+        for (size_t i = 0; i < clusterResults.size(); ++i)
+            ranker.offer(clusterResults[i].report, clusterResults[i].configIndex, i);
+        for (const RankedReport &ranked : ranker.sorted())
+        {
+            const BacktestConfig &c = clusterGrid[ranked.configIndex];
+            cout << paths[clusterResults[ranked.sequence].symbolIndex] << " " << ranked.report.strategyName
+                 << " " << fixed << setprecision(2) << ranked.report.totalReturn << "% (손절 "
+                 << setprecision(0) << c.panicThreshold * 100 << "% / 물타기 " << c.dcaDropRate * 100
+                 << "% " << c.dcaInterval << "일 " << c.dcaBuyRatio * 100 << "%)" << endl;
+        }
+        return 0;
+    }
+
+    // --worker <호스트> <포트> [스레드 수]: 코디네이터의 작업을 받아 처리
+    if (argc >= 4 && string(argv[1]) == "--worker")
+    {
+        unsigned int threads = (argc >= 5) ? (unsigned int)atoi(argv[4]) : 0;
+        ClusterWorker worker(threads);
+        long done = worker.run(argv[2], (uint16_t)atoi(argv[3]));
+        if (done < 0)
+        {
+            cout << "코디네이터와의 연결이 끊겼습니다" << endl;
+            return 1;
+        }
+        cout << "처리한 작업 " << done << "개" << endl;
+        return 0;
+    }
+#endif
 
     // 시장 및 종목 생성
     Market market;
+    market.setSeed((uint64_t)time(0));
     Stock *samsung = new Stock("005930", "삼성전자", 70000);
 
     // 샘플 가격 데이터 (30일)
@@ -982,12 +10299,12 @@ int main()
     User user("user1", "1234", "홍길동");
     Account *myAccount = user.getAccount();
 
-    myAccount->deposit(10000000); // 1,000만원 입금
+    myAccount->deposit(Money(10000000)); // 1,000만원 입금
     myAccount->printAccountSummary();
 
     // 매수 테스트 (삼성전자 10주)
     cout << "\n>> [주문 1] 삼성전자 10주 매수 주문 (현재가: " << samsung->getCurrentPrice() << "원)" << endl;
-    Order buyOrder("005930", BUY, MARKET, 0, 10);
+    Order buyOrder(samsung->getSymbolId(), BUY, MARKET, 0, 10);
     myAccount->placeOrder(buyOrder);
 
     // 주문 체결 시도
@@ -1010,7 +10327,7 @@ int main()
 
     // 매도 테스트 (삼성전자 5주)
     cout << "\n>> [주문 2] 삼성전자 5주 매도 주문 (현재가: " << samsung->getCurrentPrice() << "원)" << endl;
-    Order sellOrder("005930", SELL, MARKET, 0, 5);
+    Order sellOrder(samsung->getSymbolId(), SELL, MARKET, 0, 5);
     myAccount->placeOrder(sellOrder);
 
     // 주문 체결 시도
@@ -1062,5 +10379,162 @@ int main()
     cout << endl
          << report.getSummaryComment() << endl;
 
+    // ==========================================
+    // [TEST 3] 병렬 파라미터 스윕
+    // ==========================================
+    cout << "\n=== [TEST 3] 병렬 파라미터 스윕 ===" << endl;
+
+    vector<BacktestConfig> grid = ParameterSweepEngine::makeGrid(
+        config, {-0.05, -0.10, -0.15}, {-0.03, -0.05}, {}, {}, {});
+    ParameterSweepEngine sweep(samsung);
+    sweep.setConfigs(grid);
+    vector<SweepResult> sweepResults = sweep.run();
+
+    for (const auto &res : sweepResults)
+    {
+        cout << "손절 " << fixed << setprecision(0) << res.config.panicThreshold * 100
+             << "% / 물타기 " << res.config.dcaDropRate * 100 << "% -> ";
+        for (const auto &rep : res.reports)
+        {
+            cout << rep.strategyName << " " << setprecision(2) << rep.totalReturn << "%  ";
+        }
+        cout << endl;
+    }
+
+    // 수익률 -> MDD -> 샤프 순으로 상위 3개만
+    vector<RankedReport> top = sweep.runTopK(3, RankingOrder(RANK_TOTAL_RETURN).then(RANK_MAX_DRAWDOWN).then(RANK_SHARPE));
+    cout << "상위 " << top.size() << "개: ";
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+        const BacktestConfig &cfg = grid[top[i].configIndex];
+        cout << (i + 1) << ". " << top[i].report.strategyName << " (손절 " << setprecision(0)
+             << cfg.panicThreshold * 100 << "% / 물타기 " << cfg.dcaDropRate * 100 << "%, "
+             << setprecision(2) << top[i].report.totalReturn << "%) ";
+    }
+    cout << endl;
+
+    // ==========================================
+    // [TEST 4] 몬테카를로 스트레스 테스트
+    // ==========================================
+    cout << "\n=== [TEST 4] 몬테카를로 스트레스 테스트 ===" << endl;
+
+    MonteCarloConfig mcConfig;
+    mcConfig.pathCount = 2000;
+    mcConfig.steps = 250;
+    MonteCarloStressTest stressTest(config, mcConfig);
+    stressTest.run().print();
+
+    // ==========================================
+    // [TEST 5] 워크포워드 최적화
+    // ==========================================
+    cout << "\n=== [TEST 5] 워크포워드 최적화 ===" << endl;
+
+    WalkForwardOptimizer walkForward(samsung, 15, 5);
+    walkForward.setGrid(grid);
+    walkForward.setObjective(OBJECTIVE_TOTAL_RETURN);
+    WalkForwardOptimizer::print(walkForward.run());
+
+    // ==========================================
+    // [TEST 6] 이벤트 커널: 전략이 실제 계좌로 거래
+    // ==========================================
+    cout << "\n=== [TEST 6] 이벤트 커널 (전략 -> 주문 -> 계좌) ===" << endl;
+
+    {
+        // 각 전략이 자기 계좌로 같은 가격 이력을 받아 주문을 낸다
+        PanicSellStrategy panic(config.initialCash, config.panicThreshold, config.feeRate);
+        DCAStrategy dca(config.initialCash, config.dcaDropRate, config.dcaInterval, config.dcaBuyRatio, config.feeRate);
+        HoldStrategy hold(config.initialCash, config.holdBuyRatio, config.feeRate);
+        TradingStrategy *agentStrategies[] = {&panic, &dca, &hold};
+
+        Account panicAccount("SIM-1", config.initialCash);
+        Account dcaAccount("SIM-2", config.initialCash);
+        Account holdAccount("SIM-3", config.initialCash);
+        Account *agentAccounts[] = {&panicAccount, &dcaAccount, &holdAccount};
+
+        SimulationKernel kernel(market);
+        vector<unique_ptr<StrategyAccountAgent>> agents;
+        for (int i = 0; i < 3; ++i)
+        {
+            agents.emplace_back(new StrategyAccountAgent(agentStrategies[i], samsung->getSymbolId()));
+            agents.back()->attach(kernel, agentAccounts[i]);
+        }
+        kernel.addHistoryFeed(samsung->getSymbolId());
+        kernel.run();
+
+        for (int i = 0; i < 3; ++i)
+        {
+            cout << agentStrategies[i]->getName() << ": 체결 " << agentAccounts[i]->getTransactions().size()
+                 << "건 | ";
+            agentAccounts[i]->printAccountSummary();
+        }
+    }
+
+    // ==========================================
+    // [TEST 7] 체크포인트 저장 후 이어서 실행
+    // ==========================================
+    cout << "\n=== [TEST 7] 체크포인트 / 재시작 ===" << endl;
+
+    {
+        const string checkpointPath = "oop_checkpoint.bin";
+        {
+            // 10틱마다 스냅샷을 남기며 끝까지 실행 (마지막 스냅샷은 20틱 시점)
+            CheckpointWriter checkpoint(checkpointPath);
+            BacktestEngine first(samsung, config);
+            first.addDefaultStrategies();
+            first.runBattleCheckpointed(&checkpoint, 10);
+            checkpoint.flush();
+        }
+
+        // 중단된 것으로 보고 새 엔진에서 마지막 체크포인트부터 이어서 실행
+        vector<char> saved;
+        BacktestEngine resumed(samsung, config);
+        resumed.addDefaultStrategies();
+        bool restored = CheckpointWriter::load(checkpointPath, saved) &&
+                        resumed.runBattleCheckpointed(nullptr, 10, &saved);
+        remove(checkpointPath.c_str());
+
+        bool same = restored && resumed.getResults().size() == engine.getResults().size();
+        for (size_t i = 0; same && i < engine.getResults().size(); ++i)
+            same = resumed.getResults()[i].finalEquity == engine.getResults()[i].finalEquity &&
+                   resumed.getResults()[i].maxDrawdown == engine.getResults()[i].maxDrawdown;
+        cout << "스냅샷 " << saved.size() << "바이트에서 재시작 -> TEST 2 결과와 "
+             << (same ? "일치" : "불일치") << endl;
+    }
+
+    // ==========================================
+    // [TEST 8] 다중 레인 엔진 결과 확인
+    // ==========================================
+    cout << "\n=== [TEST 8] 다중 레인 엔진 / runBattle 비교 ===" << endl;
+
+    {
+        // TEST 3의 설정 그리드를 같은 시계열의 레인으로 한 번에 실행
+        LaneBacktestEngine lanes;
+        lanes.setLanes(grid);
+        lanes.runShared(samsung->getHistoryData(), samsung->getHistoryLength());
+
+        const vector<StrategyReport> &laneResults = lanes.getResults();
+        bool same = laneResults.size() == grid.size() * 3;
+        for (size_t c = 0; same && c < grid.size(); ++c)
+        {
+            for (size_t k = 0; same && k < 3; ++k)
+            {
+                const StrategyReport &a = laneResults[c * 3 + k];
+                const StrategyReport &b = sweepResults[c].reports[k];
+                same = a.finalEquity == b.finalEquity && a.totalReturn == b.totalReturn &&
+                       a.maxDrawdown == b.maxDrawdown && a.buyCount == b.buyCount &&
+                       a.sellCount == b.sellCount && a.risk.sharpeRatio == b.risk.sharpeRatio &&
+                       a.risk.sortinoRatio == b.risk.sortinoRatio;
+            }
+        }
+        cout << "레인 " << lanes.getLaneCount() << "개 x 전략 3개 -> TEST 3 결과와 "
+             << (same ? "일치" : "불일치") << " (스칼라 재계산 " << lanes.getFallbackCount() << "개)" << endl;
+    }
+
+#if OOP_PROFILE
+    // 계측 빌드: 요약과 트레이스를 저장
+    if (Profiler::instance().writeFiles("oop_profile.json", "oop_trace.json"))
+        cout << "\n계측 결과: oop_profile.json, oop_trace.json" << endl;
+#endif
+
     return 0;
 }